@@ -35,7 +35,13 @@ SOURCES += \
     kfrustum.cpp \
     kimage.cpp \
     kabstracthdrparser.cpp \
-    kbufferedbinaryfilereader.cpp
+    kbufferedbinaryfilereader.cpp \
+    kmappedfilereader.cpp \
+    kcachefile.cpp \
+    kvertexcache.cpp \
+    kmeshcluster.cpp \
+    kmeshsimplifier.cpp \
+    kboundingvolumebuilder.cpp
 
 HEADERS += \
     kcolor.h \
@@ -106,4 +112,16 @@ HEADERS += \
     kvector4d.h \
     kimage.h \
     kabstracthdrparser.h \
-    kbufferedbinaryfilereader.h
+    kbufferedbinaryfilereader.h \
+    kmappedfilereader.h \
+    kcachefile.h \
+    kparallel.h \
+    kradixsort.h \
+    kvertexcache.h \
+    kmeshcluster.h \
+    kmeshsimplifier.h \
+    kmorton.h \
+    kfloat4.h \
+    kray.h \
+    klooseoctree.h \
+    kboundingvolumebuilder.h
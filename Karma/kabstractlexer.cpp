@@ -1,23 +1,38 @@
 #include "kabstractlexer.h"
 #include "kabstractreader.h"
 
+#include <cstring>
 #include <QtGlobal>
 
 class KAbstractLexerBasePrivate
 {
 public:
   explicit KAbstractLexerBasePrivate(KAbstractReader *reader);
+  inline int readChar();
   KAbstractReader *m_reader;
+  char const *m_spanPos, *m_spanEnd;
   bool m_initialized;
   int m_currLineCount, m_currCharCount;
 };
 
 KAbstractLexerBasePrivate::KAbstractLexerBasePrivate(KAbstractReader *reader) :
-  m_reader(reader), m_initialized(false), m_currLineCount(1), m_currCharCount(-1)
+  m_reader(reader), m_spanPos(reader->data()), m_spanEnd(m_spanPos + reader->size()),
+  m_initialized(false), m_currLineCount(1), m_currCharCount(-1)
 {
   // Intentionally Empty
 }
 
+inline int KAbstractLexerBasePrivate::readChar()
+{
+  // Contiguous readers are consumed directly, skipping virtual dispatch.
+  if (m_spanPos)
+  {
+    if (m_spanPos == m_spanEnd) return KAbstractReader::EndOfFile;
+    return *m_spanPos++;
+  }
+  return m_reader->next();
+}
+
 
 KAbstractLexerBase::KAbstractLexerBase(KAbstractReader *reader) :
   m_private(new KAbstractLexerBasePrivate(reader))
@@ -48,7 +63,7 @@ KAbstractLexerBase::char_type KAbstractLexerBase::nextChar()
   P(KAbstractLexerBasePrivate);
 
   m_currChar = m_peekChar;
-  m_peekChar = p.m_reader->next();
+  m_peekChar = p.readChar();
 
   // Increment line/character counter
   if (m_currChar == '\n')
@@ -74,12 +89,33 @@ void KAbstractLexerBase::nextLine()
 
   // Read until newline ignoring everything.
   m_currChar = m_peekChar;
-  while (m_currChar != '\n')
+  if (p.m_spanPos)
+  {
+    // Contiguous: Jump straight to the end of the line.
+    if (m_currChar != '\n' && m_currChar != KAbstractReader::EndOfFile)
+    {
+      char const *newline = static_cast<char const*>(std::memchr(p.m_spanPos, '\n', p.m_spanEnd - p.m_spanPos));
+      if (newline)
+      {
+        m_currChar = '\n';
+        p.m_spanPos = newline + 1;
+      }
+      else
+      {
+        m_currChar = KAbstractReader::EndOfFile;
+        p.m_spanPos = p.m_spanEnd;
+      }
+    }
+  }
+  else
   {
-    m_currChar = p.m_reader->next();
-    if (m_currChar == KAbstractReader::EndOfFile) break;
+    while (m_currChar != '\n')
+    {
+      m_currChar = p.m_reader->next();
+      if (m_currChar == KAbstractReader::EndOfFile) break;
+    }
   }
-  m_peekChar = p.m_reader->next();
+  m_peekChar = p.readChar();
 }
 
 KAbstractLexerBase::size_type KAbstractLexerBase::currCharCount() const
@@ -110,3 +146,27 @@ void KAbstractLexerBase::forceValidate()
 {
   m_private->m_initialized = true;
 }
+
+char const *KAbstractLexerBase::spanPeek() const
+{
+  P(KAbstractLexerBasePrivate);
+  if (!p.m_spanPos) return Q_NULLPTR;
+  return (m_peekChar == KAbstractReader::EndOfFile) ? p.m_spanEnd : p.m_spanPos - 1;
+}
+
+char const *KAbstractLexerBase::spanEnd() const
+{
+  return m_private->m_spanEnd;
+}
+
+// Note: Equivalent to calling nextChar() until the character before pos is current.
+//       The skipped range must be non-empty and must not contain a newline.
+void KAbstractLexerBase::spanSkip(char const *pos)
+{
+  P(KAbstractLexerBasePrivate);
+  Q_ASSERT(pos > spanPeek() && pos <= p.m_spanEnd);
+  p.m_currCharCount += static_cast<int>(pos - spanPeek());
+  m_currChar = pos[-1];
+  p.m_spanPos = pos;
+  m_peekChar = p.readChar();
+}
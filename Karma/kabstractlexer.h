@@ -17,7 +17,7 @@ public:
   typedef int32_t char_type;
 
   KAbstractLexerBase(KAbstractReader *reader);
-  ~KAbstractLexerBase();
+  virtual ~KAbstractLexerBase();
 
   // Validity
   void initializeLexer();
@@ -33,6 +33,11 @@ public:
   bool readExpect(char const *str);
   void forceValidate();
 
+  // Contiguous access (Null if the reader is streamed)
+  char const *spanPeek() const;
+  char const *spanEnd() const;
+  void spanSkip(char const *pos);
+
 private:
   KAbstractLexerBasePrivate *m_private;
   int m_currChar, m_peekChar;
@@ -3,10 +3,13 @@
 #include "kabstractreader.h"
 #include "kcommon.h"
 #include "kmacros.h"
+#include "kparallel.h"
 #include "kparsetoken.h"
 
+#include <algorithm>
 #include <cstring>
 #include <map>
+#include <numeric>
 #include <string>
 #include <unordered_map>
 #include <vector>
@@ -60,6 +63,158 @@ static const KParseMap<TokenId> sg_reserved =
   { "s", PT_SMOOTHING }
 };
 
+/*******************************************************************************
+ * Parallel Chunk Definitions
+ ******************************************************************************/
+
+enum ObjBatchType
+{
+  NoBatch,
+  VertexBatch,
+  TextureBatch,
+  NormalBatch,
+  ParameterBatch,
+  FaceBatch
+};
+
+// Number of elements gathered before a batched callback is issued.
+static const size_t sg_batchSize = 4096;
+
+// Below this size the cost of spinning up workers outweighs the gain.
+static const size_t sg_minimumParallelBytes = 1 << 20;
+static const size_t sg_minimumChunkBytes = 1 << 18;
+
+// Reads a line-aligned subrange of a contiguous buffer.
+class KObjSpanReader : public KAbstractReader
+{
+public:
+  KObjSpanReader(char const *begin, char const *end);
+  int next();
+  char const *data() const;
+  size_t size() const;
+private:
+  char const *m_begin;
+  char const *m_end;
+  char const *m_pos;
+};
+
+KObjSpanReader::KObjSpanReader(char const *begin, char const *end) :
+  m_begin(begin), m_end(end), m_pos(begin)
+{
+  // Intentionally Empty
+}
+
+int KObjSpanReader::next()
+{
+  if (m_pos == m_end)
+  {
+    return EndOfFile;
+  }
+  return *m_pos++;
+}
+
+char const *KObjSpanReader::data() const
+{
+  return m_begin;
+}
+
+size_t KObjSpanReader::size() const
+{
+  return static_cast<size_t>(m_end - m_begin);
+}
+
+// Parses a single chunk, recording every batch so that it can be replayed on
+// the owning parser in the exact order the sequential parser would emit it.
+class KObjChunkRecorder : public KAbstractObjParser
+{
+public:
+  struct Record
+  {
+    ObjBatchType m_type;
+    size_type m_count;
+  };
+  KObjChunkRecorder(KAbstractReader *reader);
+  void record(ObjBatchType type, size_type count);
+
+  std::vector<Record> m_records;
+  std::vector<float> m_floats;
+  std::vector<index_array> m_indices;
+  std::vector<size_type> m_faceSizes;
+  size_type m_counts[FaceBatch + 1];
+  bool m_result;
+
+protected:
+  void onVertices(float vertices[][4], size_type count);
+  void onTextures(float textures[][3], size_type count);
+  void onNormals(float normals[][3], size_type count);
+  void onParameters(float parameters[][3], size_type count);
+  void onFaces(index_array indices[], size_type const sizes[], size_type count);
+
+  // Unused: Only the batched callbacks are recorded.
+  void onVertex(float vertex[4]) { (void)vertex; }
+  void onTexture(float texture[3]) { (void)texture; }
+  void onNormal(float normal[3]) { (void)normal; }
+  void onParameter(float parameter[3]) { (void)parameter; }
+  void onFace(index_array indices[], size_type count) { (void)indices; (void)count; }
+  void onGroup(char *group) { (void)group; }
+  void onMaterial(char *file) { (void)file; }
+  void onUseMaterial(char *file) { (void)file; }
+  void onObject(char *obj) { (void)obj; }
+  void onSmooth(char *obj) { (void)obj; }
+};
+
+KObjChunkRecorder::KObjChunkRecorder(KAbstractReader *reader) :
+  KAbstractObjParser(reader), m_result(false)
+{
+  std::fill(m_counts, m_counts + FaceBatch + 1, 0);
+}
+
+void KObjChunkRecorder::record(ObjBatchType type, size_type count)
+{
+  // Merge consecutive batches of the same type into a single span.
+  m_counts[type] += count;
+  if (!m_records.empty() && m_records.back().m_type == type)
+  {
+    m_records.back().m_count += count;
+  }
+  else
+  {
+    Record r = { type, count };
+    m_records.push_back(r);
+  }
+}
+
+void KObjChunkRecorder::onVertices(float vertices[][4], size_type count)
+{
+  record(VertexBatch, count);
+  m_floats.insert(m_floats.end(), vertices[0], vertices[0] + 4 * count);
+}
+
+void KObjChunkRecorder::onTextures(float textures[][3], size_type count)
+{
+  record(TextureBatch, count);
+  m_floats.insert(m_floats.end(), textures[0], textures[0] + 3 * count);
+}
+
+void KObjChunkRecorder::onNormals(float normals[][3], size_type count)
+{
+  record(NormalBatch, count);
+  m_floats.insert(m_floats.end(), normals[0], normals[0] + 3 * count);
+}
+
+void KObjChunkRecorder::onParameters(float parameters[][3], size_type count)
+{
+  record(ParameterBatch, count);
+  m_floats.insert(m_floats.end(), parameters[0], parameters[0] + 3 * count);
+}
+
+void KObjChunkRecorder::onFaces(index_array indices[], size_type const sizes[], size_type count)
+{
+  record(FaceBatch, count);
+  m_indices.insert(m_indices.end(), indices, indices + std::accumulate(sizes, sizes + count, size_type(0)));
+  m_faceSizes.insert(m_faceSizes.end(), sizes, sizes + count);
+}
+
 /*******************************************************************************
  * ObjParser Private
  ******************************************************************************/
@@ -69,9 +224,11 @@ class KAbstractObjParserPrivate : public KAbstractLexer<ParseToken>
 public:
   typedef KAbstractObjParser::index_type index_type;
   typedef KAbstractObjParser::index_array index_array;
+  typedef KAbstractObjParser::size_type size_type;
   KAbstractObjParserPrivate(KAbstractObjParser *parser, KAbstractReader *reader);
 
   // Lexer
+  void lexReadDigits(uint32_t &integer, uint32_t &pow);
   int lexReadInteger(int *sign);
   int lexReadInteger(int *sign, int *power);
   token_id lexToken(token_type &token);
@@ -83,6 +240,8 @@ public:
 
   // Parser
   bool parse();
+  bool parseParallel();
+  void replay(KObjChunkRecorder &chunk);
   bool parseFloat(float &f);
   bool parseIndex(index_type &i);
   void parseVertex();
@@ -92,8 +251,14 @@ public:
   void parseFace();
   bool parseFaceIndices();
 
+  // Batching
+  inline void batchBegin(ObjBatchType type);
+  inline void batchFloats(ObjBatchType type, size_t stride);
+  void batchFlush();
+
 private:
   KAbstractObjParser *m_parser;
+  KAbstractReader *m_reader;
 
   // Statistics
   uint64_t m_vertexCount;
@@ -105,15 +270,23 @@ private:
   //Caches
   float m_float4[4];
   index_array m_index_array;
-  std::vector<index_array> m_vector_index_array;
+
+  // Batches
+  ObjBatchType m_batchType;
+  size_type m_batchCount;
+  std::vector<float> m_batchFloats;
+  std::vector<index_array> m_batchIndices;
+  std::vector<size_type> m_batchSizes;
 
 };
 
 KAbstractObjParserPrivate::KAbstractObjParserPrivate(KAbstractObjParser *parser, KAbstractReader *reader) :
-  KAbstractLexer<ParseToken>(reader), m_parser(parser),
-  m_vertexCount(0), m_textureCount(0), m_normalCount(0), m_parameterCount(0), m_faceCount(0)
+  KAbstractLexer<ParseToken>(reader), m_parser(parser), m_reader(reader),
+  m_vertexCount(0), m_textureCount(0), m_normalCount(0), m_parameterCount(0), m_faceCount(0),
+  m_batchType(NoBatch), m_batchCount(0)
 {
-  // Intentionally Empty
+  m_batchFloats.reserve(4 * sg_batchSize);
+  m_batchSizes.reserve(sg_batchSize);
 }
 
 /*******************************************************************************
@@ -163,34 +336,83 @@ KAbstractObjParserPrivate::token_id KAbstractObjParserPrivate::lexToken(token_ty
   }
 }
 
-int KAbstractObjParserPrivate::lexReadInteger(int *sign)
+// Note: Integers accumulate in unsigned arithmetic, which wraps identically to
+//       the digit-at-a-time int arithmetic this replaces, so results are exact.
+static inline bool isEightDigits(char const *pos)
 {
-  *sign = 1;
-  int integer = 0;
+  uint64_t v;
+  std::memcpy(&v, pos, sizeof(v));
+  return (((v & 0xF0F0F0F0F0F0F0F0) | (((v + 0x0606060606060606) & 0xF0F0F0F0F0F0F0F0) >> 4)) == 0x3333333333333333);
+}
 
-  // Check for negation
-  if (currChar() == '-')
-    *sign = -1;
-  else if (currChar() == '+')
-    ; // Do nothing, sign is already 1
-  else
-    integer = Karma::ctoi(currChar());
+static inline uint32_t readEightDigits(char const *pos)
+{
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+  uint64_t v;
+  std::memcpy(&v, pos, sizeof(v));
+  v = ((v & 0x0F0F0F0F0F0F0F0F) * 2561) >> 8;
+  v = ((v & 0x00FF00FF00FF00FF) * 6553601) >> 16;
+  return static_cast<uint32_t>(((v & 0x0000FFFF0000FFFF) * 42949672960001) >> 32);
+#else
+  uint32_t integer = 0;
+  for (int i = 0; i < 8; ++i)
+  {
+    integer = integer * 10 + static_cast<uint32_t>(Karma::ctoi(pos[i]));
+  }
+  return integer;
+#endif
+}
 
-  // Read the integer value
-  while (Karma::isNumeric(peekChar()))
+void KAbstractObjParserPrivate::lexReadDigits(uint32_t &integer, uint32_t &pow)
+{
+  char const *begin = spanPeek();
+
+  // Streamed: Read the integer value one character at a time
+  if (begin == Q_NULLPTR)
+  {
+    while (Karma::isNumeric(peekChar()))
+    {
+      pow *= 10;
+      integer *= 10;
+      integer += static_cast<uint32_t>(Karma::ctoi(nextChar()));
+    }
+    return;
+  }
+
+  // Contiguous: Consume eight digits at a time directly from the buffer
+  char const *end = spanEnd();
+  char const *pos = begin;
+  while (end - pos >= 8 && isEightDigits(pos))
   {
+    pow *= 100000000u;
+    integer *= 100000000u;
+    integer += readEightDigits(pos);
+    pos += 8;
+  }
+  while (pos != end && Karma::isNumeric(*pos))
+  {
+    pow *= 10;
     integer *= 10;
-    integer += Karma::ctoi(nextChar());
+    integer += static_cast<uint32_t>(Karma::ctoi(*pos));
+    ++pos;
   }
+  if (pos != begin)
+  {
+    spanSkip(pos);
+  }
+}
 
-  return integer;
+int KAbstractObjParserPrivate::lexReadInteger(int *sign)
+{
+  int power;
+  return lexReadInteger(sign, &power);
 }
 
 int KAbstractObjParserPrivate::lexReadInteger(int *sign, int *power)
 {
   *sign = 1;
-  int pow = 10;
-  int integer = 0;
+  uint32_t pow = 10;
+  uint32_t integer = 0;
 
   // Check for negation
   if (currChar() == '-')
@@ -198,18 +420,13 @@ int KAbstractObjParserPrivate::lexReadInteger(int *sign, int *power)
   else if (currChar() == '+')
     ; // Do nothing, sign is already 1
   else
-    integer = Karma::ctoi(currChar());
+    integer = static_cast<uint32_t>(Karma::ctoi(currChar()));
 
   // Read the integer value
-  while (Karma::isNumeric(peekChar()))
-  {
-    pow *= 10;
-    integer *= 10;
-    integer += Karma::ctoi(nextChar());
-  }
+  lexReadDigits(integer, pow);
 
-  (*power) = pow;
-  return integer;
+  (*power) = static_cast<int>(pow);
+  return static_cast<int>(integer);
 }
 
 KAbstractObjParserPrivate::token_id KAbstractObjParserPrivate::lexTokenInteger(token_type &token)
@@ -290,9 +507,11 @@ bool KAbstractObjParserPrivate::parse()
     switch (nextToken())
     {
     case PT_ERROR:
+      batchFlush();
       qFatal("Encountered an error! Aborting");
       return false;
     case PT_EOF:
+      batchFlush();
       return true;
     case PT_VERTEX:
       parseVertex();
@@ -316,6 +535,107 @@ bool KAbstractObjParserPrivate::parse()
   }
 }
 
+bool KAbstractObjParserPrivate::parseParallel()
+{
+  char const *begin = m_reader->data();
+  size_t size = m_reader->size();
+
+  // Chunking requires random access to the whole file.
+  if (begin == Q_NULLPTR || size < sg_minimumParallelBytes)
+  {
+    return parse();
+  }
+
+  // Split on line boundaries so no statement straddles two chunks.
+  char const *end = begin + size;
+  size_t chunkCount = std::min(Karma::idealThreadCount() * 4, size / sg_minimumChunkBytes);
+  std::vector<char const*> bounds;
+  bounds.push_back(begin);
+  for (size_t i = 1; i < chunkCount; ++i)
+  {
+    char const *split = begin + (size * i) / chunkCount;
+    if (split <= bounds.back()) continue;
+    char const *newline = static_cast<char const*>(std::memchr(split, '\n', static_cast<size_t>(end - split)));
+    if (newline == Q_NULLPTR) break;
+    bounds.push_back(newline + 1);
+  }
+  bounds.push_back(end);
+  chunkCount = bounds.size() - 1;
+
+  // Lex and parse every chunk independently.
+  std::vector<KObjChunkRecorder*> chunks(chunkCount);
+  Karma::parallelChunks(chunkCount, [&bounds, &chunks](size_t i)
+  {
+    KObjSpanReader reader(bounds[i], bounds[i + 1]);
+    chunks[i] = new KObjChunkRecorder(&reader);
+    chunks[i]->initialize();
+    chunks[i]->m_result = chunks[i]->parse();
+  });
+
+  // Totals are known up-front, let the consumer allocate once.
+  size_type counts[FaceBatch + 1] = { 0 };
+  for (KObjChunkRecorder *chunk : chunks)
+  {
+    for (int type = VertexBatch; type <= FaceBatch; ++type)
+    {
+      counts[type] += chunk->m_counts[type];
+    }
+  }
+  m_parser->onReserve(counts[VertexBatch], counts[TextureBatch], counts[NormalBatch], counts[ParameterBatch], counts[FaceBatch]);
+
+  // Replay results in file order; indices are forwarded verbatim exactly as
+  // the sequential parser does, so no cross-chunk fix-up is needed.
+  bool result = true;
+  for (KObjChunkRecorder *chunk : chunks)
+  {
+    result = result && chunk->m_result;
+    if (result) replay(*chunk);
+    delete chunk;
+  }
+  return result;
+}
+
+void KAbstractObjParserPrivate::replay(KObjChunkRecorder &chunk)
+{
+  float *floats = chunk.m_floats.data();
+  index_array *indices = chunk.m_indices.data();
+  size_type const *faceSizes = chunk.m_faceSizes.data();
+  for (KObjChunkRecorder::Record const &record : chunk.m_records)
+  {
+    size_type count = record.m_count;
+    switch (record.m_type)
+    {
+    case VertexBatch:
+      m_vertexCount += count;
+      m_parser->onVertices(reinterpret_cast<float(*)[4]>(floats), count);
+      floats += 4 * count;
+      break;
+    case TextureBatch:
+      m_textureCount += count;
+      m_parser->onTextures(reinterpret_cast<float(*)[3]>(floats), count);
+      floats += 3 * count;
+      break;
+    case NormalBatch:
+      m_normalCount += count;
+      m_parser->onNormals(reinterpret_cast<float(*)[3]>(floats), count);
+      floats += 3 * count;
+      break;
+    case ParameterBatch:
+      m_parameterCount += count;
+      m_parser->onParameters(reinterpret_cast<float(*)[3]>(floats), count);
+      floats += 3 * count;
+      break;
+    case FaceBatch:
+      m_parser->onFaces(indices, faceSizes, count);
+      indices += std::accumulate(faceSizes, faceSizes + count, size_type(0));
+      faceSizes += count;
+      break;
+    case NoBatch:
+      break;
+    }
+  }
+}
+
 bool KAbstractObjParserPrivate::parseFloat(float &f)
 {
   switch (peekToken().m_token)
@@ -351,7 +671,7 @@ void KAbstractObjParserPrivate::parseVertex()
   if (!parseFloat(m_float4[3]))
     m_float4[3] = 1.0f;
 
-  m_parser->onVertex(m_float4);
+  batchFloats(VertexBatch, 4);
 }
 
 void KAbstractObjParserPrivate::parseTexture()
@@ -362,7 +682,7 @@ void KAbstractObjParserPrivate::parseTexture()
   if (!parseFloat(m_float4[2]))
     m_float4[2] = 1.0f;
 
-  m_parser->onTexture(m_float4);
+  batchFloats(TextureBatch, 3);
 }
 
 void KAbstractObjParserPrivate::parseNormal()
@@ -372,7 +692,7 @@ void KAbstractObjParserPrivate::parseNormal()
   parseFloat(m_float4[1]);
   parseFloat(m_float4[2]);
 
-  m_parser->onNormal(m_float4);
+  batchFloats(NormalBatch, 3);
 }
 
 void KAbstractObjParserPrivate::parseParameter()
@@ -384,19 +704,21 @@ void KAbstractObjParserPrivate::parseParameter()
   else if (!parseFloat(m_float4[2]))
     m_float4[2] = 0.0f;
 
-  m_parser->onParameter(m_float4);
+  batchFloats(ParameterBatch, 3);
 }
 
 void KAbstractObjParserPrivate::parseFace()
 {
-  m_vector_index_array.clear();
+  batchBegin(FaceBatch);
+  size_t first = m_batchIndices.size();
 
   while ( parseFaceIndices() )
   {
-    m_vector_index_array.push_back(m_index_array);
+    m_batchIndices.push_back(m_index_array);
   }
 
-  m_parser->onFace(m_vector_index_array.data(), m_vector_index_array.size());
+  m_batchSizes.push_back(m_batchIndices.size() - first);
+  ++m_batchCount;
 }
 
 bool KAbstractObjParserPrivate::parseFaceIndices()
@@ -436,6 +758,56 @@ bool KAbstractObjParserPrivate::parseFaceIndices()
   return true;
 }
 
+/*******************************************************************************
+ * Batch Definitions
+ ******************************************************************************/
+
+inline void KAbstractObjParserPrivate::batchBegin(ObjBatchType type)
+{
+  if (m_batchType != type || m_batchCount == sg_batchSize)
+  {
+    batchFlush();
+    m_batchType = type;
+  }
+}
+
+inline void KAbstractObjParserPrivate::batchFloats(ObjBatchType type, size_t stride)
+{
+  batchBegin(type);
+  m_batchFloats.insert(m_batchFloats.end(), m_float4, m_float4 + stride);
+  ++m_batchCount;
+}
+
+void KAbstractObjParserPrivate::batchFlush()
+{
+  float *floats = m_batchFloats.data();
+  switch (m_batchType)
+  {
+  case VertexBatch:
+    m_parser->onVertices(reinterpret_cast<float(*)[4]>(floats), m_batchCount);
+    break;
+  case TextureBatch:
+    m_parser->onTextures(reinterpret_cast<float(*)[3]>(floats), m_batchCount);
+    break;
+  case NormalBatch:
+    m_parser->onNormals(reinterpret_cast<float(*)[3]>(floats), m_batchCount);
+    break;
+  case ParameterBatch:
+    m_parser->onParameters(reinterpret_cast<float(*)[3]>(floats), m_batchCount);
+    break;
+  case FaceBatch:
+    m_parser->onFaces(m_batchIndices.data(), m_batchSizes.data(), m_batchCount);
+    break;
+  case NoBatch:
+    break;
+  }
+  m_batchType = NoBatch;
+  m_batchCount = 0;
+  m_batchFloats.clear();
+  m_batchIndices.clear();
+  m_batchSizes.clear();
+}
+
 /*******************************************************************************
  * ObjParser
  ******************************************************************************/
@@ -447,14 +819,82 @@ KAbstractObjParser::KAbstractObjParser(KAbstractReader *reader) :
   // Intentionally Empty
 }
 
+KAbstractObjParser::~KAbstractObjParser()
+{
+  delete m_private;
+}
+
 bool KAbstractObjParser::parse()
 {
   P(KAbstractObjParserPrivate);
   return p.parse();
 }
 
+bool KAbstractObjParser::parse(ParseMethod method)
+{
+  P(KAbstractObjParserPrivate);
+  switch (method)
+  {
+  case SequentialMethod:
+    return p.parse();
+  case ParallelMethod:
+    return p.parseParallel();
+  }
+  return false;
+}
+
 void KAbstractObjParser::initialize()
 {
   P(KAbstractObjParserPrivate);
   p.initializeLexer();
 }
+
+void KAbstractObjParser::onReserve(size_type vertices, size_type textures, size_type normals, size_type parameters, size_type faces)
+{
+  (void)vertices;
+  (void)textures;
+  (void)normals;
+  (void)parameters;
+  (void)faces;
+}
+
+void KAbstractObjParser::onVertices(float vertices[][4], size_type count)
+{
+  for (size_type i = 0; i < count; ++i)
+  {
+    onVertex(vertices[i]);
+  }
+}
+
+void KAbstractObjParser::onTextures(float textures[][3], size_type count)
+{
+  for (size_type i = 0; i < count; ++i)
+  {
+    onTexture(textures[i]);
+  }
+}
+
+void KAbstractObjParser::onNormals(float normals[][3], size_type count)
+{
+  for (size_type i = 0; i < count; ++i)
+  {
+    onNormal(normals[i]);
+  }
+}
+
+void KAbstractObjParser::onParameters(float parameters[][3], size_type count)
+{
+  for (size_type i = 0; i < count; ++i)
+  {
+    onParameter(parameters[i]);
+  }
+}
+
+void KAbstractObjParser::onFaces(index_array indices[], size_type const sizes[], size_type count)
+{
+  for (size_type i = 0; i < count; ++i)
+  {
+    onFace(indices, sizes[i]);
+    indices += sizes[i];
+  }
+}
@@ -14,8 +14,15 @@ public:
   typedef uint64_t index_pair;
   typedef uint64_t size_type;
   typedef std::array<index_type, 3> index_array;
+  enum ParseMethod
+  {
+    SequentialMethod,
+    ParallelMethod
+  };
   KAbstractObjParser(KAbstractReader *reader);
+  virtual ~KAbstractObjParser();
   bool parse();
+  bool parse(ParseMethod method);
   void initialize();
 protected:
   virtual void onVertex(float vertex[4]) = 0;
@@ -28,6 +35,16 @@ protected:
   virtual void onUseMaterial(char *file) = 0;
   virtual void onObject(char *obj) = 0;
   virtual void onSmooth(char *obj) = 0;
+
+  // Batched Callbacks (Optional: Defaults forward to the per-element callbacks)
+  // Note: Spans are only valid for the duration of the call. Face indices are
+  //       packed back-to-back, sizes[i] being the index count of face i.
+  virtual void onReserve(size_type vertices, size_type textures, size_type normals, size_type parameters, size_type faces);
+  virtual void onVertices(float vertices[][4], size_type count);
+  virtual void onTextures(float textures[][3], size_type count);
+  virtual void onNormals(float normals[][3], size_type count);
+  virtual void onParameters(float parameters[][3], size_type count);
+  virtual void onFaces(index_array indices[], size_type const sizes[], size_type count);
 private:
   KAbstractObjParserPrivate *m_private;
   friend class KAbstractObjParserPrivate;
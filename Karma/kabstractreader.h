@@ -1,11 +1,27 @@
 #ifndef KABSTRACTREADER_H
 #define KABSTRACTREADER_H KAbstractReader
 
+#include <cstddef>
+
 class KAbstractReader
 {
 public:
   static const int EndOfFile = -1;
   virtual int next() = 0;
+
+  // Contiguous access (Optional: Null if the reader is streamed)
+  virtual char const *data() const;
+  virtual size_t size() const;
 };
 
+inline char const *KAbstractReader::data() const
+{
+  return 0;
+}
+
+inline size_t KAbstractReader::size() const
+{
+  return 0;
+}
+
 #endif // KABSTRACTREADER_H
@@ -9,6 +9,76 @@
 #include <KTrianglePartition>
 #include <KTrianglePointIterator>
 #include <OpenGLDebugDraw>
+#include <KParallel>
+#include <KCacheFile>
+#include <atomic>
+#include <random>
+
+// Children above this many triangles are built concurrently, and partitioned
+// in parallel above the second threshold.
+static const size_t sg_parallelBuildThreshold = size_t(1) << 12;
+static const size_t sg_parallelPartitionThreshold = size_t(1) << 16;
+
+// Debug colors come from the node's position in the build, not from rand(), so
+// that concurrent builds color the same way every time.
+static KColor debugColor(size_t seed)
+{
+  std::minstd_rand random(static_cast<std::minstd_rand::result_type>(seed * 2654435761u + 1));
+  std::uniform_real_distribution<float> channel(0.0f, 1.0f);
+  float r = channel(random);
+  float g = channel(random);
+  float b = channel(random);
+  return KColor(r, g, b);
+}
+
+/*******************************************************************************
+ * Adaptive Octree Cache (See KAdaptiveOctree::save())
+ ******************************************************************************/
+// Layout: Header, Nodes (Pre-order), Objects (each array 16-byte aligned).
+// Every node's objects are a range of the object array, which holds the
+// triangles (1-based point indices) in the order the build partitioned them.
+// Note: Bump the version whenever the node layout changes.
+static char const sg_cacheMagic[4] = { 'K', 'O', 'C', 'T' };
+static const uint32_t sg_cacheVersion = 1;
+static const uint32_t sg_cacheNoChild = ~uint32_t(0);
+
+struct KAdaptiveOctreeCacheHeader
+{
+  char magic[4];
+  uint32_t version;
+  uint32_t nodeSize;
+  uint32_t method;
+  uint64_t sourceChecksum;
+  uint32_t depth;
+  uint32_t reserved;
+  uint64_t numNodes;
+  uint64_t numObjects;
+};
+
+struct KAdaptiveOctreeCacheNode
+{
+  float min[3];
+  float max[3];
+  uint32_t color;
+  uint32_t depth;
+  uint32_t children[8];
+  uint32_t firstObject;
+  uint32_t objectCount;
+};
+
+struct KAdaptiveOctreeCacheObject
+{
+  uint32_t indices[3];
+};
+
+static KAdaptiveOctreeCacheHeader cacheHeader(uint64_t sourceChecksum, KGeometryCloud::BuildMethod method)
+{
+  KAdaptiveOctreeCacheHeader header = KCacheFile::header<KAdaptiveOctreeCacheHeader>(sg_cacheMagic, sg_cacheVersion);
+  header.nodeSize = sizeof(KAdaptiveOctreeCacheNode);
+  header.method = static_cast<uint32_t>(method);
+  header.sourceChecksum = sourceChecksum;
+  return header;
+}
 
 /*******************************************************************************
  * KAdaptiveOctreeNode
@@ -18,7 +88,7 @@ class KAdaptiveOctreeNode
 public:
   typedef KTriangleIndexCloud::ConstIterator ConstIterator;
 
-  KAdaptiveOctreeNode(size_t depth, KAabbBoundingVolume const &aabb, KPointCloud &cloud);
+  KAdaptiveOctreeNode(size_t depth, size_t seed, KAabbBoundingVolume const &aabb, KPointCloud &cloud);
   bool isLeaf() const;
   void debugDraw(KTransform3D &trans, size_t min, size_t max) const;
 
@@ -30,8 +100,8 @@ public:
   KTriangleIndexCloud m_objects;
 };
 
-KAdaptiveOctreeNode::KAdaptiveOctreeNode(size_t depth, KAabbBoundingVolume const &aabb, KPointCloud &cloud) :
-  m_depth(depth), m_color(float(std::rand()) / RAND_MAX, float(std::rand()) / RAND_MAX, float(std::rand()) / RAND_MAX), m_pointCloud(cloud), m_aabb(aabb)
+KAdaptiveOctreeNode::KAdaptiveOctreeNode(size_t depth, size_t seed, KAabbBoundingVolume const &aabb, KPointCloud &cloud) :
+  m_depth(depth), m_color(debugColor(seed)), m_pointCloud(cloud), m_aabb(aabb)
 {
   for (int i = 0; i < 8; ++i)
   {
@@ -80,15 +150,21 @@ public:
   void buildBottomUp(TerminationPred pred);
   void buildTopDown(TerminationPred pred);
   KAdaptiveOctreeNode* recursiveTopDown(size_t depth, KAabbBoundingVolume aabb, TriangleIterator begin, TriangleIterator end, TerminationPred pred);
+  bool readCache(QString const &fileName, KAdaptiveOctreeCacheHeader const &expected, KPointCloud const &pointCloud);
+  bool writeCache(QString const &fileName) const;
+  uint32_t flattenNode(KAdaptiveOctreeNode const *node, std::vector<KAdaptiveOctreeCacheNode> &nodes, std::vector<KAdaptiveOctreeCacheObject> &objects) const;
+  void collectStatistics(KAdaptiveOctreeNode const *node, KGeometryCloud::Statistics &stats, float &weightedArea) const;
 
-  size_t m_maxDepth;
+  std::atomic<size_t> m_maxDepth;
   KGeometryCloud m_parent;
   KPointCloud m_pointCloud;
   KAdaptiveOctreeNode *m_root;
+  KGeometryCloud::BuildMethod m_method;
+  uint64_t m_sourceChecksum;
 };
 
 KAdaptiveOctreePrivate::KAdaptiveOctreePrivate(KGeometryCloud &parent) :
-  m_parent(parent), m_root(0)
+  m_maxDepth(0), m_parent(parent), m_root(0), m_method(KGeometryCloud::TopDownMethod), m_sourceChecksum(0)
 {
   // Intentionally Empty
 }
@@ -114,11 +190,12 @@ KAdaptiveOctreeNode* KAdaptiveOctreePrivate::recursiveTopDown(size_t depth, KAab
 {
   KPointCloud const & pointCloud = m_parent.pointCloud();
   size_t numTriangles = std::distance(begin, end);
-  if (m_maxDepth < depth) m_maxDepth = depth;
+  size_t offset = std::distance(m_parent.triangleIndexCloud().begin(), begin);
+  Karma::atomicMax(m_maxDepth, depth);
 
   // Check if the predicate was met (terminating condition)
-  KAdaptiveOctreeNode *node = new KAdaptiveOctreeNode(depth, aabb, m_pointCloud);
-  if (pred(numTriangles, m_maxDepth))
+  KAdaptiveOctreeNode *node = new KAdaptiveOctreeNode(depth, (offset << 8) ^ depth, aabb, m_pointCloud);
+  if (pred(numTriangles, depth))
   {
     node->m_objects.copy(begin, end);
     return node;
@@ -139,14 +216,31 @@ KAdaptiveOctreeNode* KAdaptiveOctreePrivate::recursiveTopDown(size_t depth, KAab
     aabb.copyOffset(-extent,  extent, -extent)
   };
 
-  // Create all OctNodes
-  TriangleIterator prevIter = begin;
-  TriangleIterator currIter = end;
+  // Partition into all OctNodes first, then build them
+  TriangleIterator bounds[9];
+  bounds[0] = begin;
   for (int i = 0; i < 8; ++i)
   {
-    currIter = std::partition(prevIter, end, KTrianglePartitionInsideAabb(pointCloud, aabbList[i]));
-    node->m_children[i] = recursiveTopDown(depth + 1, aabbList[i], prevIter, currIter, pred);
-    prevIter = currIter;
+    KTrianglePartitionInsideAabb inside(pointCloud, aabbList[i]);
+    if (static_cast<size_t>(std::distance(bounds[i], end)) >= sg_parallelPartitionThreshold)
+      bounds[i + 1] = Karma::parallelPartition(bounds[i], end, inside);
+    else
+      bounds[i + 1] = std::partition(bounds[i], end, inside);
+  }
+  auto buildChild = [&](size_t i)
+  {
+    node->m_children[i] = recursiveTopDown(depth + 1, aabbList[i], bounds[i], bounds[i + 1], pred);
+  };
+  if (numTriangles >= sg_parallelBuildThreshold)
+  {
+    Karma::parallelTasks(0, 8, buildChild);
+  }
+  else
+  {
+    for (size_t i = 0; i < 8; ++i)
+    {
+      buildChild(i);
+    }
   }
 
   // Grab remaining indices
@@ -154,6 +248,154 @@ KAdaptiveOctreeNode* KAdaptiveOctreePrivate::recursiveTopDown(size_t depth, KAab
   return node;
 }
 
+bool KAdaptiveOctreePrivate::readCache(QString const &fileName, KAdaptiveOctreeCacheHeader const &expected, KPointCloud const &pointCloud)
+{
+  // Validate the header against this build and the geometry it should match
+  KCacheFileReader reader(fileName);
+  KAdaptiveOctreeCacheHeader header;
+  if (!reader.readHeader(header, expected) ||
+      header.nodeSize != expected.nodeSize ||
+      header.method != expected.method ||
+      header.sourceChecksum != expected.sourceChecksum ||
+      header.numNodes == 0)
+  {
+    return false;
+  }
+
+  // Validate the payload size
+  if (header.numNodes > sg_cacheNoChild) return false;
+  KAdaptiveOctreeCacheNode const *nodes = reader.readSection<KAdaptiveOctreeCacheNode>(header.numNodes);
+  KAdaptiveOctreeCacheObject const *objects = reader.readSection<KAdaptiveOctreeCacheObject>(header.numObjects);
+  if (!nodes || !objects) return false;
+
+  // Children always follow their parent and every node but the root has
+  // exactly one parent, so the nodes form a tree. Depths come from that tree
+  // rather than from the file. Object ranges must stay within the file.
+  std::vector<uint32_t> depths(header.numNodes, sg_cacheNoChild);
+  depths[0] = 0;
+  size_t maxDepth = 0;
+  for (size_t i = 0; i < header.numNodes; ++i)
+  {
+    KAdaptiveOctreeCacheNode const &node = nodes[i];
+    if (depths[i] == sg_cacheNoChild || uint64_t(node.firstObject) + node.objectCount > header.numObjects) return false;
+    for (uint32_t child : node.children)
+    {
+      if (child == sg_cacheNoChild) continue;
+      if (child <= i || child >= header.numNodes || depths[child] != sg_cacheNoChild) return false;
+      depths[child] = depths[i] + 1;
+      maxDepth = std::max<size_t>(maxDepth, depths[child]);
+    }
+  }
+  for (size_t i = 0; i < header.numObjects; ++i)
+  {
+    for (int k = 0; k < 3; ++k)
+    {
+      if (objects[i].indices[k] == 0 || objects[i].indices[k] > pointCloud.size()) return false;
+    }
+  }
+
+  // Create every node, then link them (Children have larger indices)
+  m_pointCloud = pointCloud;
+  std::vector<KAdaptiveOctreeNode*> created(header.numNodes);
+  for (size_t i = 0; i < header.numNodes; ++i)
+  {
+    KAdaptiveOctreeCacheNode const &cached = nodes[i];
+    Karma::MinMaxKVector3D minMax;
+    minMax.min = KVector3D(cached.min[0], cached.min[1], cached.min[2]);
+    minMax.max = KVector3D(cached.max[0], cached.max[1], cached.max[2]);
+    KAabbBoundingVolume aabb;
+    aabb.setMinMaxBounds(minMax);
+    KAdaptiveOctreeNode *node = new KAdaptiveOctreeNode(depths[i], i, aabb, m_pointCloud);
+    node->m_color = KColor(static_cast<QRgb>(cached.color));
+    node->m_objects.reserve(cached.objectCount);
+    for (KAdaptiveOctreeCacheObject const *object = objects + cached.firstObject; object != objects + cached.firstObject + cached.objectCount; ++object)
+    {
+      node->m_objects.emplace_back(KTriangleIndexCloud::ElementType(object->indices[0], object->indices[1], object->indices[2]));
+    }
+    created[i] = node;
+  }
+  for (size_t i = 0; i < header.numNodes; ++i)
+  {
+    for (int c = 0; c < 8; ++c)
+    {
+      if (nodes[i].children[c] != sg_cacheNoChild) created[i]->m_children[c] = created[nodes[i].children[c]];
+    }
+  }
+  m_root = created[0];
+  m_maxDepth = maxDepth;
+  return true;
+}
+
+bool KAdaptiveOctreePrivate::writeCache(QString const &fileName) const
+{
+  std::vector<KAdaptiveOctreeCacheNode> nodes;
+  std::vector<KAdaptiveOctreeCacheObject> objects;
+  flattenNode(m_root, nodes, objects);
+
+  KCacheFileWriter file(fileName);
+  if (!file.valid()) return false;
+
+  KAdaptiveOctreeCacheHeader header = cacheHeader(m_sourceChecksum, m_method);
+  header.depth = static_cast<uint32_t>(m_maxDepth);
+  header.numNodes = nodes.size();
+  header.numObjects = objects.size();
+
+  file.writeSection(&header, sizeof(KAdaptiveOctreeCacheHeader));
+  file.writeSection(nodes.data(), nodes.size() * sizeof(KAdaptiveOctreeCacheNode));
+  file.writeSection(objects.data(), objects.size() * sizeof(KAdaptiveOctreeCacheObject));
+  return file.commit();
+}
+
+uint32_t KAdaptiveOctreePrivate::flattenNode(KAdaptiveOctreeNode const *node, std::vector<KAdaptiveOctreeCacheNode> &nodes, std::vector<KAdaptiveOctreeCacheObject> &objects) const
+{
+  uint32_t index = static_cast<uint32_t>(nodes.size());
+  KAdaptiveOctreeCacheNode cached;
+  KVector3D const &min = node->m_aabb.minExtent();
+  KVector3D const &max = node->m_aabb.maxExtent();
+  cached.min[0] = min.x(); cached.min[1] = min.y(); cached.min[2] = min.z();
+  cached.max[0] = max.x(); cached.max[1] = max.y(); cached.max[2] = max.z();
+  cached.color = static_cast<uint32_t>(node->m_color.rgba());
+  cached.depth = static_cast<uint32_t>(node->m_depth);
+  cached.firstObject = static_cast<uint32_t>(objects.size());
+  cached.objectCount = static_cast<uint32_t>(node->m_objects.size());
+  for (KTriangleIndexCloud::ElementType const &elm : node->m_objects)
+  {
+    KAdaptiveOctreeCacheObject object = { { static_cast<uint32_t>(elm.indices[0]), static_cast<uint32_t>(elm.indices[1]), static_cast<uint32_t>(elm.indices[2]) } };
+    objects.push_back(object);
+  }
+  nodes.push_back(cached);
+  for (int c = 0; c < 8; ++c)
+  {
+    uint32_t child = (node->m_children[c]) ? flattenNode(node->m_children[c], nodes, objects) : sg_cacheNoChild;
+    nodes[index].children[c] = child;
+  }
+  return index;
+}
+
+static float surfaceArea(KAabbBoundingVolume const &aabb)
+{
+  KVector3D extent = aabb.maxExtent() - aabb.minExtent();
+  return 2.0f * (extent.x() * extent.y() + extent.y() * extent.z() + extent.z() * extent.x());
+}
+
+// Accumulates the SAH numerator (Unit cost per node visit and per triangle)
+void KAdaptiveOctreePrivate::collectStatistics(KAdaptiveOctreeNode const *node, KGeometryCloud::Statistics &stats, float &weightedArea) const
+{
+  ++stats.nodes;
+  stats.memory += sizeof(KAdaptiveOctreeNode) + node->m_objects.size() * sizeof(KTriangleIndexCloud::ElementType);
+  if (node->isLeaf())
+  {
+    stats.addLeaf(node->m_objects.size());
+    weightedArea += surfaceArea(node->m_aabb) * node->m_objects.size();
+    return;
+  }
+  weightedArea += surfaceArea(node->m_aabb);
+  for (int i = 0; i < 8; ++i)
+  {
+    if (node->m_children[i]) collectStatistics(node->m_children[i], stats, weightedArea);
+  }
+}
+
 /*******************************************************************************
  * KAdaptiveOctree
  ******************************************************************************/
@@ -186,6 +428,8 @@ void KAdaptiveOctree::build(BuildMethod method, TerminationPred pred)
 
   // If there is no new geometry to build, do nothing.
   if (!dirty()) return;
+  p.m_method = method;
+  p.m_sourceChecksum = checksum();
 
   // Build based on selected method
   switch (method)
@@ -196,6 +440,9 @@ void KAdaptiveOctree::build(BuildMethod method, TerminationPred pred)
   case TopDownMethod:
     p.buildTopDown(pred);
     break;
+  case SurfaceAreaMethod:
+    qFatal("Unsupported Build Method!");
+    break;
   }
 
   // We no longer need this data
@@ -207,6 +454,49 @@ void KAdaptiveOctree::build(BuildMethod method, TerminationPred pred)
   //       understand the "drawable range" of the children.
 }
 
+KGeometryCloud::Statistics KAdaptiveOctree::statistics() const
+{
+  P(const KAdaptiveOctreePrivate);
+  Statistics stats;
+  if (p.m_root)
+  {
+    float weightedArea = 0.0f;
+    p.collectStatistics(p.m_root, stats, weightedArea);
+    float rootArea = surfaceArea(p.m_root->m_aabb);
+    stats.sahCost = (rootArea > 0.0f) ? weightedArea / rootArea : 0.0f;
+  }
+  stats.depth = p.m_maxDepth;
+  stats.memory += p.m_pointCloud.size() * sizeof(KVector3D);
+  return stats;
+}
+
+// Writes the built tree with every node's (partitioned) triangles, so load()
+// can skip construction.
+bool KAdaptiveOctree::save(QString const &fileName) const
+{
+  P(const KAdaptiveOctreePrivate);
+  if (!p.m_root) return false;
+  return p.writeCache(fileName);
+}
+
+// Use in place of build() with the same geometry added; returns false (and
+// changes nothing) unless the file was saved from identical geometry and method.
+// Note: The termination predicate cannot be verified, version the file name by it.
+bool KAdaptiveOctree::load(QString const &fileName, BuildMethod method, TerminationPred pred)
+{
+  P(KAdaptiveOctreePrivate);
+  (void)pred;
+  if (!dirty()) return false;
+  uint64_t sourceChecksum = checksum();
+  if (!p.readCache(fileName, cacheHeader(sourceChecksum, method), pointCloud())) return false;
+  p.m_method = method;
+  p.m_sourceChecksum = sourceChecksum;
+
+  // We no longer need this data
+  KGeometryCloud::clear();
+  return true;
+}
+
 void KAdaptiveOctree::debugDraw(size_t min, size_t max)
 {
   KTransform3D trans;
@@ -4,6 +4,7 @@
 class KColor;
 class KHalfEdgeMesh;
 class KTransform3D;
+class QString;
 #include <cstddef>
 #include <KGeometryCloud>
 #include <KSharedPointer>
@@ -18,6 +19,9 @@ public:
   void clear();
   size_t depth() const;
   void build(BuildMethod method, TerminationPred pred);
+  Statistics statistics() const;
+  bool save(QString const &fileName) const;
+  bool load(QString const &fileName, BuildMethod method, TerminationPred pred);
   void debugDraw(size_t min = 0, size_t max = std::numeric_limits<size_t>::max());
   void debugDraw(KTransform3D &trans, size_t min = 0, size_t max = std::numeric_limits<size_t>::max());
 
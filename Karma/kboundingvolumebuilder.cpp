@@ -0,0 +1,255 @@
+#include "kboundingvolumebuilder.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include <KMacros>
+#include <KHalfEdgeMesh>
+#include <KEposSphere>
+
+/*******************************************************************************
+ * KBoundingVolumeBuilderPrivate
+ ******************************************************************************/
+struct SphereBounds
+{
+  KVector3D centroid;
+  float radius;
+  void expandToContainPoint(KVector3D const &v);
+};
+
+inline void SphereBounds::expandToContainPoint(KVector3D const &v)
+{
+  KVector3D delta = v - centroid;
+  float dist2 = delta.lengthSquared();
+  if (dist2 > radius * radius)
+  {
+    float dist = std::sqrt(dist2);
+    float newRadius = (radius + dist) / 2.0f;
+    float radiusScalar = (newRadius - radius) / dist;
+    radius = newRadius;
+    centroid += delta * radiusScalar;
+  }
+}
+
+class KBoundingVolumeBuilderPrivate
+{
+public:
+  KBoundingVolumeBuilderPrivate(KHalfEdgeMesh const &mesh);
+  void calculateMoments();
+  void calculateAxes();
+  void calculateExpansions();
+  Karma::MinMaxKVector3DContainer extremalPointsAlong(std::vector<KVector3D> axes) const;
+
+  KHalfEdgeMesh const &mesh;
+  KHalfEdgeMesh::VertexContainer const &vertices;
+
+  // Shared Moments
+  Karma::MinMaxKVector3D bounds;
+  KVector3D centroid;
+  KMatrix3x3 covariance;
+  KMatrix3x3 eigenVectors;
+  Karma::MinMaxKVector3DContainer coordinateExtremal;  // Along x, y and z
+  Karma::MinMaxKVector3DContainer eigenExtremal;       // Along the eigenvectors by decreasing eigenvalue
+
+  // Derived Volumes
+  SphereBounds centroidSphere;
+  SphereBounds rittersSphere;
+  SphereBounds larssonsSphere;
+  SphereBounds pcaSphere;
+  KVector3D orientedCentroid;
+  KVector3D orientedExtents;
+};
+
+KBoundingVolumeBuilderPrivate::KBoundingVolumeBuilderPrivate(KHalfEdgeMesh const &mesh) :
+  mesh(mesh), vertices(mesh.vertices())
+{
+  eigenVectors.setToIdentity();
+  covariance.setToIdentity();
+  centroidSphere.radius = rittersSphere.radius = larssonsSphere.radius = pcaSphere.radius = 0.0f;
+  orientedExtents = KVector3D(0.0f, 0.0f, 0.0f);
+  if (vertices.empty())
+  {
+    bounds.min = bounds.max = KVector3D(0.0f, 0.0f, 0.0f);
+    return;
+  }
+  calculateMoments();
+  calculateAxes();
+  calculateExpansions();
+}
+
+Karma::MinMaxKVector3DContainer KBoundingVolumeBuilderPrivate::extremalPointsAlong(std::vector<KVector3D> axes) const
+{
+  return Karma::findExtremalPointsAlongAxes(
+    vertices.begin(),
+    vertices.end(),
+    axes.begin(),
+    axes.end(),
+    KHalfEdgeMesh::VertexPositionPred()
+  );
+}
+
+// Centroid, covariance and extremal points along the EPOS-6 axes (x, y and z).
+void KBoundingVolumeBuilderPrivate::calculateMoments()
+{
+  centroid = Karma::findAverageCentroid(vertices.begin(), vertices.end(), KHalfEdgeMesh::VertexPositionPred());
+  covariance = Karma::covarianceMatrix(vertices.begin(), vertices.end(), KHalfEdgeMesh::VertexPositionPred());
+  eigenVectors = Karma::symmetricEigen(covariance);
+
+  std::vector<KVector3D> axes;
+  axes.push_back(KVector3D(1.0f, 0.0f, 0.0f));
+  axes.push_back(KVector3D(0.0f, 1.0f, 0.0f));
+  axes.push_back(KVector3D(0.0f, 0.0f, 1.0f));
+  coordinateExtremal = extremalPointsAlong(axes);
+  KMinMaxVectorCloud const &extremal = coordinateExtremal;
+  bounds.min = KVector3D(extremal[0].min.x(), extremal[1].min.y(), extremal[2].min.z());
+  bounds.max = KVector3D(extremal[0].max.x(), extremal[1].max.y(), extremal[2].max.z());
+
+  // Larsson's: Smallest sphere around the extremal points
+  KEposSphere epos(extremal);
+  larssonsSphere.centroid = epos.centroid;
+  larssonsSphere.radius = epos.radius;
+
+  // Ritter's: Sphere around the most separated pair of extremal points
+  float dist2[3];
+  for (int k = 0; k < 3; ++k)
+  {
+    dist2[k] = (extremal[k].max - extremal[k].min).lengthSquared();
+  }
+  int axis = 0;
+  if (dist2[1] > dist2[0] && dist2[1] > dist2[2]) axis = 1;
+  if (dist2[2] > dist2[0] && dist2[2] > dist2[1]) axis = 2;
+  rittersSphere.centroid = (extremal[axis].min + extremal[axis].max) / 2.0f;
+  rittersSphere.radius = (extremal[axis].max - rittersSphere.centroid).length();
+}
+
+// Extremal points along the eigenvectors.
+void KBoundingVolumeBuilderPrivate::calculateAxes()
+{
+  eigenExtremal = extremalPointsAlong(Karma::decomposeMatrixeByColumnVectors(eigenVectors));
+
+  // PCA: Extremal points along the dominant eigenvector
+  KVector3D const &pcaMin = eigenExtremal[0].min;
+  KVector3D const &pcaMax = eigenExtremal[0].max;
+  pcaSphere.radius = (pcaMax - pcaMin).length() / 2.0f;
+  pcaSphere.centroid = (pcaMax + pcaMin) / 2.0f;
+
+  // Oriented: Projected extents along every eigenvector (See KOrientedBoundingVolume)
+  Karma::orientedBounds(eigenVectors, eigenExtremal, &orientedCentroid, &orientedExtents);
+}
+
+// Growing a sphere depends on vertex order, so the three spheres which grow
+// to contain every vertex share a single sequential sweep with the furthest
+// vertex from the centroid.
+void KBoundingVolumeBuilderPrivate::calculateExpansions()
+{
+  float maxDistance2 = 0.0f;
+  for (KHalfEdgeMesh::Vertex const &v : vertices)
+  {
+    maxDistance2 = std::max(maxDistance2, (centroid - v.position).lengthSquared());
+    rittersSphere.expandToContainPoint(v.position);
+    larssonsSphere.expandToContainPoint(v.position);
+    pcaSphere.expandToContainPoint(v.position);
+  }
+
+  // Centroid: Furthest vertex from the mean
+  centroidSphere.centroid = centroid;
+  centroidSphere.radius = std::sqrt(maxDistance2);
+}
+
+/*******************************************************************************
+ * KBoundingVolumeBuilder
+ ******************************************************************************/
+KBoundingVolumeBuilder::KBoundingVolumeBuilder(KHalfEdgeMesh const &mesh) :
+  m_private(new KBoundingVolumeBuilderPrivate(mesh))
+{
+  // Intentionally Empty
+}
+
+KBoundingVolumeBuilder::~KBoundingVolumeBuilder()
+{
+  delete m_private;
+}
+
+Karma::MinMaxKVector3D const &KBoundingVolumeBuilder::bounds() const
+{
+  P(const KBoundingVolumeBuilderPrivate);
+  return p.bounds;
+}
+
+KVector3D const &KBoundingVolumeBuilder::centroid() const
+{
+  P(const KBoundingVolumeBuilderPrivate);
+  return p.centroid;
+}
+
+KMatrix3x3 const &KBoundingVolumeBuilder::covariance() const
+{
+  P(const KBoundingVolumeBuilderPrivate);
+  return p.covariance;
+}
+
+KMatrix3x3 const &KBoundingVolumeBuilder::eigenVectors() const
+{
+  P(const KBoundingVolumeBuilderPrivate);
+  return p.eigenVectors;
+}
+
+KAabbBoundingVolume *KBoundingVolumeBuilder::createAabb(KAabbBoundingVolume::Method method) const
+{
+  P(const KBoundingVolumeBuilderPrivate);
+  KAabbBoundingVolume *aabb = new KAabbBoundingVolume;
+  switch (method)
+  {
+  case KAabbBoundingVolume::MinMaxMethod:
+    aabb->setMinMaxBounds(p.bounds);
+    break;
+  }
+  return aabb;
+}
+
+KSphereBoundingVolume *KBoundingVolumeBuilder::createSphere(KSphereBoundingVolume::Method method, KSphereBoundingVolume::Accuracy accuracy) const
+{
+  P(const KBoundingVolumeBuilderPrivate);
+  if (method == KSphereBoundingVolume::LarssonsMethod && accuracy != KSphereBoundingVolume::Epos6Accuracy)
+  {
+    return new KSphereBoundingVolume(p.mesh, method, accuracy);
+  }
+  SphereBounds const *sphere = &p.centroidSphere;
+  switch (method)
+  {
+  case KSphereBoundingVolume::CentroidMethod:
+    sphere = &p.centroidSphere;
+    break;
+  case KSphereBoundingVolume::RittersMethod:
+    sphere = &p.rittersSphere;
+    break;
+  case KSphereBoundingVolume::LarssonsMethod:
+    sphere = &p.larssonsSphere;
+    break;
+  case KSphereBoundingVolume::PcaMethod:
+    sphere = &p.pcaSphere;
+    break;
+  }
+  return new KSphereBoundingVolume(sphere->centroid, sphere->radius);
+}
+
+KOrientedBoundingVolume *KBoundingVolumeBuilder::createObb(KOrientedBoundingVolume::Method method) const
+{
+  P(const KBoundingVolumeBuilderPrivate);
+  switch (method)
+  {
+  case KOrientedBoundingVolume::PcaMethod:
+    break;
+  }
+  return new KOrientedBoundingVolume(p.orientedCentroid, p.eigenVectors, p.orientedExtents);
+}
+
+KEllipsoidBoundingVolume *KBoundingVolumeBuilder::createEllipsoid(KEllipsoidBoundingVolume::Method method) const
+{
+  P(const KBoundingVolumeBuilderPrivate);
+  switch (method)
+  {
+  case KEllipsoidBoundingVolume::PcaMethod:
+    break;
+  }
+  return new KEllipsoidBoundingVolume(p.orientedCentroid, p.eigenVectors, p.orientedExtents * p.orientedExtents);
+}
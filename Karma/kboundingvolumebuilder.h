@@ -0,0 +1,40 @@
+#ifndef KBOUNDINGVOLUMEBUILDER_H
+#define KBOUNDINGVOLUMEBUILDER_H KBoundingVolumeBuilder
+
+#include <KMath>
+#include <KAabbBoundingVolume>
+#include <KSphereBoundingVolume>
+#include <KOrientedBoundingVolume>
+#include <KEllipsoidBoundingVolume>
+class KHalfEdgeMesh;
+
+// Computes what every bounding volume method needs from a mesh once, with the
+// shared reductions in KMath: bounds, centroid, covariance and extremal points
+// along the EPOS-6 and eigenvector axes. Any number of volumes can then be
+// created from the builder without touching the vertices again, except for
+// Larsson's spheres above EPOS-6 which are built from the mesh on request.
+// The OBB and ellipsoid match their mesh constructors (See Karma::orientedBounds()).
+class KBoundingVolumeBuilderPrivate;
+class KBoundingVolumeBuilder
+{
+public:
+  KBoundingVolumeBuilder(KHalfEdgeMesh const &mesh);
+  ~KBoundingVolumeBuilder();
+
+  // Shared Moments
+  Karma::MinMaxKVector3D const &bounds() const;
+  KVector3D const &centroid() const;
+  KMatrix3x3 const &covariance() const;
+  KMatrix3x3 const &eigenVectors() const;
+
+  // Volumes (The caller takes ownership)
+  KAabbBoundingVolume *createAabb(KAabbBoundingVolume::Method method) const;
+  KSphereBoundingVolume *createSphere(KSphereBoundingVolume::Method method, KSphereBoundingVolume::Accuracy accuracy = KSphereBoundingVolume::Epos6Accuracy) const;
+  KOrientedBoundingVolume *createObb(KOrientedBoundingVolume::Method method) const;
+  KEllipsoidBoundingVolume *createEllipsoid(KEllipsoidBoundingVolume::Method method) const;
+
+private:
+  KBoundingVolumeBuilderPrivate *m_private;
+};
+
+#endif // KBOUNDINGVOLUMEBUILDER_H
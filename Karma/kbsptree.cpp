@@ -10,6 +10,76 @@
 #include <KTrianglePointIterator>
 #include <OpenGLDebugDraw>
 #include <KPlane>
+#include <KParallel>
+#include <KCacheFile>
+#include <atomic>
+#include <random>
+
+// Subtrees above this many triangles are built concurrently, and partitioned
+// in parallel above the second threshold.
+static const size_t sg_parallelBuildThreshold = size_t(1) << 12;
+static const size_t sg_parallelPartitionThreshold = size_t(1) << 16;
+
+// Debug colors come from the node's position in the build, not from rand(), so
+// that concurrent builds color (and split) the same way every time.
+static KColor debugColor(size_t seed)
+{
+  std::minstd_rand random(static_cast<std::minstd_rand::result_type>(seed * 2654435761u + 1));
+  std::uniform_real_distribution<float> channel(0.0f, 1.0f);
+  float r = channel(random);
+  float g = channel(random);
+  float b = channel(random);
+  return KColor(r, g, b);
+}
+
+/*******************************************************************************
+ * Bsp Tree Cache (See KBspTree::save())
+ ******************************************************************************/
+// Layout: Header, Nodes (Pre-order), Objects (each array 16-byte aligned).
+// Every node's objects are a range of the object array, which holds the
+// triangles (1-based point indices) in the order the build partitioned them.
+// Note: Bump the version whenever the node layout changes.
+static char const sg_cacheMagic[4] = { 'K', 'B', 'S', 'P' };
+static const uint32_t sg_cacheVersion = 1;
+static const uint32_t sg_cacheNoChild = ~uint32_t(0);
+
+struct KBspTreeCacheHeader
+{
+  char magic[4];
+  uint32_t version;
+  uint32_t nodeSize;
+  uint32_t method;
+  uint64_t sourceChecksum;
+  uint32_t depth;
+  uint32_t reserved;
+  uint64_t numNodes;
+  uint64_t numObjects;
+};
+
+struct KBspTreeCacheNode
+{
+  float plane[4];
+  uint32_t color;
+  uint32_t depth;
+  uint32_t left;
+  uint32_t right;
+  uint32_t firstObject;
+  uint32_t objectCount;
+};
+
+struct KBspTreeCacheObject
+{
+  uint32_t indices[3];
+};
+
+static KBspTreeCacheHeader cacheHeader(uint64_t sourceChecksum, KGeometryCloud::BuildMethod method)
+{
+  KBspTreeCacheHeader header = KCacheFile::header<KBspTreeCacheHeader>(sg_cacheMagic, sg_cacheVersion);
+  header.nodeSize = sizeof(KBspTreeCacheNode);
+  header.method = static_cast<uint32_t>(method);
+  header.sourceChecksum = sourceChecksum;
+  return header;
+}
 
 /*******************************************************************************
  * KAdaptiveOctreeNode
@@ -19,7 +89,7 @@ class KBspTreeNode
 public:
   typedef KTriangleIndexCloud::ConstIterator ConstIterator;
 
-  KBspTreeNode(size_t depth, KPointCloud &cloud);
+  KBspTreeNode(size_t depth, size_t seed, KPointCloud &cloud);
   bool isLeaf() const;
   void debugDraw(KTransform3D &trans, size_t min, size_t max) const;
 
@@ -32,8 +102,8 @@ public:
   KPointCloud &m_pointCloud;
 };
 
-KBspTreeNode::KBspTreeNode(size_t depth, KPointCloud &cloud) :
-  m_depth(depth), m_color(float(std::rand()) / RAND_MAX, float(std::rand()) / RAND_MAX, float(std::rand()) / RAND_MAX), m_left(0), m_right(0), m_pointCloud(cloud)
+KBspTreeNode::KBspTreeNode(size_t depth, size_t seed, KPointCloud &cloud) :
+  m_depth(depth), m_color(debugColor(seed)), m_left(0), m_right(0), m_pointCloud(cloud)
 {
   // Intentionally Empty
 }
@@ -84,15 +154,21 @@ public:
   void buildTopDown(TerminationPred pred);
   KBspTreeNode* recursiveTopDown(size_t depth, TriangleIterator begin, TriangleIterator end, TerminationPred pred);
   KPlane pickSplittingPlane(TriangleIterator begin, TriangleIterator end, float skipWeight = 0.0f);
+  bool readCache(QString const &fileName, KBspTreeCacheHeader const &expected, KPointCloud const &pointCloud);
+  bool writeCache(QString const &fileName) const;
+  uint32_t flattenNode(KBspTreeNode const *node, std::vector<KBspTreeCacheNode> &nodes, std::vector<KBspTreeCacheObject> &objects) const;
+  void collectStatistics(KBspTreeNode const *node, KGeometryCloud::Statistics &stats) const;
 
   KBspTreeNode *m_root;
-  size_t m_maxDepth;
+  std::atomic<size_t> m_maxDepth;
   KGeometryCloud m_parent;
   KPointCloud m_pointCloud;
+  KGeometryCloud::BuildMethod m_method;
+  uint64_t m_sourceChecksum;
 };
 
 KBspTreePrivate::KBspTreePrivate(KGeometryCloud &parent) :
-  m_root(0), m_parent(parent)
+  m_root(0), m_maxDepth(0), m_parent(parent), m_method(KGeometryCloud::TopDownMethod), m_sourceChecksum(0)
 {
   // Intentionally Empty
 }
@@ -115,11 +191,12 @@ KBspTreeNode* KBspTreePrivate::recursiveTopDown(size_t depth, TriangleIterator b
 {
   KPointCloud const & pointCloud = m_parent.pointCloud();
   size_t numTriangles = std::distance(begin, end);
-  if (m_maxDepth < depth) m_maxDepth = depth;
+  size_t offset = std::distance(m_parent.triangleIndexCloud().begin(), begin);
+  Karma::atomicMax(m_maxDepth, depth);
 
   // Check if the predicate was met (terminating condition)
-  KBspTreeNode *node = new KBspTreeNode(depth, m_pointCloud);
-  if (pred(numTriangles, m_maxDepth))
+  KBspTreeNode *node = new KBspTreeNode(depth, (offset << 8) ^ depth, m_pointCloud);
+  if (pred(numTriangles, depth))
   {
     node->m_objects.copy(begin, end);
     return node;
@@ -137,9 +214,23 @@ KBspTreeNode* KBspTreePrivate::recursiveTopDown(size_t depth, TriangleIterator b
   node->m_plane = plane;
 
   // Create all nodes
-  TriangleIterator middle = std::partition(begin, end, KTrianglePartitionPlane(pointCloud, plane));
-  node->m_left = recursiveTopDown(depth + 1, begin, middle, pred);
-  node->m_right = recursiveTopDown(depth + 1, middle, end, pred);
+  TriangleIterator middle;
+  if (numTriangles >= sg_parallelPartitionThreshold)
+    middle = Karma::parallelPartition(begin, end, KTrianglePartitionPlane(pointCloud, plane));
+  else
+    middle = std::partition(begin, end, KTrianglePartitionPlane(pointCloud, plane));
+  if (numTriangles >= sg_parallelBuildThreshold)
+  {
+    Karma::parallelInvoke(
+      [&]() { node->m_left = recursiveTopDown(depth + 1, begin, middle, pred); },
+      [&]() { node->m_right = recursiveTopDown(depth + 1, middle, end, pred); }
+    );
+  }
+  else
+  {
+    node->m_left = recursiveTopDown(depth + 1, begin, middle, pred);
+    node->m_right = recursiveTopDown(depth + 1, middle, end, pred);
+  }
 
   // Grab remaining indices
   node->m_objects.copy(begin, end);
@@ -201,11 +292,12 @@ KPlane KBspTreePrivate::pickSplittingPlane(TriangleIterator begin, TriangleItera
   }
 
   // Edge case: No plane formed by the faces of the mesh will reduce sample size
+  std::minstd_rand random(static_cast<std::minstd_rand::result_type>(numPolygons));
   while (bestInFront == 0 || bestInBack == 0)
   {
-    KTriangleIndexCloud::ElementType const &a = *(origBegin + (std::rand() % numPolygons));
-    KTriangleIndexCloud::ElementType const &b = *(origBegin + (std::rand() % numPolygons));
-    KTriangleIndexCloud::ElementType const &c = *(origBegin + (std::rand() % numPolygons));
+    KTriangleIndexCloud::ElementType const &a = *(origBegin + (random() % numPolygons));
+    KTriangleIndexCloud::ElementType const &b = *(origBegin + (random() % numPolygons));
+    KTriangleIndexCloud::ElementType const &c = *(origBegin + (random() % numPolygons));
     bestPlane = KPlane(
       m_pointCloud[a.indices[0] - 1],
       m_pointCloud[b.indices[1] - 1],
@@ -218,6 +310,133 @@ KPlane KBspTreePrivate::pickSplittingPlane(TriangleIterator begin, TriangleItera
   return bestPlane;
 }
 
+bool KBspTreePrivate::readCache(QString const &fileName, KBspTreeCacheHeader const &expected, KPointCloud const &pointCloud)
+{
+  // Validate the header against this build and the geometry it should match
+  KCacheFileReader reader(fileName);
+  KBspTreeCacheHeader header;
+  if (!reader.readHeader(header, expected) ||
+      header.nodeSize != expected.nodeSize ||
+      header.method != expected.method ||
+      header.sourceChecksum != expected.sourceChecksum ||
+      header.numNodes == 0)
+  {
+    return false;
+  }
+
+  // Validate the payload size
+  if (header.numNodes > sg_cacheNoChild) return false;
+  KBspTreeCacheNode const *nodes = reader.readSection<KBspTreeCacheNode>(header.numNodes);
+  KBspTreeCacheObject const *objects = reader.readSection<KBspTreeCacheObject>(header.numObjects);
+  if (!nodes || !objects) return false;
+
+  // Children always follow their parent and every node but the root has
+  // exactly one parent, so the nodes form a tree. Depths come from that tree
+  // rather than from the file. Object ranges must stay within the file.
+  std::vector<uint32_t> depths(header.numNodes, sg_cacheNoChild);
+  depths[0] = 0;
+  size_t maxDepth = 0;
+  for (size_t i = 0; i < header.numNodes; ++i)
+  {
+    KBspTreeCacheNode const &node = nodes[i];
+    if (depths[i] == sg_cacheNoChild || uint64_t(node.firstObject) + node.objectCount > header.numObjects) return false;
+    for (uint32_t child : { node.left, node.right })
+    {
+      if (child == sg_cacheNoChild) continue;
+      if (child <= i || child >= header.numNodes || depths[child] != sg_cacheNoChild) return false;
+      depths[child] = depths[i] + 1;
+      maxDepth = std::max<size_t>(maxDepth, depths[child]);
+    }
+  }
+  for (size_t i = 0; i < header.numObjects; ++i)
+  {
+    for (int k = 0; k < 3; ++k)
+    {
+      if (objects[i].indices[k] == 0 || objects[i].indices[k] > pointCloud.size()) return false;
+    }
+  }
+
+  // Create every node, then link them (Children have larger indices)
+  m_pointCloud = pointCloud;
+  std::vector<KBspTreeNode*> created(header.numNodes);
+  for (size_t i = 0; i < header.numNodes; ++i)
+  {
+    KBspTreeCacheNode const &cached = nodes[i];
+    KBspTreeNode *node = new KBspTreeNode(depths[i], i, m_pointCloud);
+    node->m_color = KColor(static_cast<QRgb>(cached.color));
+    node->m_plane.set(cached.plane[0], cached.plane[1], cached.plane[2], cached.plane[3]);
+    node->m_objects.reserve(cached.objectCount);
+    for (KBspTreeCacheObject const *object = objects + cached.firstObject; object != objects + cached.firstObject + cached.objectCount; ++object)
+    {
+      node->m_objects.emplace_back(KTriangleIndexCloud::ElementType(object->indices[0], object->indices[1], object->indices[2]));
+    }
+    created[i] = node;
+  }
+  for (size_t i = 0; i < header.numNodes; ++i)
+  {
+    if (nodes[i].left != sg_cacheNoChild) created[i]->m_left = created[nodes[i].left];
+    if (nodes[i].right != sg_cacheNoChild) created[i]->m_right = created[nodes[i].right];
+  }
+  m_root = created[0];
+  m_maxDepth = maxDepth;
+  return true;
+}
+
+bool KBspTreePrivate::writeCache(QString const &fileName) const
+{
+  std::vector<KBspTreeCacheNode> nodes;
+  std::vector<KBspTreeCacheObject> objects;
+  flattenNode(m_root, nodes, objects);
+
+  KCacheFileWriter file(fileName);
+  if (!file.valid()) return false;
+
+  KBspTreeCacheHeader header = cacheHeader(m_sourceChecksum, m_method);
+  header.depth = static_cast<uint32_t>(m_maxDepth);
+  header.numNodes = nodes.size();
+  header.numObjects = objects.size();
+
+  file.writeSection(&header, sizeof(KBspTreeCacheHeader));
+  file.writeSection(nodes.data(), nodes.size() * sizeof(KBspTreeCacheNode));
+  file.writeSection(objects.data(), objects.size() * sizeof(KBspTreeCacheObject));
+  return file.commit();
+}
+
+uint32_t KBspTreePrivate::flattenNode(KBspTreeNode const *node, std::vector<KBspTreeCacheNode> &nodes, std::vector<KBspTreeCacheObject> &objects) const
+{
+  uint32_t index = static_cast<uint32_t>(nodes.size());
+  KBspTreeCacheNode cached;
+  KVector3D const &normal = node->m_plane.normal();
+  cached.plane[0] = normal.x();
+  cached.plane[1] = normal.y();
+  cached.plane[2] = normal.z();
+  cached.plane[3] = node->m_plane.dTerm();
+  cached.color = static_cast<uint32_t>(node->m_color.rgba());
+  cached.depth = static_cast<uint32_t>(node->m_depth);
+  cached.firstObject = static_cast<uint32_t>(objects.size());
+  cached.objectCount = static_cast<uint32_t>(node->m_objects.size());
+  for (KTriangleIndexCloud::ElementType const &elm : node->m_objects)
+  {
+    KBspTreeCacheObject object = { { static_cast<uint32_t>(elm.indices[0]), static_cast<uint32_t>(elm.indices[1]), static_cast<uint32_t>(elm.indices[2]) } };
+    objects.push_back(object);
+  }
+  nodes.push_back(cached);
+  uint32_t left = (node->m_left) ? flattenNode(node->m_left, nodes, objects) : sg_cacheNoChild;
+  uint32_t right = (node->m_right) ? flattenNode(node->m_right, nodes, objects) : sg_cacheNoChild;
+  nodes[index].left = left;
+  nodes[index].right = right;
+  return index;
+}
+
+void KBspTreePrivate::collectStatistics(KBspTreeNode const *node, KGeometryCloud::Statistics &stats) const
+{
+  ++stats.nodes;
+  stats.memory += sizeof(KBspTreeNode) + node->m_objects.size() * sizeof(KTriangleIndexCloud::ElementType);
+  if (node->isLeaf()) stats.addLeaf(node->m_objects.size());
+  if (node->m_left) collectStatistics(node->m_left, stats);
+  if (node->m_right) collectStatistics(node->m_right, stats);
+}
+
 /*******************************************************************************
  * KBspTree
  ******************************************************************************/
@@ -250,6 +469,8 @@ void KBspTree::build(KGeometryCloud::BuildMethod method, KGeometryCloud::Termina
 
   // If there is no new geometry to build, do nothing.
   if (!dirty()) return;
+  p.m_method = method;
+  p.m_sourceChecksum = checksum();
 
   // Build based on selected method
   switch (method)
@@ -260,6 +481,9 @@ void KBspTree::build(KGeometryCloud::BuildMethod method, KGeometryCloud::Termina
   case TopDownMethod:
     p.buildTopDown(pred);
     break;
+  case SurfaceAreaMethod:
+    qFatal("Unsupported Build Method!");
+    break;
   }
 
   // We no longer need this data
@@ -271,6 +495,44 @@ void KBspTree::build(KGeometryCloud::BuildMethod method, KGeometryCloud::Termina
   //       understand the "drawable range" of the children.
 }
 
+// Nodes only carry their splitting plane, so no SAH cost is reported.
+KGeometryCloud::Statistics KBspTree::statistics() const
+{
+  P(const KBspTreePrivate);
+  Statistics stats;
+  if (p.m_root) p.collectStatistics(p.m_root, stats);
+  stats.depth = p.m_maxDepth;
+  stats.memory += p.m_pointCloud.size() * sizeof(KVector3D);
+  return stats;
+}
+
+// Writes the built tree with every node's (partitioned) triangles, so load()
+// can skip construction.
+bool KBspTree::save(QString const &fileName) const
+{
+  P(const KBspTreePrivate);
+  if (!p.m_root) return false;
+  return p.writeCache(fileName);
+}
+
+// Use in place of build() with the same geometry added; returns false (and
+// changes nothing) unless the file was saved from identical geometry and method.
+// Note: The termination predicate cannot be verified, version the file name by it.
+bool KBspTree::load(QString const &fileName, BuildMethod method, TerminationPred pred)
+{
+  P(KBspTreePrivate);
+  (void)pred;
+  if (!dirty()) return false;
+  uint64_t sourceChecksum = checksum();
+  if (!p.readCache(fileName, cacheHeader(sourceChecksum, method), pointCloud())) return false;
+  p.m_method = method;
+  p.m_sourceChecksum = sourceChecksum;
+
+  // We no longer need this data
+  KGeometryCloud::clear();
+  return true;
+}
+
 void KBspTree::debugDraw(size_t min, size_t max)
 {
   KTransform3D trans;
@@ -0,0 +1,74 @@
+#include "kcachefile.h"
+#include <QDir>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QString>
+
+#include <KMacros>
+
+/*******************************************************************************
+ * KCacheFileReader
+ ******************************************************************************/
+
+
+KCacheFileReader::KCacheFileReader(QString const &fileName) :
+  m_reader(fileName), m_offset(0)
+{
+  // Intentionally Empty
+}
+
+/*******************************************************************************
+ * KCacheFileWriterPrivate
+ ******************************************************************************/
+class KCacheFileWriterPrivate
+{
+public:
+  inline KCacheFileWriterPrivate(QString const &fileName);
+  QSaveFile m_file;
+  size_t m_offset;
+};
+
+inline KCacheFileWriterPrivate::KCacheFileWriterPrivate(QString const &fileName) :
+  m_file(fileName), m_offset(0)
+{
+  QDir().mkpath(QFileInfo(fileName).absolutePath());
+  m_file.open(QFile::WriteOnly);
+}
+
+/*******************************************************************************
+ * KCacheFileWriter
+ ******************************************************************************/
+
+
+KCacheFileWriter::KCacheFileWriter(QString const &fileName) :
+  m_private(new KCacheFileWriterPrivate(fileName))
+{
+  // Intentionally Empty
+}
+
+KCacheFileWriter::~KCacheFileWriter()
+{
+  // Intentionally Empty
+}
+
+bool KCacheFileWriter::valid() const
+{
+  P(const KCacheFileWriterPrivate);
+  return p.m_file.isOpen();
+}
+
+void KCacheFileWriter::writeSection(void const *data, size_t bytes)
+{
+  P(KCacheFileWriterPrivate);
+  static char const padding[KCacheFile::Alignment] = { 0 };
+  size_t aligned = KCacheFile::align(p.m_offset);
+  p.m_file.write(padding, static_cast<qint64>(aligned - p.m_offset));
+  p.m_file.write(static_cast<char const*>(data), static_cast<qint64>(bytes));
+  p.m_offset = aligned + bytes;
+}
+
+bool KCacheFileWriter::commit()
+{
+  P(KCacheFileWriterPrivate);
+  return p.m_file.commit();
+}
@@ -0,0 +1,101 @@
+#ifndef KCACHEFILE_H
+#define KCACHEFILE_H KCacheFile
+
+#include <KMappedFileReader>
+#include <QScopedPointer>
+#include <cstdint>
+#include <cstring>
+class QString;
+
+/*******************************************************************************
+ * KCacheFile
+ ******************************************************************************/
+// Binary caches are a header followed by arrays of trivially copyable
+// elements, each starting on a 16-byte boundary. Every header starts with a
+// 4-byte magic and a uint32_t version, the rest of it belongs to the owner.
+class KCacheFile
+{
+public:
+  static const size_t Alignment = 16;
+  static size_t align(size_t offset);
+  template <typename Header>
+  static Header header(char const (&magic)[4], uint32_t version);
+};
+
+inline size_t KCacheFile::align(size_t offset)
+{
+  return (offset + Alignment - 1) & ~(Alignment - 1);
+}
+
+template <typename Header>
+inline Header KCacheFile::header(char const (&magic)[4], uint32_t version)
+{
+  Header header;
+  std::memset(&header, 0, sizeof(Header));
+  std::memcpy(header.magic, magic, sizeof(header.magic));
+  header.version = version;
+  return header;
+}
+
+/*******************************************************************************
+ * KCacheFileReader
+ ******************************************************************************/
+// Reads the sections of a cache in the order they were written. The returned
+// pointers refer to the mapped file, so they live as long as the reader.
+class KCacheFileReader
+{
+public:
+  KCacheFileReader(QString const &fileName);
+  template <typename Header>
+  bool readHeader(Header &header, Header const &expected);
+  template <typename T>
+  T const *readSection(uint64_t count);
+private:
+  KMappedFileReader m_reader;
+  size_t m_offset;
+};
+
+// Copies the header out of the file, false if it is missing or its magic or
+// version differ from expected (The owner checks the remaining fields).
+template <typename Header>
+inline bool KCacheFileReader::readHeader(Header &header, Header const &expected)
+{
+  Header const *cached = readSection<Header>(1);
+  if (!cached) return false;
+  std::memcpy(&header, cached, sizeof(Header));
+  return std::memcmp(header.magic, expected.magic, sizeof(header.magic)) == 0 &&
+         header.version == expected.version;
+}
+
+// Returns the next count elements, Null if they do not fit in the file.
+// (The count is bounded by the rest of the file before it is multiplied,
+// so a corrupt count cannot wrap the offset.)
+template <typename T>
+inline T const *KCacheFileReader::readSection(uint64_t count)
+{
+  size_t offset = KCacheFile::align(m_offset);
+  size_t fileSize = m_reader.size();
+  if (offset > fileSize || count > (fileSize - offset) / sizeof(T)) return Q_NULLPTR;
+  m_offset = offset + static_cast<size_t>(count) * sizeof(T);
+  return reinterpret_cast<T const*>(m_reader.data() + offset);
+}
+
+/*******************************************************************************
+ * KCacheFileWriter
+ ******************************************************************************/
+// Writes each section padded up to the next aligned offset. Nothing replaces
+// the file on disk until commit() succeeds.
+class KCacheFileWriterPrivate;
+class KCacheFileWriter
+{
+public:
+  KCacheFileWriter(QString const &fileName);
+  ~KCacheFileWriter();
+  bool valid() const;
+  void writeSection(void const *data, size_t bytes);
+  bool commit();
+private:
+  QScopedPointer<KCacheFileWriterPrivate> m_private;
+};
+
+#endif // KCACHEFILE_H
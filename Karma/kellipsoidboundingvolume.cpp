@@ -15,12 +15,12 @@ public:
   KMatrix3x3 axes;
   KVector3D extents;
 private:
-  void calculateUsingCovarianceMatrix(KHalfEdgeMesh const &mesh, int iterations);
+  void calculateUsingCovarianceMatrix(KHalfEdgeMesh const &mesh);
 };
 
 void KEllipsoidBoundingVolumePrivate::calculatePcaMethod(const KHalfEdgeMesh &mesh)
 {
-  calculateUsingCovarianceMatrix(mesh, 50);
+  calculateUsingCovarianceMatrix(mesh);
   /*
   for (KHalfEdgeMesh::Vertex const &v : mesh.vertices())
   {
@@ -45,7 +45,7 @@ void KEllipsoidBoundingVolumePrivate::calculatePcaMethod(const KHalfEdgeMesh &me
   */
 }
 
-void KEllipsoidBoundingVolumePrivate::calculateUsingCovarianceMatrix(const KHalfEdgeMesh &mesh, int iterations)
+void KEllipsoidBoundingVolumePrivate::calculateUsingCovarianceMatrix(const KHalfEdgeMesh &mesh)
 {
   KHalfEdgeMesh::VertexContainer const &vertices = mesh.vertices();
 
@@ -56,12 +56,12 @@ void KEllipsoidBoundingVolumePrivate::calculateUsingCovarianceMatrix(const KHalf
       vertices.end(),
       KHalfEdgeMesh::VertexPositionPred()
     );
-  axes = Karma::jacobi(covariance, iterations);
+  axes = Karma::symmetricEigen(covariance);
 
-  // Find the extremal projected points along each axis
+  // Find the extremal points along each axis
   std::vector<KVector3D> extractedAxes = Karma::decomposeMatrixeByColumnVectors(axes);
   std::vector<Karma::MinMaxKVector3D> extremal =
-    Karma::findExtremalProjectedPointsAlongAxes(
+    Karma::findExtremalPointsAlongAxes(
       vertices.begin(),
       vertices.end(),
       extractedAxes.begin(),
@@ -69,22 +69,10 @@ void KEllipsoidBoundingVolumePrivate::calculateUsingCovarianceMatrix(const KHalf
       KHalfEdgeMesh::VertexPositionPred()
     );
 
-  // Store information for the centroid and extent
-  KVector3D axisA = extremal[0].max - extremal[0].min;
-  KVector3D axisB = extremal[1].max - extremal[1].min;
-  KVector3D axisC = extremal[2].max - extremal[2].min;
-  extents.setX(axisA.length());
-  extents.setY(axisB.length());
-  extents.setZ(axisC.length());
-  axisA /= extents.x();
-  axisB /= extents.y();
-  axisC /= extents.z();
-  extents /= 2.0f;
+  // Store information for the centroid and extent (Same as KBoundingVolumeBuilder)
+  // Note: The axes stay the eigenvectors, extents are the squared half widths.
+  Karma::orientedBounds(axes, extremal, &centroid, &extents);
   extents *= extents;
-  centroid  = (extremal[0].max + extremal[0].min) / 2.0f;
-  centroid += (extremal[1].max + extremal[1].min) / 2.0f;
-  centroid += (extremal[2].max + extremal[2].min) / 2.0f;
-  Karma::reconstructMatrixByColumnVectors(&axes, axisA, axisB, axisC);
 }
 
 KEllipsoidBoundingVolume::KEllipsoidBoundingVolume() :
@@ -105,6 +93,15 @@ KEllipsoidBoundingVolume::KEllipsoidBoundingVolume(KHalfEdgeMesh const &mesh, Me
   }
 }
 
+KEllipsoidBoundingVolume::KEllipsoidBoundingVolume(KVector3D const &centroid, KMatrix3x3 const &axes, KVector3D const &extents) :
+  m_private(new KEllipsoidBoundingVolumePrivate)
+{
+  P(KEllipsoidBoundingVolumePrivate);
+  p.centroid = centroid;
+  p.axes = axes;
+  p.extents = extents;
+}
+
 KEllipsoidBoundingVolume::~KEllipsoidBoundingVolume()
 {
   delete m_private;
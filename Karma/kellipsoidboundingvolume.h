@@ -2,7 +2,9 @@
 #define KELLIPSOIDBOUNDINGVOLUME_H KEllipsoidBoundingVolume
 
 #include <KAbstractBoundingVolume>
+#include <KVector3D>
 class KHalfEdgeMesh;
+class KMatrix3x3;
 
 class KEllipsoidBoundingVolumePrivate;
 class KEllipsoidBoundingVolume : public KAbstractBoundingVolume
@@ -15,6 +17,7 @@ public:
 
   KEllipsoidBoundingVolume();
   KEllipsoidBoundingVolume(KHalfEdgeMesh const &mesh, Method method);
+  KEllipsoidBoundingVolume(KVector3D const &centroid, KMatrix3x3 const &axes, KVector3D const &extents);
   ~KEllipsoidBoundingVolume();
   void draw(KTransform3D &t, KColor const &color) const;
 private:
@@ -1,50 +1,189 @@
 #include "kepossphere.h"
+#include <algorithm>
+#include <cmath>
 
-struct Sphere
-{
-  Sphere(Sphere const &a, Sphere const &b);
-  Sphere(KVector3D const &a, KVector3D const &b);
-  float radius;
-  KVector3D origin;
-};
+constexpr KVector3D KEposSphere::Axes[KEposSphere::MaxAxisCount];
+
+// Points on the boundary may fall outside by rounding; allow a relative slack
+static const double sg_containmentSlack = 1e-6;
 
-Sphere::Sphere(const Sphere &a, const Sphere &b)
+/*******************************************************************************
+ * Minimum Enclosing Sphere
+ ******************************************************************************/
+// Welzl's algorithm with the move-to-front heuristic, computed in double
+// precision. The extremal point sets are small (At most 98 points), so the
+// recursion depth is bounded by the four support points.
+namespace
 {
-  // Distance to A
-  KVector3D aNormal = (a.origin - b.origin);
-  float dist = aNormal.length();
-  aNormal /= dist;
-
-  // Find two extrenal points
-  KVector3D pointA = a.origin + aNormal * a.radius;
-  KVector3D pointB = b.origin - aNormal * b.radius;
-
-  // Solve for sphere
-  origin = (pointA + pointB) / 2.0f;
-  radius = (pointA - pointB).length() / 2.0f;
+  struct Point
+  {
+    double x, y, z;
+    bool operator<(Point const &rhs) const
+    {
+      if (x != rhs.x) return x < rhs.x;
+      if (y != rhs.y) return y < rhs.y;
+      return z < rhs.z;
+    }
+    bool operator==(Point const &rhs) const
+    {
+      return x == rhs.x && y == rhs.y && z == rhs.z;
+    }
+  };
+
+  inline Point operator+(Point const &a, Point const &b) { Point r = { a.x + b.x, a.y + b.y, a.z + b.z }; return r; }
+  inline Point operator-(Point const &a, Point const &b) { Point r = { a.x - b.x, a.y - b.y, a.z - b.z }; return r; }
+  inline Point operator*(Point const &a, double k) { Point r = { a.x * k, a.y * k, a.z * k }; return r; }
+  inline double dot(Point const &a, Point const &b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+  inline Point cross(Point const &a, Point const &b)
+  {
+    Point r = { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+    return r;
+  }
+
+  struct Sphere
+  {
+    Point origin;
+    double radius2;
+    bool contains(Point const &p) const;
+  };
+
+  inline bool Sphere::contains(const Point &p) const
+  {
+    Point d = p - origin;
+    return dot(d, d) <= radius2 * (1.0 + sg_containmentSlack);
+  }
+
+  Sphere sphereFromTwo(Point const &a, Point const &b)
+  {
+    Sphere s;
+    s.origin = (a + b) * 0.5;
+    Point d = a - s.origin;
+    s.radius2 = dot(d, d);
+    return s;
+  }
+
+  // Circumcircle; collinear points fall back to the most distant pair.
+  Sphere sphereFromThree(Point const &a, Point const &b, Point const &c)
+  {
+    Point ab = b - a, ac = c - a;
+    Point normal = cross(ab, ac);
+    double denominator = 2.0 * dot(normal, normal);
+    if (denominator <= 1e-12 * dot(ab, ab) * dot(ac, ac))
+    {
+      Sphere s = sphereFromTwo(a, b);
+      Sphere t = sphereFromTwo(a, c);
+      Sphere u = sphereFromTwo(b, c);
+      if (t.radius2 > s.radius2) s = t;
+      if (u.radius2 > s.radius2) s = u;
+      return s;
+    }
+    Point offset = (cross(normal, ab) * dot(ac, ac) + cross(ac, normal) * dot(ab, ab)) * (1.0 / denominator);
+    Sphere s;
+    s.origin = a + offset;
+    s.radius2 = dot(offset, offset);
+    return s;
+  }
+
+  // Circumsphere; coplanar points fall back to the largest circumcircle.
+  Sphere sphereFromFour(Point const &a, Point const &b, Point const &c, Point const &d)
+  {
+    Point ab = b - a, ac = c - a, ad = d - a;
+    double denominator = 2.0 * dot(ab, cross(ac, ad));
+    double scale = std::sqrt(dot(ab, ab) * dot(ac, ac) * dot(ad, ad));
+    if (std::abs(denominator) <= 1e-12 * scale)
+    {
+      Sphere s = sphereFromThree(a, b, c);
+      Sphere t = sphereFromThree(a, b, d);
+      Sphere u = sphereFromThree(a, c, d);
+      Sphere v = sphereFromThree(b, c, d);
+      if (t.radius2 > s.radius2) s = t;
+      if (u.radius2 > s.radius2) s = u;
+      if (v.radius2 > s.radius2) s = v;
+      return s;
+    }
+    Point offset = (cross(ac, ad) * dot(ab, ab) + cross(ad, ab) * dot(ac, ac) + cross(ab, ac) * dot(ad, ad)) * (1.0 / denominator);
+    Sphere s;
+    s.origin = a + offset;
+    s.radius2 = dot(offset, offset);
+    return s;
+  }
+
+  Sphere sphereFromSupport(Point const support[4], int count)
+  {
+    switch (count)
+    {
+    case 1:
+      {
+        Sphere s = { support[0], 0.0 };
+        return s;
+      }
+    case 2:
+      return sphereFromTwo(support[0], support[1]);
+    case 3:
+      return sphereFromThree(support[0], support[1], support[2]);
+    case 4:
+      return sphereFromFour(support[0], support[1], support[2], support[3]);
+    }
+    Sphere s = { { 0.0, 0.0, 0.0 }, -1.0 };
+    return s;
+  }
+
+  // Smallest sphere around points[0, end) with support[0, count) on its boundary.
+  Sphere welzlSphere(std::vector<Point> &points, size_t end, Point support[4], int count)
+  {
+    Sphere s = sphereFromSupport(support, count);
+    if (count == 4) return s;
+    for (size_t i = 0; i < end; ++i)
+    {
+      if (s.radius2 >= 0.0 && s.contains(points[i])) continue;
+      support[count] = points[i];
+      s = welzlSphere(points, i, support, count + 1);
+
+      // Points which grew the sphere are likely to be needed again
+      std::rotate(points.begin(), points.begin() + i, points.begin() + i + 1);
+    }
+    return s;
+  }
 }
 
-Sphere::Sphere(const KVector3D &a, const KVector3D &b)
+/*******************************************************************************
+ * KEposSphere
+ ******************************************************************************/
+KEposSphere::KEposSphere(KMinMaxVectorCloud const &extremalVerts)
 {
-  origin = (a + b) / 2.0f;
-  radius = (a - b).length() / 2.0f;
+  calculateMinimumSphere(extremalVerts.begin(), extremalVerts.end());
 }
 
-Sphere WelzlSphere(KMinMaxVectorCloud::const_iterator begin, KMinMaxVectorCloud::const_iterator end)
+void KEposSphere::calculateMinimumSphere(const_iterator begin, const_iterator end)
 {
-  size_t numPoints = std::distance(begin, end);
-  if (numPoints == 1)
+  // Opposite extremes often share a vertex across axes
+  std::vector<Point> points;
+  for (const_iterator it = begin; it != end; ++it)
   {
-    return Sphere(begin[0].max, begin[0].min);
+    Point min = { it->min.x(), it->min.y(), it->min.z() };
+    Point max = { it->max.x(), it->max.y(), it->max.z() };
+    points.push_back(min);
+    points.push_back(max);
   }
+  std::sort(points.begin(), points.end());
+  points.erase(std::unique(points.begin(), points.end()), points.end());
 
-  KMinMaxVectorCloud::const_iterator halfWay = begin + numPoints / 2;
-  return Sphere(WelzlSphere(begin, halfWay), WelzlSphere(halfWay, end));
-}
+  if (points.empty())
+  {
+    centroid = KVector3D(0.0f, 0.0f, 0.0f);
+    radius = 0.0f;
+    return;
+  }
 
-void KEposSphere::calculateMinimumSphere(const_iterator begin, const_iterator end)
-{
-  Sphere s = WelzlSphere(begin, end);
-  centroid = s.origin;
-  radius = s.radius;
+  Point support[4];
+  Sphere s = welzlSphere(points, points.size(), support, 0);
+  centroid = KVector3D(float(s.origin.x), float(s.origin.y), float(s.origin.z));
+  radius = float(std::sqrt(std::max(s.radius2, 0.0)));
+
+  // Cover the rounding of the centroid to single precision
+  for (Point const &p : points)
+  {
+    float distance = (KVector3D(float(p.x), float(p.y), float(p.z)) - centroid).length();
+    radius = std::max(radius, distance);
+  }
 }
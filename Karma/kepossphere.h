@@ -10,12 +10,64 @@ public:
 
   typedef KMinMaxVectorCloud::const_iterator const_iterator;
 
+  // EPOS-k Variants (k extremal points along k/2 fixed normals)
+  enum Variant
+  {
+    Epos6,
+    Epos14,
+    Epos26,
+    Epos98
+  };
+
+  // Normals for every variant, nested so that the first axisCount(variant)
+  // entries belong to that variant. They are not normalized; only the points
+  // at the extremes are used, which does not depend on the axis length.
+  static constexpr size_t MaxAxisCount = 49;
+  static constexpr KVector3D Axes[MaxAxisCount] =
+  {
+    // EPOS-6
+    KVector3D( 1,  0,  0), KVector3D( 0,  1,  0), KVector3D( 0,  0,  1),
+    // EPOS-14
+    KVector3D( 1,  1,  1), KVector3D( 1,  1, -1), KVector3D( 1, -1,  1), KVector3D( 1, -1, -1),
+    // EPOS-26
+    KVector3D( 1,  1,  0), KVector3D( 1, -1,  0), KVector3D( 1,  0,  1), KVector3D( 1,  0, -1),
+    KVector3D( 0,  1,  1), KVector3D( 0,  1, -1),
+    // EPOS-98
+    KVector3D( 0,  1,  2), KVector3D( 0,  2,  1), KVector3D( 1,  0,  2), KVector3D( 2,  0,  1),
+    KVector3D( 1,  2,  0), KVector3D( 2,  1,  0), KVector3D( 0,  1, -2), KVector3D( 0,  2, -1),
+    KVector3D( 1,  0, -2), KVector3D( 2,  0, -1), KVector3D( 1, -2,  0), KVector3D( 2, -1,  0),
+    KVector3D( 1,  1,  2), KVector3D( 2,  1,  1), KVector3D( 1,  2,  1), KVector3D( 1, -1,  2),
+    KVector3D( 1,  1, -2), KVector3D( 1, -1, -2), KVector3D( 2, -1,  1), KVector3D( 2,  1, -1),
+    KVector3D( 2, -1, -1), KVector3D( 1, -2,  1), KVector3D( 1,  2, -1), KVector3D( 1, -2, -1),
+    KVector3D( 2,  2,  1), KVector3D( 1,  2,  2), KVector3D( 2,  1,  2), KVector3D( 2, -2,  1),
+    KVector3D( 2,  2, -1), KVector3D( 2, -2, -1), KVector3D( 1, -2,  2), KVector3D( 1,  2, -2),
+    KVector3D( 1, -2, -2), KVector3D( 2, -1,  2), KVector3D( 2,  1, -2), KVector3D( 2, -1, -2)
+  };
+  static constexpr size_t axisCount(Variant variant)
+  {
+    return (variant == Epos6) ? 3 : (variant == Epos14) ? 7 : (variant == Epos26) ? 13 : 49;
+  }
+
   template <typename It1, typename It2, typename VecAccessor = Karma::DefaultAccessor<KVector3D>, typename AxisAccessor = Karma::DefaultAccessor<KVector3D>>
   KEposSphere(It1 bVec, It1 eVec, It2 bAxis, It2 eAxis, VecAccessor vAccessor = Karma::DefaultAccessor<KVector3D>(), AxisAccessor aAccessor = Karma::DefaultAccessor<KVector3D>());
+  template <typename It, typename VecAccessor = Karma::DefaultAccessor<KVector3D>>
+  KEposSphere(It bVec, It eVec, Variant variant, VecAccessor vAccessor = Karma::DefaultAccessor<KVector3D>());
+  KEposSphere(KMinMaxVectorCloud const &extremalVerts);
   void calculateMinimumSphere(const_iterator begin, const_iterator end);
 
+  // Extremal points along the normals of a variant. Random-access ranges are
+  // projected onto four normals at a time (And across threads when large).
+  template <typename It, typename VecAccessor = Karma::DefaultAccessor<KVector3D>>
+  static KMinMaxVectorCloud findExtremalPoints(It bVec, It eVec, Variant variant, VecAccessor vAccessor = Karma::DefaultAccessor<KVector3D>());
+
   float radius;
   KVector3D centroid;
+
+private:
+  template <typename It, typename VecAccessor>
+  static KMinMaxVectorCloud findExtremalPoints(It bVec, It eVec, Variant variant, VecAccessor vAccessor, std::input_iterator_tag);
+  template <typename It, typename VecAccessor>
+  static KMinMaxVectorCloud findExtremalPoints(It bVec, It eVec, Variant variant, VecAccessor vAccessor, std::random_access_iterator_tag);
 };
 
 template <typename It1, typename It2, typename VecAccessor, typename AxisAccessor>
@@ -25,4 +77,35 @@ KEposSphere::KEposSphere(It1 bVec, It1 eVec, It2 bAxis, It2 eAxis, VecAccessor v
   calculateMinimumSphere(extremalVerts.begin(), extremalVerts.end());
 }
 
+template <typename It, typename VecAccessor>
+KEposSphere::KEposSphere(It bVec, It eVec, Variant variant, VecAccessor vAccessor)
+{
+  KMinMaxVectorCloud extremalVerts = findExtremalPoints(bVec, eVec, variant, vAccessor);
+  calculateMinimumSphere(extremalVerts.begin(), extremalVerts.end());
+}
+
+template <typename It, typename VecAccessor>
+KMinMaxVectorCloud KEposSphere::findExtremalPoints(It bVec, It eVec, Variant variant, VecAccessor vAccessor)
+{
+  return findExtremalPoints(bVec, eVec, variant, vAccessor, Karma::reductionCategory(bVec, 0));
+}
+
+template <typename It, typename VecAccessor>
+KMinMaxVectorCloud KEposSphere::findExtremalPoints(It bVec, It eVec, Variant variant, VecAccessor vAccessor, std::input_iterator_tag)
+{
+  std::vector<KVector3D> axes(Axes, Axes + axisCount(variant));
+  return Karma::findExtremalPointsAlongAxes(bVec, eVec, axes.begin(), axes.end(), vAccessor);
+}
+
+template <typename It, typename VecAccessor>
+KMinMaxVectorCloud KEposSphere::findExtremalPoints(It bVec, It eVec, Variant variant, VecAccessor vAccessor, std::random_access_iterator_tag)
+{
+  if (bVec == eVec)
+  {
+    return KMinMaxVectorCloud(axisCount(variant), Karma::MinMaxKVector3D(0.0f, 0.0f));
+  }
+  std::vector<KVector3D> axes(Axes, Axes + axisCount(variant));
+  return Karma::parallelExtremalAlongAxes(bVec, eVec, axes, vAccessor, Karma::DefaultMutator<KVector3D>());
+}
+
 #endif // KEPOSSPHERE_H
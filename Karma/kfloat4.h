@@ -0,0 +1,146 @@
+#ifndef KFLOAT4_H
+#define KFLOAT4_H KFloat4
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#  define KFLOAT4_SSE
+#  include <xmmintrin.h>
+#endif
+
+// Four floats operated on together; SSE where available and plain arrays
+// otherwise. Comparisons return lane masks (All bits set where true) which
+// can be combined with & | and read back through mask().
+class KFloat4
+{
+public:
+  KFloat4();
+  explicit KFloat4(float k);
+  KFloat4(float a, float b, float c, float d);
+  static KFloat4 load(float const *values);
+  void store(float *values) const;
+
+  // Lane masks
+  int mask() const;
+  bool any() const;
+  static KFloat4 select(KFloat4 const &mask, KFloat4 const &a, KFloat4 const &b);
+
+  // Component-wise operations
+  friend KFloat4 operator+(KFloat4 const &a, KFloat4 const &b);
+  friend KFloat4 operator-(KFloat4 const &a, KFloat4 const &b);
+  friend KFloat4 operator*(KFloat4 const &a, KFloat4 const &b);
+  friend KFloat4 operator/(KFloat4 const &a, KFloat4 const &b);
+  friend KFloat4 operator&(KFloat4 const &a, KFloat4 const &b);
+  friend KFloat4 operator|(KFloat4 const &a, KFloat4 const &b);
+  friend KFloat4 operator<(KFloat4 const &a, KFloat4 const &b);
+  friend KFloat4 operator<=(KFloat4 const &a, KFloat4 const &b);
+  friend KFloat4 operator>(KFloat4 const &a, KFloat4 const &b);
+  friend KFloat4 operator>=(KFloat4 const &a, KFloat4 const &b);
+  friend KFloat4 min(KFloat4 const &a, KFloat4 const &b);
+  friend KFloat4 max(KFloat4 const &a, KFloat4 const &b);
+
+private:
+#ifdef KFLOAT4_SSE
+  explicit KFloat4(__m128 data);
+  __m128 m_data;
+#else
+  static KFloat4 fromMask(bool a, bool b, bool c, bool d);
+  static uint32_t bits(float f);
+  static float fromBits(uint32_t u);
+  float m_data[4];
+#endif
+};
+
+#ifdef KFLOAT4_SSE
+
+inline KFloat4::KFloat4() : m_data(_mm_setzero_ps()) {}
+inline KFloat4::KFloat4(__m128 data) : m_data(data) {}
+inline KFloat4::KFloat4(float k) : m_data(_mm_set1_ps(k)) {}
+inline KFloat4::KFloat4(float a, float b, float c, float d) : m_data(_mm_setr_ps(a, b, c, d)) {}
+inline KFloat4 KFloat4::load(float const *values) { return KFloat4(_mm_loadu_ps(values)); }
+inline void KFloat4::store(float *values) const { _mm_storeu_ps(values, m_data); }
+inline int KFloat4::mask() const { return _mm_movemask_ps(m_data); }
+inline bool KFloat4::any() const { return mask() != 0; }
+inline KFloat4 KFloat4::select(KFloat4 const &mask, KFloat4 const &a, KFloat4 const &b)
+{
+  return KFloat4(_mm_or_ps(_mm_and_ps(mask.m_data, a.m_data), _mm_andnot_ps(mask.m_data, b.m_data)));
+}
+inline KFloat4 operator+(KFloat4 const &a, KFloat4 const &b) { return KFloat4(_mm_add_ps(a.m_data, b.m_data)); }
+inline KFloat4 operator-(KFloat4 const &a, KFloat4 const &b) { return KFloat4(_mm_sub_ps(a.m_data, b.m_data)); }
+inline KFloat4 operator*(KFloat4 const &a, KFloat4 const &b) { return KFloat4(_mm_mul_ps(a.m_data, b.m_data)); }
+inline KFloat4 operator/(KFloat4 const &a, KFloat4 const &b) { return KFloat4(_mm_div_ps(a.m_data, b.m_data)); }
+inline KFloat4 operator&(KFloat4 const &a, KFloat4 const &b) { return KFloat4(_mm_and_ps(a.m_data, b.m_data)); }
+inline KFloat4 operator|(KFloat4 const &a, KFloat4 const &b) { return KFloat4(_mm_or_ps(a.m_data, b.m_data)); }
+inline KFloat4 operator<(KFloat4 const &a, KFloat4 const &b) { return KFloat4(_mm_cmplt_ps(a.m_data, b.m_data)); }
+inline KFloat4 operator<=(KFloat4 const &a, KFloat4 const &b) { return KFloat4(_mm_cmple_ps(a.m_data, b.m_data)); }
+inline KFloat4 operator>(KFloat4 const &a, KFloat4 const &b) { return KFloat4(_mm_cmpgt_ps(a.m_data, b.m_data)); }
+inline KFloat4 operator>=(KFloat4 const &a, KFloat4 const &b) { return KFloat4(_mm_cmpge_ps(a.m_data, b.m_data)); }
+inline KFloat4 min(KFloat4 const &a, KFloat4 const &b) { return KFloat4(_mm_min_ps(a.m_data, b.m_data)); }
+inline KFloat4 max(KFloat4 const &a, KFloat4 const &b) { return KFloat4(_mm_max_ps(a.m_data, b.m_data)); }
+
+#else
+
+inline KFloat4::KFloat4() { m_data[0] = m_data[1] = m_data[2] = m_data[3] = 0.0f; }
+inline KFloat4::KFloat4(float k) { m_data[0] = m_data[1] = m_data[2] = m_data[3] = k; }
+inline KFloat4::KFloat4(float a, float b, float c, float d) { m_data[0] = a; m_data[1] = b; m_data[2] = c; m_data[3] = d; }
+inline KFloat4 KFloat4::load(float const *values) { return KFloat4(values[0], values[1], values[2], values[3]); }
+inline void KFloat4::store(float *values) const { std::memcpy(values, m_data, sizeof(m_data)); }
+inline uint32_t KFloat4::bits(float f) { uint32_t u; std::memcpy(&u, &f, sizeof(u)); return u; }
+inline float KFloat4::fromBits(uint32_t u) { float f; std::memcpy(&f, &u, sizeof(f)); return f; }
+inline KFloat4 KFloat4::fromMask(bool a, bool b, bool c, bool d)
+{
+  return KFloat4(fromBits(a ? ~0u : 0u), fromBits(b ? ~0u : 0u), fromBits(c ? ~0u : 0u), fromBits(d ? ~0u : 0u));
+}
+inline int KFloat4::mask() const
+{
+  return int(bits(m_data[0]) >> 31) | int(bits(m_data[1]) >> 31) << 1 | int(bits(m_data[2]) >> 31) << 2 | int(bits(m_data[3]) >> 31) << 3;
+}
+inline bool KFloat4::any() const { return mask() != 0; }
+inline KFloat4 KFloat4::select(KFloat4 const &mask, KFloat4 const &a, KFloat4 const &b)
+{
+  int m = mask.mask();
+  return KFloat4((m & 1) ? a.m_data[0] : b.m_data[0], (m & 2) ? a.m_data[1] : b.m_data[1], (m & 4) ? a.m_data[2] : b.m_data[2], (m & 8) ? a.m_data[3] : b.m_data[3]);
+}
+
+#define KFLOAT4_ARITHMETIC(op) \
+  inline KFloat4 operator op(KFloat4 const &a, KFloat4 const &b) \
+  { return KFloat4(a.m_data[0] op b.m_data[0], a.m_data[1] op b.m_data[1], a.m_data[2] op b.m_data[2], a.m_data[3] op b.m_data[3]); }
+#define KFLOAT4_BITWISE(op) \
+  inline KFloat4 operator op(KFloat4 const &a, KFloat4 const &b) \
+  { \
+    return KFloat4(KFloat4::fromBits(KFloat4::bits(a.m_data[0]) op KFloat4::bits(b.m_data[0])), KFloat4::fromBits(KFloat4::bits(a.m_data[1]) op KFloat4::bits(b.m_data[1])), \
+                   KFloat4::fromBits(KFloat4::bits(a.m_data[2]) op KFloat4::bits(b.m_data[2])), KFloat4::fromBits(KFloat4::bits(a.m_data[3]) op KFloat4::bits(b.m_data[3]))); \
+  }
+#define KFLOAT4_COMPARE(op) \
+  inline KFloat4 operator op(KFloat4 const &a, KFloat4 const &b) \
+  { return KFloat4::fromMask(a.m_data[0] op b.m_data[0], a.m_data[1] op b.m_data[1], a.m_data[2] op b.m_data[2], a.m_data[3] op b.m_data[3]); }
+KFLOAT4_ARITHMETIC(+)
+KFLOAT4_ARITHMETIC(-)
+KFLOAT4_ARITHMETIC(*)
+KFLOAT4_ARITHMETIC(/)
+KFLOAT4_BITWISE(&)
+KFLOAT4_BITWISE(|)
+KFLOAT4_COMPARE(<)
+KFLOAT4_COMPARE(<=)
+KFLOAT4_COMPARE(>)
+KFLOAT4_COMPARE(>=)
+#undef KFLOAT4_ARITHMETIC
+#undef KFLOAT4_BITWISE
+#undef KFLOAT4_COMPARE
+
+// Matches minps/maxps: the second operand is returned when either is NaN
+inline KFloat4 min(KFloat4 const &a, KFloat4 const &b)
+{
+  return KFloat4(a.m_data[0] < b.m_data[0] ? a.m_data[0] : b.m_data[0], a.m_data[1] < b.m_data[1] ? a.m_data[1] : b.m_data[1],
+                 a.m_data[2] < b.m_data[2] ? a.m_data[2] : b.m_data[2], a.m_data[3] < b.m_data[3] ? a.m_data[3] : b.m_data[3]);
+}
+inline KFloat4 max(KFloat4 const &a, KFloat4 const &b)
+{
+  return KFloat4(a.m_data[0] > b.m_data[0] ? a.m_data[0] : b.m_data[0], a.m_data[1] > b.m_data[1] ? a.m_data[1] : b.m_data[1],
+                 a.m_data[2] > b.m_data[2] ? a.m_data[2] : b.m_data[2], a.m_data[3] > b.m_data[3] ? a.m_data[3] : b.m_data[3]);
+}
+
+#endif // KFLOAT4_SSE
+
+#endif // KFLOAT4_H
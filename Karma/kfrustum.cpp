@@ -1,7 +1,15 @@
 #include "kfrustum.h"
 
+#include <cstring>
 #include <KVector4D>
 #include <KMatrix4x4>
+#include <KFloat4>
+
+#if defined(__AVX__)
+#  include <immintrin.h>
+#endif
+
+const int KFrustum::AllPlanes;
 
 KFrustum::KFrustum()
 {
@@ -83,3 +91,120 @@ bool KFrustum::intersects(const KAabbBoundingVolume &aabb) const
   }
   return true;
 }
+
+bool KFrustum::intersects(const KVector3D &center, float radius) const
+{
+  for (int i = 0; i < 6; ++i)
+  {
+    if (m_planes[i].dot(center) < -radius)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Tests the box against the planes whose bit is set in planeMask, starting
+// at firstPlane. Planes which contain the whole box are cleared from the mask
+// so children need not test them again; a box outside the frustum returns
+// false with firstPlane set to the rejecting plane, which is worth testing
+// first for the same box next frame.
+bool KFrustum::intersects(KVector3D const &min, KVector3D const &max, int &planeMask, int &firstPlane) const
+{
+  for (int n = 0; n < 6; ++n)
+  {
+    int i = (firstPlane + n) % 6;
+    int bit = 1 << i;
+    if (!(planeMask & bit)) continue;
+
+    // Corners furthest along and against the plane normal
+    KVector3D const &normal = m_planes[i].normal();
+    KVector3D positive(
+      (normal.x() >= 0.0f) ? max.x() : min.x(),
+      (normal.y() >= 0.0f) ? max.y() : min.y(),
+      (normal.z() >= 0.0f) ? max.z() : min.z()
+    );
+    if (m_planes[i].pointInBack(positive))
+    {
+      firstPlane = i;
+      return false;
+    }
+    KVector3D negative(
+      (normal.x() >= 0.0f) ? min.x() : max.x(),
+      (normal.y() >= 0.0f) ? min.y() : max.y(),
+      (normal.z() >= 0.0f) ? min.z() : max.z()
+    );
+    if (!m_planes[i].pointInBack(negative))
+    {
+      planeMask &= ~bit;
+    }
+  }
+  return true;
+}
+
+// The corner furthest along each plane normal depends only on the plane, so
+// the coordinate arrays it reads from are picked once per plane. A box is
+// outside when that corner is behind any plane, as in the tests above. The
+// plane is evaluated in the order of KPlane::dot() so rounding matches.
+void KFrustum::intersects(float const *minX, float const *minY, float const *minZ,
+                          float const *maxX, float const *maxY, float const *maxZ,
+                          size_t count, uint32_t *visible) const
+{
+  float const *positive[6][3];
+  for (int p = 0; p < 6; ++p)
+  {
+    KVector3D const &normal = m_planes[p].normal();
+    positive[p][0] = (normal.x() >= 0.0f) ? maxX : minX;
+    positive[p][1] = (normal.y() >= 0.0f) ? maxY : minY;
+    positive[p][2] = (normal.z() >= 0.0f) ? maxZ : minZ;
+  }
+  std::memset(visible, 0, maskWords(count) * sizeof(uint32_t));
+
+  size_t i = 0;
+#if defined(__AVX__)
+  for (; i + 8 <= count; i += 8)
+  {
+    __m256 outside = _mm256_setzero_ps();
+    for (int p = 0; p < 6; ++p)
+    {
+      KVector3D const &normal = m_planes[p].normal();
+      __m256 d = _mm256_mul_ps(_mm256_set1_ps(normal.x()), _mm256_loadu_ps(positive[p][0] + i));
+      d = _mm256_add_ps(d, _mm256_mul_ps(_mm256_set1_ps(normal.y()), _mm256_loadu_ps(positive[p][1] + i)));
+      d = _mm256_add_ps(d, _mm256_mul_ps(_mm256_set1_ps(normal.z()), _mm256_loadu_ps(positive[p][2] + i)));
+      d = _mm256_add_ps(d, _mm256_set1_ps(m_planes[p].dTerm()));
+      outside = _mm256_or_ps(outside, _mm256_cmp_ps(d, _mm256_setzero_ps(), _CMP_LT_OQ));
+    }
+    uint32_t bits = ~uint32_t(_mm256_movemask_ps(outside)) & 0xFFu;
+    visible[i / 32] |= bits << (i % 32);
+  }
+#endif
+  for (; i + 4 <= count; i += 4)
+  {
+    KFloat4 outside;
+    for (int p = 0; p < 6; ++p)
+    {
+      KVector3D const &normal = m_planes[p].normal();
+      KFloat4 d = KFloat4(normal.x()) * KFloat4::load(positive[p][0] + i);
+      d = d + KFloat4(normal.y()) * KFloat4::load(positive[p][1] + i);
+      d = d + KFloat4(normal.z()) * KFloat4::load(positive[p][2] + i);
+      d = d + KFloat4(m_planes[p].dTerm());
+      outside = outside | (d < KFloat4(0.0f));
+    }
+    uint32_t bits = ~uint32_t(outside.mask()) & 0xFu;
+    visible[i / 32] |= bits << (i % 32);
+  }
+  for (; i < count; ++i)
+  {
+    bool inside = true;
+    for (int p = 0; p < 6 && inside; ++p)
+    {
+      KVector3D const &normal = m_planes[p].normal();
+      float d = normal.x() * positive[p][0][i];
+      d += normal.y() * positive[p][1][i];
+      d += normal.z() * positive[p][2][i];
+      d += m_planes[p].dTerm();
+      inside = !(d < 0.0f);
+    }
+    if (inside) visible[i / 32] |= uint32_t(1) << (i % 32);
+  }
+}
@@ -1,6 +1,8 @@
 #ifndef KFRUSTUM_H
 #define KFRUSTUM_H KFrustum
 
+#include <cstddef>
+#include <cstdint>
 class KMatrix4x4;
 #include <KPlane>
 #include <KAabbBoundingVolume>
@@ -13,9 +15,26 @@ public:
   void setFrustum(KMatrix4x4 const &viewProj);
 
   bool intersects(KAabbBoundingVolume const &aabb) const;
+  bool intersects(KVector3D const &center, float radius) const;
+
+  // Hierarchical culling
+  static const int AllPlanes = 0x3F;
+  bool intersects(KVector3D const &min, KVector3D const &max, int &planeMask, int &firstPlane) const;
+
+  // Batch culling (Boxes as separate coordinate arrays); bit (i % 32) of
+  // visible[i / 32] is set when box i intersects, unused bits are cleared.
+  static size_t maskWords(size_t count);
+  void intersects(float const *minX, float const *minY, float const *minZ,
+                  float const *maxX, float const *maxY, float const *maxZ,
+                  size_t count, uint32_t *visible) const;
 
 private:
   KPlane m_planes[6];
 };
 
+inline size_t KFrustum::maskWords(size_t count)
+{
+  return (count + 31) / 32;
+}
+
 #endif // KFRUSTUM_H
@@ -1,5 +1,6 @@
 #include "kgeometrycloud.h"
 
+#include <cstring>
 #include <KHalfEdgeMesh>
 #include <KMacros>
 #include <KMatrix4x4>
@@ -7,16 +8,59 @@
 #include <KTransform3D>
 #include <KTriangleIndexCloud>
 
+// FNV-1a over 64-bit words; every step is a bijection of the running hash, so
+// changing any single word of the input always changes the result.
+static const uint64_t sg_checksumBasis = 0xcbf29ce484222325ull;
+static const uint64_t sg_checksumPrime = 0x100000001b3ull;
+
+static inline uint64_t checksumStep(uint64_t hash, uint64_t word)
+{
+  return (hash ^ word) * sg_checksumPrime;
+}
+
+static inline uint64_t floatBits(float f)
+{
+  uint32_t bits;
+  std::memcpy(&bits, &f, sizeof(bits));
+  return bits;
+}
+
 /*******************************************************************************
  * KGeometryCloudPrivate
  ******************************************************************************/
 class KGeometryCloudPrivate
 {
 public:
+  KGeometryCloudPrivate();
   KPointCloud m_pointCloud;
   KTriangleIndexCloud m_triangleCloud;
+  size_t m_geometryCount;
 };
 
+KGeometryCloudPrivate::KGeometryCloudPrivate() :
+  m_geometryCount(0)
+{
+  // Intentionally Empty
+}
+
+/*******************************************************************************
+ * KGeometryCloud::Statistics
+ ******************************************************************************/
+KGeometryCloud::Statistics::Statistics() :
+  nodes(0), leaves(0), depth(0), memory(0), sahCost(0.0f)
+{
+  // Intentionally Empty
+}
+
+void KGeometryCloud::Statistics::addLeaf(size_t triangles)
+{
+  size_t bucket = 0;
+  while (triangles >> bucket) ++bucket;
+  if (leafHistogram.size() <= bucket) leafHistogram.resize(bucket + 1, 0);
+  ++leafHistogram[bucket];
+  ++leaves;
+}
+
 /*******************************************************************************
  * KGeometryCloud
  ******************************************************************************/
@@ -31,13 +75,13 @@ KGeometryCloud::~KGeometryCloud()
   // Intentionally Empty
 }
 
-void KGeometryCloud::addGeometry(const KHalfEdgeMesh &mesh)
+size_t KGeometryCloud::addGeometry(const KHalfEdgeMesh &mesh)
 {
   // Identity Transform3D will apply no change.
-  addGeometry(mesh, KTransform3D());
+  return addGeometry(mesh, KTransform3D());
 }
 
-void KGeometryCloud::addGeometry(const KHalfEdgeMesh &mesh, const KTransform3D &trans)
+size_t KGeometryCloud::addGeometry(const KHalfEdgeMesh &mesh, const KTransform3D &trans)
 {
   P(KGeometryCloudPrivate);
   size_t currOffset = p.m_pointCloud.size();
@@ -63,6 +107,7 @@ void KGeometryCloud::addGeometry(const KHalfEdgeMesh &mesh, const KTransform3D &
     triangle.indices[2] = mesh.unsafeHalfEdge(triangle.indices[2])->to;
     p.m_triangleCloud.emplace_back(triangle.offset(currOffset));
   }
+  return p.m_geometryCount++;
 }
 
 void KGeometryCloud::build(KGeometryCloud::BuildMethod method, KGeometryCloud::TerminationPred pred)
@@ -71,6 +116,11 @@ void KGeometryCloud::build(KGeometryCloud::BuildMethod method, KGeometryCloud::T
   (void)pred;
 }
 
+KGeometryCloud::Statistics KGeometryCloud::statistics() const
+{
+  return Statistics();
+}
+
 void KGeometryCloud::clear()
 {
   m_private = new KGeometryCloudPrivate;
@@ -82,6 +132,28 @@ bool KGeometryCloud::dirty() const
   return (!p.m_pointCloud.empty() || !p.m_triangleCloud.empty());
 }
 
+// Identifies the geometry added so far, so built structures can be cached.
+uint64_t KGeometryCloud::checksum() const
+{
+  P(const KGeometryCloudPrivate);
+  uint64_t hash = sg_checksumBasis;
+  hash = checksumStep(hash, p.m_pointCloud.size());
+  hash = checksumStep(hash, p.m_triangleCloud.size());
+  for (size_t i = 0; i < p.m_pointCloud.size(); ++i)
+  {
+    KVector3D const &point = p.m_pointCloud[i];
+    hash = checksumStep(hash, floatBits(point.x()) | (floatBits(point.y()) << 32));
+    hash = checksumStep(hash, floatBits(point.z()));
+  }
+  for (KTriangleIndexCloud::ElementType const &triangle : p.m_triangleCloud)
+  {
+    hash = checksumStep(hash, triangle.indices[0]);
+    hash = checksumStep(hash, triangle.indices[1]);
+    hash = checksumStep(hash, triangle.indices[2]);
+  }
+  return hash;
+}
+
 const KPointCloud &KGeometryCloud::pointCloud() const
 {
   P(const KGeometryCloudPrivate);
@@ -5,6 +5,9 @@ class KHalfEdgeMesh;
 class KTransform3D;
 class KPointCloud;
 class KTriangleIndexCloud;
+#include <cstddef>
+#include <cstdint>
+#include <vector>
 #include <KSharedPointer>
 
 class KGeometryCloudPrivate;
@@ -17,16 +20,33 @@ public:
   enum BuildMethod
   {
     TopDownMethod,
-    BottomUpMethod
+    BottomUpMethod,
+    SurfaceAreaMethod
   };
   typedef bool (*TerminationPred)(size_t numTriangles, size_t depth);
 
-  void addGeometry(KHalfEdgeMesh const &mesh);
-  void addGeometry(KHalfEdgeMesh const &mesh, KTransform3D const &trans);
+  // Shape of a built structure, for comparing build methods and predicates
+  struct Statistics
+  {
+    Statistics();
+    void addLeaf(size_t triangles);
+    size_t nodes;
+    size_t leaves;
+    size_t depth;
+    size_t memory;                      // Bytes held by the built structure
+    float sahCost;                      // 0 where nodes carry no bounds
+    std::vector<size_t> leafHistogram;  // [k]: Leaves of [2^(k-1), 2^k) triangles
+  };
+
+  // Returns the id of the geometry (Its order since the last clear())
+  size_t addGeometry(KHalfEdgeMesh const &mesh);
+  virtual size_t addGeometry(KHalfEdgeMesh const &mesh, KTransform3D const &trans);
   virtual void build(BuildMethod method, TerminationPred pred);
+  virtual Statistics statistics() const;
 
-  void clear();
+  virtual void clear();
   bool dirty() const;
+  uint64_t checksum() const;
 
   KPointCloud const &pointCloud() const;
   KTriangleIndexCloud const &triangleIndexCloud() const;
@@ -1,14 +1,22 @@
 #include "khalfedgemesh.h"
-#include "kbufferedfilereader.h"
+#include "kmappedfilereader.h"
+#include "kcachefile.h"
 #include "khalfedgeobjparser.h"
 #include "kvertex.h"
 #include "kaabbboundingvolume.h"
+#include "kparallel.h"
+#include "kradixsort.h"
 
 #include <algorithm>
+#include <array>
+#include <cmath>
 #include <functional>
 #include <unordered_map>
 
+#include <QDateTime>
 #include <QFile>
+#include <QFileInfo>
+#include <QStandardPaths>
 
 #include <OpenGLBuffer>
 #include <OpenGLFunctions>
@@ -74,6 +82,40 @@ struct IndicesHash : public std::unary_function<Indices::index_pair const&, Indi
   }
 };
 
+/*******************************************************************************
+ * Mesh Cache (.kmesh)
+ ******************************************************************************/
+// Layout: Header, Vertices, HalfEdges, Faces (each array 16-byte aligned).
+// Note: Bump the version whenever Vertex/HalfEdge/Face change layout.
+static char const sg_cacheMagic[4] = { 'K', 'M', 'S', 'H' };
+static const uint32_t sg_cacheVersion = 2;
+
+struct KMeshCacheHeader
+{
+  char magic[4];
+  uint32_t version;
+  uint32_t vertexSize;
+  uint32_t halfEdgeSize;
+  uint32_t faceSize;
+  uint32_t postProcessing;
+  uint64_t sourceSize;
+  int64_t sourceModified;
+  uint64_t numVertices;
+  uint64_t numHalfEdges;
+  uint64_t numFaces;
+  float aabbMin[3];
+  float aabbMax[3];
+};
+
+// Caches always go to the user cache, never beside the source assets; each
+// set of post-processing steps is cached separately.
+static QString cacheFileName(QFileInfo const &source, int postProcessing)
+{
+  QString cacheDir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+  QString sourcePath = source.absoluteFilePath();
+  return cacheDir + "/" + QString::number(qHash(sourcePath), 16) + "-" + source.fileName() + "." + QString::number(postProcessing) + ".kmesh";
+}
+
 /*******************************************************************************
  * HalfEdgeMeshPrivate
  ******************************************************************************/
@@ -99,12 +141,20 @@ public:
   typedef KHalfEdgeMesh::FaceContainer FaceContainer;
   typedef std::unordered_map<Indices,HalfEdgeIndex,IndicesHash> HalfEdgeLookup;
 
+  // Constructors
+  KHalfEdgeMeshPrivate();
+
   // Add Commands (Does not check if value already exists!)
+  void reserve(size_t vertices, size_t faces);
   inline VertexIndex addVertex(const KVector3D &v);
   HalfEdgeIndex addEdge(const index_array &from, const index_array &to);
   HalfEdgeIndex addHalfEdge(const index_array &from, const index_array &to);
   FaceIndex addFace(index_array &a, index_array &b, index_array &c);
 
+  // Sorted Construction (Faces are linked in bulk without the lookup table)
+  void beginSortedConstruction();
+  void endSortedConstruction();
+
   // Query Commands (index => elements)
   inline Vertex *vertex(VertexIndex const &idx);
   inline HalfEdge *halfEdge(HalfEdgeIndex const &idx);
@@ -146,12 +196,16 @@ public:
   inline HalfEdgeContainer const &halfEdges() const;
   inline FaceContainer const &faces() const;
 
+  // Cache
+  bool readCache(QString const &cacheName, KMeshCacheHeader const &expected);
+  bool writeCache(QString const &cacheName, KMeshCacheHeader const &header) const;
+  void rebuildLookup();
+
   // Helpers
   HalfEdgeIndex findHalfEdge(const index_array &from, const index_array &to);
   HalfEdgeIndex getHalfEdge(const index_array &from, const index_array &to);
   void normalizeIndex(index_type &v, size_t const &sizePlusOne);
   void initializeInnerHalfEdge(HalfEdgeIndex const &he, FaceIndex const &f, HalfEdgeIndex const &next);
-  KVector3D calculateFaceNormal(const Face *face);
   KVector3D calculateVertexNormal(const Vertex *vertex, std::vector<KVector3D> &accumulator);
   void connectBoundaries();
   void connectEdges(HalfEdge *edge);
@@ -166,11 +220,39 @@ private:
   FaceContainer m_faces;
   HalfEdgeLookup m_halfEdgeLookup;
   KAabbBoundingVolume m_aabb;
+
+  // Sorted Construction
+  typedef std::array<index_type, 3> PendingFace;
+  bool m_sortedConstruction;
+  std::vector<PendingFace> m_pendingFaces;
 };
 
+KHalfEdgeMeshPrivate::KHalfEdgeMeshPrivate() :
+  m_sortedConstruction(false)
+{
+  // Intentionally Empty
+}
+
 /*******************************************************************************
  * HalfEdgeMeshPrivate :: Add Commands
  ******************************************************************************/
+void KHalfEdgeMeshPrivate::reserve(size_t vertices, size_t faces)
+{
+  if (m_sortedConstruction)
+  {
+    m_vertices.reserve(m_vertices.size() + vertices);
+    m_pendingFaces.reserve(m_pendingFaces.size() + faces);
+    return;
+  }
+
+  // Closed triangle meshes have ~1.5 edges per face, each edge being two half-edges.
+  size_t edges = faces + faces / 2;
+  m_vertices.reserve(m_vertices.size() + vertices);
+  m_faces.reserve(m_faces.size() + faces);
+  m_halfEdges.reserve(m_halfEdges.size() + 2 * edges);
+  m_halfEdgeLookup.reserve(m_halfEdgeLookup.size() + edges);
+}
+
 inline KHalfEdgeMeshPrivate::VertexIndex KHalfEdgeMeshPrivate::addVertex(const KVector3D &v)
 {
   m_vertices.emplace_back(v, 0);
@@ -213,6 +295,14 @@ KHalfEdgeMeshPrivate::FaceIndex KHalfEdgeMeshPrivate::addFace(index_array &v1, i
   normalizeIndex(v2[0], size);
   normalizeIndex(v3[0], size);
 
+  // Defer linking until every face is known
+  if (m_sortedConstruction)
+  {
+    PendingFace face = {{ v1[0], v2[0], v3[0] }};
+    m_pendingFaces.push_back(face);
+    return FaceIndex(static_cast<index_type>(m_faces.size() + m_pendingFaces.size()));
+  }
+
   // Create edges
   HalfEdgeIndex edgeA = getHalfEdge(v1, v2);
   HalfEdgeIndex edgeB = getHalfEdge(v2, v3);
@@ -235,6 +325,108 @@ KHalfEdgeMeshPrivate::FaceIndex KHalfEdgeMeshPrivate::addFace(index_array &v1, i
   return faceIdx;
 }
 
+void KHalfEdgeMeshPrivate::beginSortedConstruction()
+{
+  m_sortedConstruction = true;
+  m_pendingFaces.clear();
+}
+
+void KHalfEdgeMeshPrivate::endSortedConstruction()
+{
+  m_sortedConstruction = false;
+  std::vector<PendingFace> pending;
+  pending.swap(m_pendingFaces);
+
+  // Existing edges live in the lookup, merge the new faces incrementally.
+  if (!m_halfEdges.empty())
+  {
+    for (PendingFace &f : pending)
+    {
+      index_array a = {{ f[0], 0, 0 }}, b = {{ f[1], 0, 0 }}, c = {{ f[2], 0, 0 }};
+      addFace(a, b, c);
+    }
+    return;
+  }
+
+  // Directed edge d = 3 * face + corner, running from corner to corner + 1.
+  size_t faceCount = pending.size();
+  size_t directedCount = 3 * faceCount;
+  std::vector<uint64_t> keys(directedCount);
+  std::vector<uint32_t> order(directedCount);
+  Karma::parallelFor(faceCount, 4096, [&pending, &keys, &order](size_t begin, size_t end)
+  {
+    for (size_t f = begin; f < end; ++f)
+    {
+      for (size_t k = 0; k < 3; ++k)
+      {
+        Indices idx(pending[f][k], pending[f][(k + 1) % 3]);
+        keys[3 * f + k] = (uint64_t(idx.low) << 32) | idx.high;
+        order[3 * f + k] = static_cast<uint32_t>(3 * f + k);
+      }
+    }
+  });
+
+  // Equal (min,max) keys become adjacent; stability keeps the first use first.
+  Karma::radixSort(keys, order);
+
+  // Each group shares one edge, its leader is the earliest directed edge.
+  std::vector<uint32_t> leader(directedCount);
+  std::vector<uint32_t> edgeOf(directedCount, 0);
+  for (size_t i = 0; i < directedCount; ++i)
+  {
+    uint32_t first = (i > 0 && keys[i] == keys[i - 1]) ? leader[order[i - 1]] : order[i];
+    leader[order[i]] = first;
+    if (first == order[i]) edgeOf[first] = 1;
+  }
+
+  // Number edges in order of first use, matching incremental construction.
+  uint32_t edgeCount = 0;
+  for (size_t d = 0; d < directedCount; ++d)
+  {
+    if (edgeOf[d]) edgeOf[d] = ++edgeCount;
+  }
+
+  // Allocate the (low, high) half-edge pairs, see addEdge().
+  m_halfEdges.reserve(2 * edgeCount);
+  for (size_t d = 0; d < directedCount; ++d)
+  {
+    if (leader[d] != d) continue;
+    Indices idx(pending[d / 3][d % 3], pending[d / 3][(d + 1) % 3]);
+    m_halfEdges.emplace_back(idx.low);
+    m_halfEdges.emplace_back(idx.high);
+  }
+
+  // Resolve every directed edge to its half-edge.
+  std::vector<index_type> halfEdgeOf(directedCount);
+  Karma::parallelFor(directedCount, 4096, [&](size_t begin, size_t end)
+  {
+    for (size_t d = begin; d < end; ++d)
+    {
+      index_type from = pending[d / 3][d % 3];
+      index_type to = pending[d / 3][(d + 1) % 3];
+      index_type offset = 2 * edgeOf[leader[d]] - 1;
+      halfEdgeOf[d] = (from > to) ? offset : offset + 1;
+    }
+  });
+
+  // Link faces in order (Sequential: non-manifold edges are last-writer-wins).
+  m_faces.reserve(m_faces.size() + faceCount);
+  for (size_t f = 0; f < faceCount; ++f)
+  {
+    HalfEdgeIndex edgeA = halfEdgeOf[3 * f + 0];
+    HalfEdgeIndex edgeB = halfEdgeOf[3 * f + 1];
+    HalfEdgeIndex edgeC = halfEdgeOf[3 * f + 2];
+    m_faces.emplace_back(edgeA);
+    FaceIndex faceIdx = FaceIndex(static_cast<index_type>(m_faces.size()));
+    initializeInnerHalfEdge(edgeA, faceIdx, edgeB);
+    initializeInnerHalfEdge(edgeB, faceIdx, edgeC);
+    initializeInnerHalfEdge(edgeC, faceIdx, edgeA);
+    if (vertex(pending[f][0])->to == 0) vertex(pending[f][0])->to = edgeA;
+    if (vertex(pending[f][1])->to == 0) vertex(pending[f][1])->to = edgeB;
+    if (vertex(pending[f][2])->to == 0) vertex(pending[f][2])->to = edgeC;
+  }
+}
+
 /*******************************************************************************
  * HalfEdgeMeshPrivate :: Query Commands (index => element)
  ******************************************************************************/
@@ -415,6 +607,9 @@ inline KHalfEdgeMeshPrivate::HalfEdgeIndex KHalfEdgeMeshPrivate::cwBoundsIndex(H
  ******************************************************************************/
 KHalfEdgeMeshPrivate::HalfEdgeIndex KHalfEdgeMeshPrivate::findHalfEdge(const index_array &from, const index_array &to)
 {
+  // Meshes loaded from a cache carry no lookup until they are modified.
+  if (m_halfEdgeLookup.empty() && !m_halfEdges.empty()) rebuildLookup();
+
   HalfEdgeLookup::const_iterator it = m_halfEdgeLookup.find(Indices(from[0], to[0]));
   if (it == m_halfEdgeLookup.end()) return 0;
 
@@ -448,27 +643,6 @@ inline void KHalfEdgeMeshPrivate::initializeInnerHalfEdge(const KHalfEdgeMeshPri
   edge->next = next;
 }
 
-KVector3D KHalfEdgeMeshPrivate::calculateFaceNormal(const Face *face)
-{
-  const HalfEdge *edge = halfEdge(face->first);
-
-  KVector3D pos1 = vertex(edge->to)->position;
-  edge = halfEdge(edge->next);
-  KVector3D pos2 = vertex(edge->to)->position;
-  edge = halfEdge(edge->next);
-  KVector3D pos3 = vertex(edge->to)->position;
-
-  KVector3D a = pos2 - pos1;
-  KVector3D b = pos3 - pos1;
-  KVector3D c = KVector3D::crossProduct(a,b);
-
-  // Note: QVector3D cannot handle small values.
-  float length = c.length();
-  if (length != 0.0f) c /= length;
-
-  return c;
-}
-
 struct DotTest : public std::binary_function<bool, KVector3D const&, KVector3D const&>
 {
   DotTest(KVector3D const &x) : _x(x) {}
@@ -535,20 +709,70 @@ void KHalfEdgeMeshPrivate::connectEdges(KHalfEdgeMeshPrivate::HalfEdge *edge)
 
 void KHalfEdgeMeshPrivate::calculateFaceNormals()
 {
-  for (Face &f : m_faces)
+  // Each worker gathers a block of faces into SoA scratch so that the cross
+  // products and normalization run as straight (vectorizable) float loops.
+  static const size_t BlockSize = 256;
+  Karma::parallelFor(m_faces.size(), 16 * BlockSize, [this](size_t begin, size_t end)
   {
-    f.normal = calculateFaceNormal(&f);
-  }
+    float ax[BlockSize], ay[BlockSize], az[BlockSize];
+    float bx[BlockSize], by[BlockSize], bz[BlockSize];
+    float nx[BlockSize], ny[BlockSize], nz[BlockSize];
+    for (size_t base = begin; base < end; base += BlockSize)
+    {
+      size_t count = std::min(BlockSize, end - base);
+
+      // Gather (AoS => SoA)
+      for (size_t i = 0; i < count; ++i)
+      {
+        const HalfEdge *edge = halfEdge(m_faces[base + i].first);
+        KVector3D const &pos1 = vertex(edge->to)->position;
+        edge = halfEdge(edge->next);
+        KVector3D const &pos2 = vertex(edge->to)->position;
+        edge = halfEdge(edge->next);
+        KVector3D const &pos3 = vertex(edge->to)->position;
+        ax[i] = pos2.x() - pos1.x(); ay[i] = pos2.y() - pos1.y(); az[i] = pos2.z() - pos1.z();
+        bx[i] = pos3.x() - pos1.x(); by[i] = pos3.y() - pos1.y(); bz[i] = pos3.z() - pos1.z();
+      }
+
+      // Cross product and normalize
+      // Note: The length is summed in double like QVector3D::length(), so
+      //       small cross products do not underflow to a zero length.
+      for (size_t i = 0; i < count; ++i)
+      {
+        float cx = ay[i] * bz[i] - az[i] * by[i];
+        float cy = az[i] * bx[i] - ax[i] * bz[i];
+        float cz = ax[i] * by[i] - ay[i] * bx[i];
+        double length2 = double(cx) * double(cx) + double(cy) * double(cy) + double(cz) * double(cz);
+        float length = float(std::sqrt(length2));
+        float divisor = (length != 0.0f) ? length : 1.0f;
+        nx[i] = cx / divisor;
+        ny[i] = cy / divisor;
+        nz[i] = cz / divisor;
+      }
+
+      // Scatter (SoA => AoS)
+      for (size_t i = 0; i < count; ++i)
+      {
+        m_faces[base + i].normal = KVector3D(nx[i], ny[i], nz[i]);
+      }
+    }
+  });
 }
 
 void KHalfEdgeMeshPrivate::calculateVertexNormals()
 {
-  std::vector<KVector3D> accumulator;
   calculateFaceNormals();
-  for (Vertex &v : m_vertices)
+
+  // Every vertex gathers over its own one-ring, so the result does not
+  // depend on how vertices are distributed across workers.
+  Karma::parallelFor(m_vertices.size(), 4096, [this](size_t begin, size_t end)
   {
-    v.normal = calculateVertexNormal(&v, accumulator);
-  }
+    std::vector<KVector3D> accumulator;
+    for (size_t i = begin; i < end; ++i)
+    {
+      m_vertices[i].normal = calculateVertexNormal(&m_vertices[i], accumulator);
+    }
+  });
 }
 
 void KHalfEdgeMeshPrivate::normalizeVertices()
@@ -577,6 +801,93 @@ void KHalfEdgeMeshPrivate::fixToCenter()
   m_aabb.shiftCenter(shift);
 }
 
+/*******************************************************************************
+ * HalfEdgeMeshPrivate :: Cache Commands
+ ******************************************************************************/
+bool KHalfEdgeMeshPrivate::readCache(const QString &cacheName, const KMeshCacheHeader &expected)
+{
+  // Validate the header against what this build (and source) expects
+  KCacheFileReader reader(cacheName);
+  KMeshCacheHeader header;
+  if (!reader.readHeader(header, expected) ||
+      header.vertexSize != expected.vertexSize ||
+      header.halfEdgeSize != expected.halfEdgeSize ||
+      header.faceSize != expected.faceSize ||
+      header.postProcessing != expected.postProcessing ||
+      header.sourceSize != expected.sourceSize ||
+      header.sourceModified != expected.sourceModified)
+  {
+    return false;
+  }
+
+  // Validate the payload size
+  Vertex const *vertices = reader.readSection<Vertex>(header.numVertices);
+  HalfEdge const *halfEdges = reader.readSection<HalfEdge>(header.numHalfEdges);
+  Face const *faces = reader.readSection<Face>(header.numFaces);
+  if (!vertices || !halfEdges || !faces) return false;
+
+  // Validate the connectivity (Indices start from 1, 0 refers to nothing)
+  if (header.numHalfEdges % 2 != 0) return false;
+  for (size_t i = 0; i < header.numVertices; ++i)
+  {
+    if (vertices[i].to > header.numHalfEdges) return false;
+  }
+  for (size_t i = 0; i < header.numHalfEdges; ++i)
+  {
+    HalfEdge const &edge = halfEdges[i];
+    if (edge.to == 0 || edge.to > header.numVertices) return false;
+    if (edge.face > header.numFaces || edge.next > header.numHalfEdges) return false;
+  }
+  for (size_t i = 0; i < header.numFaces; ++i)
+  {
+    if (faces[i].first == 0 || faces[i].first > header.numHalfEdges) return false;
+  }
+
+  // Note: The element types are trivially copyable, each array is a single copy.
+  m_vertices.assign(vertices, vertices + header.numVertices);
+  m_halfEdges.assign(halfEdges, halfEdges + header.numHalfEdges);
+  m_faces.assign(faces, faces + header.numFaces);
+  m_halfEdgeLookup.clear();
+
+  Karma::MinMaxKVector3D minMax;
+  minMax.min = KVector3D(header.aabbMin[0], header.aabbMin[1], header.aabbMin[2]);
+  minMax.max = KVector3D(header.aabbMax[0], header.aabbMax[1], header.aabbMax[2]);
+  m_aabb.setMinMaxBounds(minMax);
+  return true;
+}
+
+bool KHalfEdgeMeshPrivate::writeCache(const QString &cacheName, const KMeshCacheHeader &expected) const
+{
+  KCacheFileWriter file(cacheName);
+  if (!file.valid()) return false;
+
+  KMeshCacheHeader header = expected;
+  header.numVertices = m_vertices.size();
+  header.numHalfEdges = m_halfEdges.size();
+  header.numFaces = m_faces.size();
+  KVector3D const &min = m_aabb.minExtent();
+  KVector3D const &max = m_aabb.maxExtent();
+  header.aabbMin[0] = min.x(); header.aabbMin[1] = min.y(); header.aabbMin[2] = min.z();
+  header.aabbMax[0] = max.x(); header.aabbMax[1] = max.y(); header.aabbMax[2] = max.z();
+
+  file.writeSection(&header, sizeof(KMeshCacheHeader));
+  file.writeSection(m_vertices.data(), m_vertices.size() * sizeof(Vertex));
+  file.writeSection(m_halfEdges.data(), m_halfEdges.size() * sizeof(HalfEdge));
+  file.writeSection(m_faces.data(), m_faces.size() * sizeof(Face));
+  return file.commit();
+}
+
+void KHalfEdgeMeshPrivate::rebuildLookup()
+{
+  // Edges are stored as (low, high) half-edge pairs, see addEdge().
+  m_halfEdgeLookup.reserve(m_halfEdges.size() / 2);
+  for (size_t i = 0; i + 1 < m_halfEdges.size(); i += 2)
+  {
+    Indices idx(m_halfEdges[i].to, m_halfEdges[i + 1].to);
+    m_halfEdgeLookup.emplace(idx, HalfEdgeIndex(static_cast<index_type>(i + 1)));
+  }
+}
+
 /*******************************************************************************
  * Half Edge Mesh Public
  ******************************************************************************/
@@ -593,24 +904,58 @@ KHalfEdgeMesh::~KHalfEdgeMesh()
   // Intentionally Empty
 }
 
-bool KHalfEdgeMesh::create(const char *fileName)
+// The cache holds the post-processed mesh, so a cached load returns exactly
+// what parsing and post-processing the source would.
+bool KHalfEdgeMesh::create(const char *fileName, int postProcessing)
 {
   P(KHalfEdgeMeshPrivate);
-  KBufferedFileReader reader(fileName, 2048);
+
+  // A cache is only fresh if it was generated from this exact source revision.
+  QFileInfo source(fileName);
+  QString cacheName = cacheFileName(source, postProcessing);
+  KMeshCacheHeader header = KCacheFile::header<KMeshCacheHeader>(sg_cacheMagic, sg_cacheVersion);
+  header.vertexSize = sizeof(Vertex);
+  header.halfEdgeSize = sizeof(HalfEdge);
+  header.faceSize = sizeof(Face);
+  header.postProcessing = static_cast<uint32_t>(postProcessing);
+  header.sourceSize = static_cast<uint64_t>(source.size());
+  header.sourceModified = source.lastModified().toMSecsSinceEpoch();
+  if (p.readCache(cacheName, header))
+  {
+    return true;
+  }
+
+  KMappedFileReader reader(fileName);
   if (!reader.valid())
   {
     qFatal("Failed to open file: `%s`", qPrintable(fileName));
   }
   KHalfEdgeObjParser parser(this, &reader);
   parser.initialize();
-  if (parser.parse())
+  p.beginSortedConstruction();
+  bool parsed = parser.parse(KAbstractObjParser::ParallelMethod);
+  p.endSortedConstruction();
+  if (parsed)
   {
     p.connectBoundaries();
+    if (postProcessing & VertexNormalsPostProcess) p.calculateVertexNormals();
+    if (postProcessing & CenterPostProcess) p.fixToCenter();
+    if (postProcessing & NormalizePostProcess) p.normalizeVertices();
+    if (!p.writeCache(cacheName, header))
+    {
+      qWarning("Failed to write mesh cache: `%s`", qPrintable(cacheName));
+    }
     return true;
   }
   return false;
 }
 
+void KHalfEdgeMesh::reserve(SizeType vertices, SizeType faces)
+{
+  P(KHalfEdgeMeshPrivate);
+  p.reserve(vertices, faces);
+}
+
 KHalfEdgeMesh::VertexIndex KHalfEdgeMesh::addVertex(const KVector3D &v)
 {
   P(KHalfEdgeMeshPrivate);
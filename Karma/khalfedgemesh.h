@@ -93,12 +93,21 @@ public:
 
 public:
 
+  // Post-processing applied by create() (In this order)
+  enum PostProcess
+  {
+    VertexNormalsPostProcess = 0x1,
+    CenterPostProcess = 0x2,
+    NormalizePostProcess = 0x4
+  };
+
   // Constructors / Destructor
   KHalfEdgeMesh(QObject *parent = 0);
   ~KHalfEdgeMesh();
-  bool create(char const *fileName);
+  bool create(char const *fileName, int postProcessing = 0);
 
   // Add Commands (Does not check if value already exists!)
+  void reserve(SizeType vertices, SizeType faces);
   VertexIndex addVertex(const KVector3D &v);
   FaceIndex addFace(index_array &a, index_array &b, index_array &c);
 
@@ -89,3 +89,29 @@ void KHalfEdgeObjParser::onSmooth(char *smooth)
   // Unsupported
   (void)smooth;
 }
+
+void KHalfEdgeObjParser::onReserve(size_type vertices, size_type textures, size_type normals, size_type parameters, size_type faces)
+{
+  (void)textures;
+  (void)normals;
+  (void)parameters;
+  m_mesh->reserve(vertices, faces);
+}
+
+void KHalfEdgeObjParser::onVertices(float vertices[][4], size_type count)
+{
+  for (size_type i = 0; i < count; ++i)
+  {
+    m_mesh->addVertex(KVector3D(vertices[i][0], vertices[i][1], vertices[i][2]));
+  }
+}
+
+void KHalfEdgeObjParser::onFaces(index_array indices[], size_type const sizes[], size_type count)
+{
+  // Note: Same as KAbstractObjParser::onFaces(), without a virtual call per face.
+  for (size_type i = 0; i < count; ++i)
+  {
+    KHalfEdgeObjParser::onFace(indices, sizes[i]);
+    indices += sizes[i];
+  }
+}
@@ -21,6 +21,9 @@ protected:
   virtual void onUseMaterial(char *mat);
   virtual void onObject(char *obj);
   virtual void onSmooth(char *smooth);
+  virtual void onReserve(size_type vertices, size_type textures, size_type normals, size_type parameters, size_type faces);
+  virtual void onVertices(float vertices[][4], size_type count);
+  virtual void onFaces(index_array indices[], size_type const sizes[], size_type count);
 private:
   KHalfEdgeMesh *m_mesh;
 };
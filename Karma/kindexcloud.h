@@ -12,6 +12,7 @@ public:
 
   void reserve(size_t count);
   void emplace_back(ElementType elm);
+  size_t size() const;
 private:
   ContainerType m_container;
 };
@@ -26,5 +27,10 @@ inline void KIndexCloud::emplace_back(ElementType elm)
   m_container.emplace_back(elm);
 }
 
+inline size_t KIndexCloud::size() const
+{
+  return m_container.size();
+}
+
 #endif // KINDEXCLOUD_H
 
@@ -0,0 +1,363 @@
+#ifndef KLOOSEOCTREE_H
+#define KLOOSEOCTREE_H KLooseOctree
+
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <utility>
+#include <vector>
+#include <KVector3D>
+#include <KFrustum>
+
+// Spatial index over moving bounding boxes. Every object lives in the cell at
+// the depth matching its size which contains its center; cells are loose (Twice
+// their size), so an object never straddles a cell. Inserting, removing and
+// moving an object only touch the cells along one root-to-leaf path, and moves
+// which stay within a cell only update the stored bounds.
+template <typename T>
+class KLooseOctree
+{
+public:
+  typedef size_t Handle;
+
+  KLooseOctree(KVector3D const &center = KVector3D(0.0f, 0.0f, 0.0f), float halfExtent = 1024.0f, size_t maxDepth = 8);
+
+  Handle insert(T const &value, KVector3D const &min, KVector3D const &max);
+  void remove(Handle handle);
+  void move(Handle handle, KVector3D const &min, KVector3D const &max);
+  void clear();
+  T const &value(Handle handle) const;
+  size_t size() const;
+
+  // Calls func(value) for every object whose bounds overlap the volume
+  template <typename Func>
+  void query(KFrustum const &frustum, Func func) const;
+  template <typename Func>
+  void query(KVector3D const &min, KVector3D const &max, Func func) const;
+
+private:
+  static const uint32_t InvalidIndex = ~uint32_t(0);
+
+  struct Entry
+  {
+    T value;
+    KVector3D min, max;
+    uint32_t node;
+    uint32_t slot;
+  };
+
+  struct Node
+  {
+    uint32_t parent;
+    uint32_t children[8];
+    uint32_t level;
+    uint32_t cell[3];
+    size_t subtreeCount;
+    std::vector<uint32_t> entries;
+  };
+
+  void locate(KVector3D const &min, KVector3D const &max, uint32_t &level, uint32_t *cell) const;
+  uint32_t findOrCreateNode(uint32_t level, uint32_t const *cell);
+  void link(uint32_t index, uint32_t node);
+  void unlink(uint32_t index);
+  void looseBounds(Node const &node, KVector3D &min, KVector3D &max) const;
+  static bool overlaps(KVector3D const &aMin, KVector3D const &aMax, KVector3D const &bMin, KVector3D const &bMax);
+
+  KVector3D m_min;
+  float m_extent;
+  size_t m_maxDepth;
+  size_t m_count;
+  std::vector<Entry> m_entries;
+  std::vector<uint32_t> m_freeEntries;
+  std::vector<Node> m_nodes;
+  std::vector<uint32_t> m_freeNodes;
+};
+
+template <typename T>
+const uint32_t KLooseOctree<T>::InvalidIndex;
+
+template <typename T>
+KLooseOctree<T>::KLooseOctree(KVector3D const &center, float halfExtent, size_t maxDepth) :
+  m_min(center - KVector3D(halfExtent, halfExtent, halfExtent)),
+  m_extent(2.0f * halfExtent),
+  m_maxDepth(std::min<size_t>(maxDepth, 20)),
+  m_count(0)
+{
+  clear();
+}
+
+template <typename T>
+auto KLooseOctree<T>::insert(T const &value, KVector3D const &min, KVector3D const &max) -> Handle
+{
+  uint32_t index;
+  if (m_freeEntries.empty())
+  {
+    index = static_cast<uint32_t>(m_entries.size());
+    m_entries.emplace_back();
+  }
+  else
+  {
+    index = m_freeEntries.back();
+    m_freeEntries.pop_back();
+  }
+
+  Entry &entry = m_entries[index];
+  entry.value = value;
+  entry.min = min;
+  entry.max = max;
+
+  uint32_t level, cell[3];
+  locate(min, max, level, cell);
+  link(index, findOrCreateNode(level, cell));
+  ++m_count;
+  return index;
+}
+
+template <typename T>
+void KLooseOctree<T>::remove(Handle handle)
+{
+  unlink(static_cast<uint32_t>(handle));
+  m_entries[handle].value = T();
+  m_freeEntries.push_back(static_cast<uint32_t>(handle));
+  --m_count;
+}
+
+template <typename T>
+void KLooseOctree<T>::move(Handle handle, KVector3D const &min, KVector3D const &max)
+{
+  Entry &entry = m_entries[handle];
+  entry.min = min;
+  entry.max = max;
+
+  // Most moves stay within the same cell
+  uint32_t level, cell[3];
+  locate(min, max, level, cell);
+  Node const &current = m_nodes[entry.node];
+  if (current.level == level && std::equal(cell, cell + 3, current.cell)) return;
+
+  unlink(static_cast<uint32_t>(handle));
+  link(static_cast<uint32_t>(handle), findOrCreateNode(level, cell));
+}
+
+template <typename T>
+void KLooseOctree<T>::clear()
+{
+  m_entries.clear();
+  m_freeEntries.clear();
+  m_nodes.clear();
+  m_freeNodes.clear();
+  m_count = 0;
+
+  Node root;
+  root.parent = InvalidIndex;
+  std::fill(root.children, root.children + 8, InvalidIndex);
+  root.level = 0;
+  std::fill(root.cell, root.cell + 3, 0);
+  root.subtreeCount = 0;
+  m_nodes.push_back(root);
+}
+
+template <typename T>
+T const &KLooseOctree<T>::value(Handle handle) const
+{
+  return m_entries[handle].value;
+}
+
+template <typename T>
+size_t KLooseOctree<T>::size() const
+{
+  return m_count;
+}
+
+template <typename T>
+template <typename Func>
+void KLooseOctree<T>::query(KFrustum const &frustum, Func func) const
+{
+  // (Node, Planes the node is not yet known to be inside of)
+  std::vector<std::pair<uint32_t, int>> stack(1, std::make_pair(0u, int(KFrustum::AllPlanes)));
+  KVector3D min, max;
+  while (!stack.empty())
+  {
+    uint32_t index = stack.back().first;
+    int planeMask = stack.back().second;
+    stack.pop_back();
+    Node const &node = m_nodes[index];
+    if (node.subtreeCount == 0) continue;
+
+    int firstPlane = 0;
+    looseBounds(node, min, max);
+    bool visible = (planeMask == 0 || frustum.intersects(min, max, planeMask, firstPlane));
+    if (!visible && index != 0) continue;
+
+    // The root also holds objects outside of its bounds, so always test those
+    for (uint32_t e : node.entries)
+    {
+      Entry const &entry = m_entries[e];
+      int entryMask = (index == 0) ? int(KFrustum::AllPlanes) : planeMask;
+      int entryPlane = 0;
+      if (entryMask == 0 || frustum.intersects(entry.min, entry.max, entryMask, entryPlane))
+      {
+        func(entry.value);
+      }
+    }
+    if (!visible) continue;
+    for (uint32_t child : node.children)
+    {
+      if (child != InvalidIndex) stack.push_back(std::make_pair(child, planeMask));
+    }
+  }
+}
+
+template <typename T>
+template <typename Func>
+void KLooseOctree<T>::query(KVector3D const &min, KVector3D const &max, Func func) const
+{
+  std::vector<uint32_t> stack(1, 0u);
+  KVector3D nodeMin, nodeMax;
+  while (!stack.empty())
+  {
+    uint32_t index = stack.back();
+    stack.pop_back();
+    Node const &node = m_nodes[index];
+    if (node.subtreeCount == 0) continue;
+
+    looseBounds(node, nodeMin, nodeMax);
+    if (index != 0 && !overlaps(min, max, nodeMin, nodeMax)) continue;
+    for (uint32_t e : node.entries)
+    {
+      Entry const &entry = m_entries[e];
+      if (overlaps(min, max, entry.min, entry.max)) func(entry.value);
+    }
+    for (uint32_t child : node.children)
+    {
+      if (child != InvalidIndex) stack.push_back(child);
+    }
+  }
+}
+
+// Deepest level whose cells are at least as large as the object.
+template <typename T>
+void KLooseOctree<T>::locate(KVector3D const &min, KVector3D const &max, uint32_t &level, uint32_t *cell) const
+{
+  KVector3D center = (min + max) * 0.5f;
+  KVector3D extent = max - min;
+  float size = std::max(extent.x(), std::max(extent.y(), extent.z()));
+  float position[3] = { center.x() - m_min.x(), center.y() - m_min.y(), center.z() - m_min.z() };
+  level = 0;
+  std::fill(cell, cell + 3, 0);
+
+  // Centers outside the root cannot be held by any deeper loose cell
+  for (int k = 0; k < 3; ++k)
+  {
+    if (!(position[k] >= 0.0f && position[k] <= m_extent)) return;
+  }
+
+  float cellSize = m_extent;
+  while (level < m_maxDepth && size <= cellSize * 0.5f)
+  {
+    cellSize *= 0.5f;
+    ++level;
+  }
+  uint32_t cells = uint32_t(1) << level;
+  for (int k = 0; k < 3; ++k)
+  {
+    cell[k] = std::min(static_cast<uint32_t>(position[k] / cellSize), cells - 1);
+  }
+}
+
+template <typename T>
+uint32_t KLooseOctree<T>::findOrCreateNode(uint32_t level, uint32_t const *cell)
+{
+  uint32_t index = 0;
+  for (uint32_t depth = 1; depth <= level; ++depth)
+  {
+    uint32_t shift = level - depth;
+    uint32_t child = ((cell[0] >> shift) & 1) | (((cell[1] >> shift) & 1) << 1) | (((cell[2] >> shift) & 1) << 2);
+    uint32_t next = m_nodes[index].children[child];
+    if (next == InvalidIndex)
+    {
+      if (m_freeNodes.empty())
+      {
+        next = static_cast<uint32_t>(m_nodes.size());
+        m_nodes.emplace_back();
+      }
+      else
+      {
+        next = m_freeNodes.back();
+        m_freeNodes.pop_back();
+      }
+      Node &node = m_nodes[next];
+      node.parent = index;
+      std::fill(node.children, node.children + 8, InvalidIndex);
+      node.level = depth;
+      for (int k = 0; k < 3; ++k)
+      {
+        node.cell[k] = cell[k] >> shift;
+      }
+      node.subtreeCount = 0;
+      node.entries.clear();
+      m_nodes[index].children[child] = next;
+    }
+    index = next;
+  }
+  return index;
+}
+
+template <typename T>
+void KLooseOctree<T>::link(uint32_t index, uint32_t node)
+{
+  Entry &entry = m_entries[index];
+  entry.node = node;
+  entry.slot = static_cast<uint32_t>(m_nodes[node].entries.size());
+  m_nodes[node].entries.push_back(index);
+  for (uint32_t n = node; n != InvalidIndex; n = m_nodes[n].parent)
+  {
+    ++m_nodes[n].subtreeCount;
+  }
+}
+
+// Swaps the entry out of its cell and releases cells which become empty.
+template <typename T>
+void KLooseOctree<T>::unlink(uint32_t index)
+{
+  Entry const &entry = m_entries[index];
+  std::vector<uint32_t> &entries = m_nodes[entry.node].entries;
+  uint32_t last = entries.back();
+  entries[entry.slot] = last;
+  m_entries[last].slot = entry.slot;
+  entries.pop_back();
+
+  uint32_t n = entry.node;
+  while (n != InvalidIndex)
+  {
+    Node &node = m_nodes[n];
+    uint32_t parent = node.parent;
+    if (--node.subtreeCount == 0 && parent != InvalidIndex)
+    {
+      uint32_t *children = m_nodes[parent].children;
+      *std::find(children, children + 8, n) = InvalidIndex;
+      m_freeNodes.push_back(n);
+    }
+    n = parent;
+  }
+}
+
+template <typename T>
+void KLooseOctree<T>::looseBounds(Node const &node, KVector3D &min, KVector3D &max) const
+{
+  float cellSize = m_extent / float(uint32_t(1) << node.level);
+  KVector3D cellMin = m_min + KVector3D(float(node.cell[0]), float(node.cell[1]), float(node.cell[2])) * cellSize;
+  KVector3D half(cellSize * 0.5f, cellSize * 0.5f, cellSize * 0.5f);
+  min = cellMin - half;
+  max = cellMin + KVector3D(cellSize, cellSize, cellSize) + half;
+}
+
+template <typename T>
+bool KLooseOctree<T>::overlaps(KVector3D const &aMin, KVector3D const &aMax, KVector3D const &bMin, KVector3D const &bMax)
+{
+  return aMin.x() <= bMax.x() && aMax.x() >= bMin.x()
+      && aMin.y() <= bMax.y() && aMax.y() >= bMin.y()
+      && aMin.z() <= bMax.z() && aMax.z() >= bMin.z();
+}
+
+#endif // KLOOSEOCTREE_H
@@ -0,0 +1,120 @@
+#include "kmappedfilereader.h"
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+
+#include <KMacros>
+
+/*******************************************************************************
+ * KMappedFileReaderPrivate
+ ******************************************************************************/
+class KMappedFileReaderPrivate
+{
+public:
+  inline KMappedFileReaderPrivate();
+  inline KMappedFileReaderPrivate(const QString &fileName);
+  inline ~KMappedFileReaderPrivate();
+  inline int next();
+  QFile m_file;
+  QByteArray m_fallback;
+  uchar *m_mapped;
+  char const *m_begin; // Note: (m_begin == Null) ? !isValid : isValid;
+  char const *m_end;
+  char const *m_pos;
+};
+
+inline KMappedFileReaderPrivate::KMappedFileReaderPrivate() :
+  m_file(), m_mapped(Q_NULLPTR), m_begin(Q_NULLPTR), m_end(Q_NULLPTR), m_pos(Q_NULLPTR)
+{
+  // Intentionally Empty
+}
+
+inline KMappedFileReaderPrivate::KMappedFileReaderPrivate(const QString &fileName) :
+  m_file(fileName), m_mapped(Q_NULLPTR), m_begin(Q_NULLPTR), m_end(Q_NULLPTR), m_pos(Q_NULLPTR)
+{
+  if (m_file.open(QFile::ReadOnly))
+  {
+    qint64 fileSize = m_file.size();
+    if (fileSize > 0)
+    {
+      m_mapped = m_file.map(0, fileSize);
+    }
+
+    // Compressed resources (and some devices) cannot be mapped, read them whole.
+    if (m_mapped)
+    {
+      m_begin = reinterpret_cast<char const*>(m_mapped);
+      m_end = m_begin + fileSize;
+    }
+    else
+    {
+      m_fallback = m_file.readAll();
+      m_begin = m_fallback.constData();
+      m_end = m_begin + m_fallback.size();
+    }
+    m_pos = m_begin;
+  }
+}
+
+inline KMappedFileReaderPrivate::~KMappedFileReaderPrivate()
+{
+  if (m_mapped)
+  {
+    m_file.unmap(m_mapped);
+  }
+}
+
+inline int KMappedFileReaderPrivate::next()
+{
+  if (m_pos == m_end)
+  {
+    return KMappedFileReader::EndOfFile;
+  }
+  return *m_pos++;
+}
+
+/*******************************************************************************
+ * KMappedFileReader
+ ******************************************************************************/
+
+
+KMappedFileReader::KMappedFileReader() :
+  m_private(new KMappedFileReaderPrivate())
+{
+  // Intentionally Empty
+}
+
+KMappedFileReader::KMappedFileReader(const QString &fileName) :
+  m_private(new KMappedFileReaderPrivate(fileName))
+{
+  // Intentionally Empty
+}
+
+KMappedFileReader::~KMappedFileReader()
+{
+  // Intentionally Empty
+}
+
+int KMappedFileReader::next()
+{
+  P(KMappedFileReaderPrivate);
+  return p.next();
+}
+
+bool KMappedFileReader::valid()
+{
+  P(KMappedFileReaderPrivate);
+  return (p.m_begin != Q_NULLPTR);
+}
+
+char const *KMappedFileReader::data() const
+{
+  P(const KMappedFileReaderPrivate);
+  return p.m_begin;
+}
+
+size_t KMappedFileReader::size() const
+{
+  P(const KMappedFileReaderPrivate);
+  return static_cast<size_t>(p.m_end - p.m_begin);
+}
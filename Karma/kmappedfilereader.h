@@ -0,0 +1,25 @@
+#ifndef KMAPPEDFILEREADER_H
+#define KMAPPEDFILEREADER_H KMappedFileReader
+
+#include <KAbstractReader>
+#include <QScopedPointer>
+class QString;
+
+class KMappedFileReaderPrivate;
+class KMappedFileReader : public KAbstractReader
+{
+public:
+  KMappedFileReader();
+  KMappedFileReader(const QString &fileName);
+  ~KMappedFileReader();
+  int next();
+  bool valid();
+
+  // Contiguous access
+  char const *data() const;
+  size_t size() const;
+private:
+  QScopedPointer<KMappedFileReaderPrivate> m_private;
+};
+
+#endif // KMAPPEDFILEREADER_H
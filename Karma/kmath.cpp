@@ -1,4 +1,6 @@
 #include "kmath.h"
+#include <algorithm>
+#include <cmath>
 #include <QMainWindow>
 #include <QWidget>
 #include <QApplication>
@@ -12,7 +14,7 @@ const float Karma::Sqrt2Pi  = 2.506628274631000502415765284811045253006986740609
 
 void Karma::symSchur2(const KMatrix3x3 &symMtx, int p, int q, float *cosine, float *sine)
 {
-  if (std::abs(symMtx[p][q] > 0.0001f))
+  if (std::abs(symMtx[p][q]) > 0.0001f)
   {
     float r = (symMtx[q][q] - symMtx[p][p]) / (2.0f * symMtx[p][q]);
     float t;
@@ -67,9 +69,11 @@ KMatrix3x3 Karma::jacobi(KMatrix3x3 covar, int iterations)
     jacobiMtx[p][p] = jacobiMtx[q][q] = c;
     jacobiMtx[p][q] = s; jacobiMtx[q][p] = -s;
 
-    // Cumulate rotations
-    eigen *= jacobiMtx;
-    covar = (jacobiMtx.transposed() * covar) * jacobiMtx;
+    // Cumulate rotations (eigen = eigen * J, covar = J^T * covar * J); QMatrix3x3
+    // stores columns where KMatrix3x3 indexes rows, so Qt's products see the
+    // transposed matrices and the operands are swapped.
+    eigen = jacobiMtx * eigen;
+    covar = (jacobiMtx * covar) * jacobiMtx.transposed();
     float off = 0.0f;
     for (int i = 0; i < 3; ++i)
     {
@@ -91,6 +95,245 @@ KMatrix3x3 Karma::jacobi(KMatrix3x3 covar, int iterations)
 
 
 
+/*******************************************************************************
+ * Symmetric Eigen Decomposition
+ ******************************************************************************/
+// Closed-form solution for symmetric 3x3 matrices (D. Eberly, "A Robust
+// Eigensolver for 3x3 Symmetric Matrices"). The eigenvalues are the roots of
+// the characteristic cubic, found trigonometrically. The eigenvector of the
+// best separated eigenvalue is the largest cross product of two rows of
+// (A - eI); the second is solved within its orthogonal complement, and the
+// third is their cross product. Computed in double precision.
+namespace
+{
+  struct Vector3d
+  {
+    double x, y, z;
+  };
+
+  inline Vector3d cross(Vector3d const &a, Vector3d const &b)
+  {
+    Vector3d r = { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+    return r;
+  }
+
+  inline double dot(Vector3d const &a, Vector3d const &b)
+  {
+    return a.x * b.x + a.y * b.y + a.z * b.z;
+  }
+
+  inline Vector3d scaled(Vector3d const &a, double k)
+  {
+    Vector3d r = { a.x * k, a.y * k, a.z * k };
+    return r;
+  }
+
+  // Upper triangle: a00, a01, a02, a11, a12, a22
+  inline Vector3d multiply(double const a[6], Vector3d const &v)
+  {
+    Vector3d r =
+    {
+      a[0] * v.x + a[1] * v.y + a[2] * v.z,
+      a[1] * v.x + a[3] * v.y + a[4] * v.z,
+      a[2] * v.x + a[4] * v.y + a[5] * v.z
+    };
+    return r;
+  }
+
+  void orthogonalComplement(Vector3d const &w, Vector3d &u, Vector3d &v)
+  {
+    if (std::abs(w.x) > std::abs(w.y))
+    {
+      double invLength = 1.0 / std::sqrt(w.x * w.x + w.z * w.z);
+      Vector3d r = { -w.z * invLength, 0.0, w.x * invLength };
+      u = r;
+    }
+    else
+    {
+      double invLength = 1.0 / std::sqrt(w.y * w.y + w.z * w.z);
+      Vector3d r = { 0.0, w.z * invLength, -w.y * invLength };
+      u = r;
+    }
+    v = cross(w, u);
+  }
+
+  Vector3d eigenVector0(double const a[6], double eigenValue)
+  {
+    Vector3d row0 = { a[0] - eigenValue, a[1], a[2] };
+    Vector3d row1 = { a[1], a[3] - eigenValue, a[4] };
+    Vector3d row2 = { a[2], a[4], a[5] - eigenValue };
+    Vector3d r0xr1 = cross(row0, row1);
+    Vector3d r0xr2 = cross(row0, row2);
+    Vector3d r1xr2 = cross(row1, row2);
+    double d0 = dot(r0xr1, r0xr1);
+    double d1 = dot(r0xr2, r0xr2);
+    double d2 = dot(r1xr2, r1xr2);
+
+    // All rows parallel only for a triple eigenvalue; any vector will do
+    double dmax = std::max(d0, std::max(d1, d2));
+    if (dmax <= 0.0)
+    {
+      Vector3d r = { 1.0, 0.0, 0.0 };
+      return r;
+    }
+    if (dmax == d0) return scaled(r0xr1, 1.0 / std::sqrt(d0));
+    if (dmax == d1) return scaled(r0xr2, 1.0 / std::sqrt(d1));
+    return scaled(r1xr2, 1.0 / std::sqrt(d2));
+  }
+
+  Vector3d eigenVector1(double const a[6], Vector3d const &vector0, double eigenValue)
+  {
+    Vector3d u, v;
+    orthogonalComplement(vector0, u, v);
+    Vector3d au = multiply(a, u);
+    Vector3d av = multiply(a, v);
+    double m00 = dot(u, au) - eigenValue;
+    double m01 = dot(u, av);
+    double m11 = dot(v, av) - eigenValue;
+    double absM00 = std::abs(m00), absM01 = std::abs(m01), absM11 = std::abs(m11);
+
+    // Null vector of the 2x2 system in the (u, v) plane
+    if (absM00 >= absM11)
+    {
+      if (std::max(absM00, absM01) <= 0.0) return u;
+      if (absM00 >= absM01)
+      {
+        m01 /= m00;
+        m00 = 1.0 / std::sqrt(1.0 + m01 * m01);
+        m01 *= m00;
+      }
+      else
+      {
+        m00 /= m01;
+        m01 = 1.0 / std::sqrt(1.0 + m00 * m00);
+        m00 *= m01;
+      }
+      Vector3d r = { m01 * u.x - m00 * v.x, m01 * u.y - m00 * v.y, m01 * u.z - m00 * v.z };
+      return r;
+    }
+    else
+    {
+      if (std::max(absM11, absM01) <= 0.0) return u;
+      if (absM11 >= absM01)
+      {
+        m01 /= m11;
+        m11 = 1.0 / std::sqrt(1.0 + m01 * m01);
+        m01 *= m11;
+      }
+      else
+      {
+        m11 /= m01;
+        m01 = 1.0 / std::sqrt(1.0 + m11 * m11);
+        m11 *= m01;
+      }
+      Vector3d r = { m11 * u.x - m01 * v.x, m11 * u.y - m01 * v.y, m11 * u.z - m01 * v.z };
+      return r;
+    }
+  }
+}
+
+// Eigenvectors are the columns of the result, ordered by decreasing
+// eigenvalue and forming a rotation (Right-handed).
+KMatrix3x3 Karma::symmetricEigen(const KMatrix3x3 &symMtx, KVector3D *eigenValues)
+{
+  double a[6] = { symMtx[0][0], symMtx[0][1], symMtx[0][2], symMtx[1][1], symMtx[1][2], symMtx[2][2] };
+  double values[3];
+  Vector3d vectors[3];
+
+  // Scale to avoid overflow and underflow in the cubic
+  double maxAbs = 0.0;
+  for (double value : a)
+  {
+    maxAbs = std::max(maxAbs, std::abs(value));
+  }
+  double offDiagonal = a[1] * a[1] + a[2] * a[2] + a[4] * a[4];
+  if (maxAbs == 0.0 || offDiagonal == 0.0)
+  {
+    Vector3d identity[3] = { { 1.0, 0.0, 0.0 }, { 0.0, 1.0, 0.0 }, { 0.0, 0.0, 1.0 } };
+    values[0] = a[0];
+    values[1] = a[3];
+    values[2] = a[5];
+    std::copy(identity, identity + 3, vectors);
+  }
+  else
+  {
+    double invMaxAbs = 1.0 / maxAbs;
+    for (double &value : a)
+    {
+      value *= invMaxAbs;
+    }
+    offDiagonal *= invMaxAbs * invMaxAbs;
+
+    // Eigenvalues of B = (A - qI) / p are 2cos(angle + 2pi k / 3)
+    double q = (a[0] + a[3] + a[5]) / 3.0;
+    double b00 = a[0] - q, b11 = a[3] - q, b22 = a[5] - q;
+    double p = std::sqrt((b00 * b00 + b11 * b11 + b22 * b22 + 2.0 * offDiagonal) / 6.0);
+    double c00 = b11 * b22 - a[4] * a[4];
+    double c01 = a[1] * b22 - a[4] * a[2];
+    double c02 = a[1] * a[4] - b11 * a[2];
+    double det = (b00 * c00 - a[1] * c01 + a[2] * c02) / (p * p * p);
+    double halfDet = std::min(std::max(0.5 * det, -1.0), 1.0);
+    double angle = std::acos(halfDet) / 3.0;
+    static const double twoThirdsPi = 2.09439510239319549;
+    double beta2 = 2.0 * std::cos(angle);
+    double beta0 = 2.0 * std::cos(angle + twoThirdsPi);
+    double beta1 = -(beta0 + beta2);
+    double low = q + p * beta0, middle = q + p * beta1, high = q + p * beta2;
+
+    // Start from whichever extreme eigenvalue is further from the middle one
+    if (halfDet >= 0.0)
+    {
+      vectors[0] = eigenVector0(a, high);
+      vectors[1] = eigenVector1(a, vectors[0], middle);
+      vectors[2] = cross(vectors[0], vectors[1]);
+    }
+    else
+    {
+      vectors[2] = eigenVector0(a, low);
+      vectors[1] = eigenVector1(a, vectors[2], middle);
+      vectors[0] = cross(vectors[1], vectors[2]);
+    }
+    values[0] = high * maxAbs;
+    values[1] = middle * maxAbs;
+    values[2] = low * maxAbs;
+  }
+
+  // Order by decreasing eigenvalue (Only the diagonal case is unordered)
+  int order[3] = { 0, 1, 2 };
+  std::sort(order, order + 3, [&values](int i, int j) { return values[i] > values[j]; });
+  Vector3d sorted[3] = { vectors[order[0]], vectors[order[1]], vectors[order[2]] };
+  if (dot(cross(sorted[0], sorted[1]), sorted[2]) < 0.0)
+  {
+    sorted[2] = scaled(sorted[2], -1.0);
+  }
+
+  if (eigenValues)
+  {
+    *eigenValues = KVector3D(float(values[order[0]]), float(values[order[1]]), float(values[order[2]]));
+  }
+  KMatrix3x3 eigenVectors;
+  Karma::reconstructMatrixByColumnVectors(
+    &eigenVectors,
+    KVector3D(float(sorted[0].x), float(sorted[0].y), float(sorted[0].z)),
+    KVector3D(float(sorted[1].x), float(sorted[1].y), float(sorted[1].z)),
+    KVector3D(float(sorted[2].x), float(sorted[2].y), float(sorted[2].z))
+  );
+  return eigenVectors;
+}
+
+// Batches are solved in parallel chunks; eigenValues may be null.
+void Karma::symmetricEigen(KMatrix3x3 const *symMtx, size_t count, KMatrix3x3 *eigenVectors, KVector3D *eigenValues)
+{
+  static const size_t sg_eigenGrain = 4096;
+  Karma::parallelFor(count, sg_eigenGrain, [=](size_t first, size_t last)
+  {
+    for (size_t i = first; i < last; ++i)
+    {
+      eigenVectors[i] = symmetricEigen(symMtx[i], eigenValues ? &eigenValues[i] : 0);
+    }
+  });
+}
+
 void Karma::decomposeMatrixeByColumnVectors(const KMatrix3x3 &eigenVecs, KVector3D axes[])
 {
   axes[0] = KVector3D(eigenVecs[0][0], eigenVecs[1][0], eigenVecs[2][0]);
@@ -138,6 +381,25 @@ void Karma::reconstructMatrixByColumnVectors(KMatrix3x3 *mtx, const KVector3D &a
   (*mtx)[0][2] = c.x(); (*mtx)[1][2] = c.y(); (*mtx)[2][2] = c.z();
 }
 
+// The box along the column axes which bounds the extremal points found along
+// them (See findExtremalPointsAlongAxes()); extents are half the projected
+// widths. Every PCA box and ellipsoid is measured here.
+void Karma::orientedBounds(KMatrix3x3 const &axes, MinMaxKVector3DContainer const &extremal, KVector3D *centroid, KVector3D *extents)
+{
+  KVector3D columns[3];
+  decomposeMatrixeByColumnVectors(axes, columns);
+  float halfWidths[3];
+  *centroid = KVector3D(0.0f, 0.0f, 0.0f);
+  for (int k = 0; k < 3; ++k)
+  {
+    float minProj = KVector3D::dotProduct(extremal[k].min, columns[k]);
+    float maxProj = KVector3D::dotProduct(extremal[k].max, columns[k]);
+    halfWidths[k] = (maxProj - minProj) / 2.0f;
+    *centroid += columns[k] * ((maxProj + minProj) / 2.0f);
+  }
+  *extents = KVector3D(halfWidths[0], halfWidths[1], halfWidths[2]);
+}
+
 
 KColor Karma::colorShift(const KColor &orig, float amt)
 {
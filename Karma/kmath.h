@@ -7,7 +7,11 @@
 #include <KPointCloud>
 #include <KPlane>
 #include <limits>
+#include <iterator>
+#include <vector>
 #include <KColor>
+#include <KFloat4>
+#include <KParallel>
 #include <QMatrix4x4>
 #include <QVector2D>
 #include <QVector3D>
@@ -154,6 +158,8 @@ namespace Karma
   KMatrix3x3 covarianceMatrix(It begin, It end, Accessor accessor = DefaultAccessor<KVector3D>());
   void symSchur2(KMatrix3x3 const &symMtx, int p, int q, float *cosine, float *sine);
   KMatrix3x3 jacobi(KMatrix3x3 covar, int iterations);
+  KMatrix3x3 symmetricEigen(KMatrix3x3 const &symMtx, KVector3D *eigenValues = 0);
+  void symmetricEigen(KMatrix3x3 const *symMtx, size_t count, KMatrix3x3 *eigenVectors, KVector3D *eigenValues = 0);
 
   // Covariance Axes information
   template <typename It, typename Accessor = DefaultAccessor<KVector3D>>
@@ -172,6 +178,41 @@ namespace Karma
   KVector3D findAverageCentroid(It begin, It end, Accessor accessor = DefaultAccessor<KVector3D>());
   template <typename It, typename Accessor = DefaultAccessor<KVector3D>>
   MinMaxKVector3D findMinMaxBounds(It begin, It end, Accessor accessor = DefaultAccessor<KVector3D>());
+  void orientedBounds(KMatrix3x3 const &axes, MinMaxKVector3DContainer const &extremal, KVector3D *centroid, KVector3D *extents);
+
+  // Parallel Reductions
+  // The templates above split random-access ranges of at least
+  // ParallelReductionThreshold elements into fixed chunks, reduce the chunks
+  // across threads with KFloat4 inner loops and combine them in order, so the
+  // result does not depend on the thread count. Other ranges run serially.
+  const size_t ParallelReductionThreshold = size_t(1) << 15;
+  const size_t ParallelReductionGrain = size_t(1) << 14;
+  template <typename It>
+  auto reductionCategory(It const &it, int) -> decltype((void)it[0], (void)(it - it), std::random_access_iterator_tag());
+  template <typename It>
+  std::input_iterator_tag reductionCategory(It const &it, long);
+  template <typename It, typename Accessor, typename Mutator>
+  MinMaxKVector3DContainer parallelExtremalAlongAxes(It begin, It end, std::vector<KVector3D> const &axes, Accessor accessor, Mutator mutator);
+  template <typename It, typename Accessor>
+  KMatrix3x3 covarianceMatrix(It begin, It end, Accessor accessor, std::input_iterator_tag);
+  template <typename It, typename Accessor>
+  KMatrix3x3 covarianceMatrix(It begin, It end, Accessor accessor, std::random_access_iterator_tag);
+  template <typename It, typename Accessor, typename Mutator>
+  MinMaxKVector3D findExtremalAlongAxis(It begin, It end, KVector3D axis, Accessor accessor, Mutator mutator, std::input_iterator_tag);
+  template <typename It, typename Accessor, typename Mutator>
+  MinMaxKVector3D findExtremalAlongAxis(It begin, It end, KVector3D axis, Accessor accessor, Mutator mutator, std::random_access_iterator_tag);
+  template <typename It1, typename It2, typename VecAccessor, typename AxisAccessor, typename Mutator>
+  MinMaxKVector3DContainer findExtremalAlongAxes(It1 bVec, It1 eVec, It2 bAxis, It2 eAxis, VecAccessor vAccessor, AxisAccessor aAccessor, Mutator mutator, std::input_iterator_tag);
+  template <typename It1, typename It2, typename VecAccessor, typename AxisAccessor, typename Mutator>
+  MinMaxKVector3DContainer findExtremalAlongAxes(It1 bVec, It1 eVec, It2 bAxis, It2 eAxis, VecAccessor vAccessor, AxisAccessor aAccessor, Mutator mutator, std::random_access_iterator_tag);
+  template <typename It, typename Accessor>
+  KVector3D findAverageCentroid(It begin, It end, Accessor accessor, std::input_iterator_tag);
+  template <typename It, typename Accessor>
+  KVector3D findAverageCentroid(It begin, It end, Accessor accessor, std::random_access_iterator_tag);
+  template <typename It, typename Accessor>
+  MinMaxKVector3D findMinMaxBounds(It begin, It end, Accessor accessor, std::input_iterator_tag);
+  template <typename It, typename Accessor>
+  MinMaxKVector3D findMinMaxBounds(It begin, It end, Accessor accessor, std::random_access_iterator_tag);
 
   // Color Manipulaton
   KColor colorShift(KColor const &orig, float amt);
@@ -217,6 +258,22 @@ Karma::MinMaxKVector3D Karma::findExtremalProjectedPointsAlongAxis(It begin, It
 
 template <typename It, typename Accessor, typename Mutator>
 Karma::MinMaxKVector3D Karma::findExtremalAlongAxis(It begin, It end, KVector3D axis, Accessor accessor, Mutator mutator)
+{
+  return findExtremalAlongAxis(begin, end, axis, accessor, mutator, reductionCategory(begin, 0));
+}
+
+template <typename It, typename Accessor, typename Mutator>
+Karma::MinMaxKVector3D Karma::findExtremalAlongAxis(It begin, It end, KVector3D axis, Accessor accessor, Mutator mutator, std::random_access_iterator_tag)
+{
+  if (size_t(end - begin) < ParallelReductionThreshold)
+  {
+    return findExtremalAlongAxis(begin, end, axis, accessor, mutator, std::input_iterator_tag());
+  }
+  return parallelExtremalAlongAxes(begin, end, std::vector<KVector3D>(1, axis), accessor, mutator)[0];
+}
+
+template <typename It, typename Accessor, typename Mutator>
+Karma::MinMaxKVector3D Karma::findExtremalAlongAxis(It begin, It end, KVector3D axis, Accessor accessor, Mutator mutator, std::input_iterator_tag)
 {
   typedef std::numeric_limits<float> FloatLimits;
 
@@ -260,6 +317,29 @@ Karma::MinMaxKVector3DContainer Karma::findExtremalProjectedPointsAlongAxes(It1
 
 template <typename It1, typename It2, typename VecAccessor, typename AxisAccessor, typename Mutator>
 Karma::MinMaxKVector3DContainer Karma::findExtremalAlongAxes(It1 bVec, It1 eVec, It2 bAxis, It2 eAxis, VecAccessor vAccessor, AxisAccessor aAccessor, Mutator mutator)
+{
+  return findExtremalAlongAxes(bVec, eVec, bAxis, eAxis, vAccessor, aAccessor, mutator, reductionCategory(bVec, 0));
+}
+
+// Every axis is tested in the same sweep over the points.
+template <typename It1, typename It2, typename VecAccessor, typename AxisAccessor, typename Mutator>
+Karma::MinMaxKVector3DContainer Karma::findExtremalAlongAxes(It1 bVec, It1 eVec, It2 bAxis, It2 eAxis, VecAccessor vAccessor, AxisAccessor aAccessor, Mutator mutator, std::random_access_iterator_tag)
+{
+  if (size_t(eVec - bVec) < ParallelReductionThreshold)
+  {
+    return findExtremalAlongAxes(bVec, eVec, bAxis, eAxis, vAccessor, aAccessor, mutator, std::input_iterator_tag());
+  }
+  std::vector<KVector3D> axes;
+  while (bAxis != eAxis)
+  {
+    axes.push_back(aAccessor(*bAxis));
+    ++bAxis;
+  }
+  return parallelExtremalAlongAxes(bVec, eVec, axes, vAccessor, mutator);
+}
+
+template <typename It1, typename It2, typename VecAccessor, typename AxisAccessor, typename Mutator>
+Karma::MinMaxKVector3DContainer Karma::findExtremalAlongAxes(It1 bVec, It1 eVec, It2 bAxis, It2 eAxis, VecAccessor vAccessor, AxisAccessor aAccessor, Mutator mutator, std::input_iterator_tag)
 {
   MinMaxKVector3DContainer results;
   while (bAxis != eAxis)
@@ -272,6 +352,43 @@ Karma::MinMaxKVector3DContainer Karma::findExtremalAlongAxes(It1 bVec, It1 eVec,
 
 template <typename It, typename Accessor>
 KVector3D Karma::findAverageCentroid(It begin, It end, Accessor accessor)
+{
+  return findAverageCentroid(begin, end, accessor, reductionCategory(begin, 0));
+}
+
+template <typename It, typename Accessor>
+KVector3D Karma::findAverageCentroid(It begin, It end, Accessor accessor, std::random_access_iterator_tag)
+{
+  size_t count = end - begin;
+  if (count < ParallelReductionThreshold)
+  {
+    return findAverageCentroid(begin, end, accessor, std::input_iterator_tag());
+  }
+
+  std::vector<KFloat4> sums((count + ParallelReductionGrain - 1) / ParallelReductionGrain);
+  parallelFor(count, ParallelReductionGrain, [&](size_t first, size_t last)
+  {
+    KFloat4 sum(0.0f);
+    for (size_t i = first; i < last; ++i)
+    {
+      KVector3D const &v = accessor(begin[i]);
+      sum = sum + KFloat4(v.x(), v.y(), v.z(), 0.0f);
+    }
+    sums[first / ParallelReductionGrain] = sum;
+  });
+
+  KFloat4 total(0.0f);
+  for (KFloat4 const &sum : sums)
+  {
+    total = total + sum;
+  }
+  float values[4];
+  total.store(values);
+  return KVector3D(values[0], values[1], values[2]) / float(count);
+}
+
+template <typename It, typename Accessor>
+KVector3D Karma::findAverageCentroid(It begin, It end, Accessor accessor, std::input_iterator_tag)
 {
   size_t count = std::distance(begin, end);
   KVector3D centroid;
@@ -285,6 +402,54 @@ KVector3D Karma::findAverageCentroid(It begin, It end, Accessor accessor)
 
 template <typename It, typename Accessor>
 Karma::MinMaxKVector3D Karma::findMinMaxBounds(It begin, It end, Accessor accessor)
+{
+  return findMinMaxBounds(begin, end, accessor, reductionCategory(begin, 0));
+}
+
+template <typename It, typename Accessor>
+Karma::MinMaxKVector3D Karma::findMinMaxBounds(It begin, It end, Accessor accessor, std::random_access_iterator_tag)
+{
+  size_t count = end - begin;
+  if (count < ParallelReductionThreshold)
+  {
+    return findMinMaxBounds(begin, end, accessor, std::input_iterator_tag());
+  }
+
+  // Note: The new point is the first operand, so NaN coordinates are skipped
+  size_t chunks = (count + ParallelReductionGrain - 1) / ParallelReductionGrain;
+  std::vector<KFloat4> minimums(chunks), maximums(chunks);
+  parallelFor(count, ParallelReductionGrain, [&](size_t first, size_t last)
+  {
+    KFloat4 minimum( std::numeric_limits<float>::infinity());
+    KFloat4 maximum(-std::numeric_limits<float>::infinity());
+    for (size_t i = first; i < last; ++i)
+    {
+      KVector3D const &v = accessor(begin[i]);
+      KFloat4 point(v.x(), v.y(), v.z(), 0.0f);
+      minimum = min(point, minimum);
+      maximum = max(point, maximum);
+    }
+    minimums[first / ParallelReductionGrain] = minimum;
+    maximums[first / ParallelReductionGrain] = maximum;
+  });
+
+  KFloat4 minimum = minimums[0], maximum = maximums[0];
+  for (size_t chunk = 1; chunk < chunks; ++chunk)
+  {
+    minimum = min(minimums[chunk], minimum);
+    maximum = max(maximums[chunk], maximum);
+  }
+  float low[4], high[4];
+  minimum.store(low);
+  maximum.store(high);
+  MinMaxKVector3D m;
+  m.min = KVector3D(low[0], low[1], low[2]);
+  m.max = KVector3D(high[0], high[1], high[2]);
+  return m;
+}
+
+template <typename It, typename Accessor>
+Karma::MinMaxKVector3D Karma::findMinMaxBounds(It begin, It end, Accessor accessor, std::input_iterator_tag)
 {
   KVector3D vector;
   MinMaxKVector3D m;
@@ -306,6 +471,59 @@ Karma::MinMaxKVector3D Karma::findMinMaxBounds(It begin, It end, Accessor access
 
 template <typename It, typename Accessor>
 KMatrix3x3 Karma::covarianceMatrix(It begin, It end, Accessor accessor)
+{
+  return covarianceMatrix(begin, end, accessor, reductionCategory(begin, 0));
+}
+
+template <typename It, typename Accessor>
+KMatrix3x3 Karma::covarianceMatrix(It begin, It end, Accessor accessor, std::random_access_iterator_tag)
+{
+  size_t count = end - begin;
+  if (count < ParallelReductionThreshold)
+  {
+    return covarianceMatrix(begin, end, accessor, std::input_iterator_tag());
+  }
+
+  // Lanes: (e00, e11, e22) and (e01, e02, e12) about the centroid
+  KVector3D center = findAverageCentroid(begin, end, accessor, std::random_access_iterator_tag());
+  size_t chunks = (count + ParallelReductionGrain - 1) / ParallelReductionGrain;
+  std::vector<KFloat4> diagonals(chunks), offDiagonals(chunks);
+  parallelFor(count, ParallelReductionGrain, [&](size_t first, size_t last)
+  {
+    KFloat4 diagonal(0.0f), offDiagonal(0.0f);
+    for (size_t i = first; i < last; ++i)
+    {
+      KVector3D c = accessor(begin[i]) - center;
+      KFloat4 centered(c.x(), c.y(), c.z(), 0.0f);
+      diagonal = diagonal + centered * centered;
+      offDiagonal = offDiagonal + KFloat4(c.x(), c.x(), c.y(), 0.0f) * KFloat4(c.y(), c.z(), c.z(), 0.0f);
+    }
+    diagonals[first / ParallelReductionGrain] = diagonal;
+    offDiagonals[first / ParallelReductionGrain] = offDiagonal;
+  });
+
+  KFloat4 diagonal(0.0f), offDiagonal(0.0f);
+  for (size_t chunk = 0; chunk < chunks; ++chunk)
+  {
+    diagonal = diagonal + diagonals[chunk];
+    offDiagonal = offDiagonal + offDiagonals[chunk];
+  }
+  float e[4], o[4];
+  (diagonal * KFloat4(1.0f / float(count))).store(e);
+  (offDiagonal * KFloat4(1.0f / float(count))).store(o);
+
+  KMatrix3x3 covariance;
+  covariance[0][0] = e[0];
+  covariance[1][1] = e[1];
+  covariance[2][2] = e[2];
+  covariance[0][1] = covariance[1][0] = o[0];
+  covariance[0][2] = covariance[2][0] = o[1];
+  covariance[1][2] = covariance[2][1] = o[2];
+  return covariance;
+}
+
+template <typename It, typename Accessor>
+KMatrix3x3 Karma::covarianceMatrix(It begin, It end, Accessor accessor, std::input_iterator_tag)
 {
   It origBegin = begin;
   int count = std::distance(begin, end);
@@ -349,6 +567,94 @@ KMatrix3x3 Karma::covarianceMatrix(It begin, It end, Accessor accessor)
   return covariance;
 }
 
+template <typename It>
+auto Karma::reductionCategory(It const &it, int) -> decltype((void)it[0], (void)(it - it), std::random_access_iterator_tag())
+{
+  (void)it;
+  return std::random_access_iterator_tag();
+}
+
+template <typename It>
+std::input_iterator_tag Karma::reductionCategory(It const &it, long)
+{
+  (void)it;
+  return std::input_iterator_tag();
+}
+
+// Projects every point onto four axes at a time; ties keep the earliest point.
+template <typename It, typename Accessor, typename Mutator>
+Karma::MinMaxKVector3DContainer Karma::parallelExtremalAlongAxes(It begin, It end, std::vector<KVector3D> const &axes, Accessor accessor, Mutator mutator)
+{
+  size_t count = end - begin;
+  size_t groups = (axes.size() + 3) / 4;
+  size_t lanes = groups * 4;
+  std::vector<KFloat4> axisX(groups), axisY(groups), axisZ(groups);
+  for (size_t g = 0; g < groups; ++g)
+  {
+    float x[4] = { 0.0f, 0.0f, 0.0f, 0.0f }, y[4] = { 0.0f, 0.0f, 0.0f, 0.0f }, z[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    for (size_t k = 0; k < 4 && g * 4 + k < axes.size(); ++k)
+    {
+      x[k] = axes[g * 4 + k].x();
+      y[k] = axes[g * 4 + k].y();
+      z[k] = axes[g * 4 + k].z();
+    }
+    axisX[g] = KFloat4::load(x);
+    axisY[g] = KFloat4::load(y);
+    axisZ[g] = KFloat4::load(z);
+  }
+
+  // Per chunk and lane: extremal projections and the points they came from
+  size_t chunks = (count + ParallelReductionGrain - 1) / ParallelReductionGrain;
+  std::vector<float> minDist(chunks * lanes), maxDist(chunks * lanes);
+  std::vector<size_t> minIndex(chunks * lanes), maxIndex(chunks * lanes);
+  parallelFor(count, ParallelReductionGrain, [&](size_t first, size_t last)
+  {
+    size_t offset = (first / ParallelReductionGrain) * lanes;
+    std::vector<KFloat4> minimum(groups, KFloat4( std::numeric_limits<float>::infinity()));
+    std::vector<KFloat4> maximum(groups, KFloat4(-std::numeric_limits<float>::infinity()));
+    for (size_t i = first; i < last; ++i)
+    {
+      KVector3D const &v = accessor(begin[i]);
+      KFloat4 x(v.x()), y(v.y()), z(v.z());
+      for (size_t g = 0; g < groups; ++g)
+      {
+        KFloat4 projection = axisX[g] * x + axisY[g] * y + axisZ[g] * z;
+        KFloat4 below = projection < minimum[g];
+        KFloat4 above = projection > maximum[g];
+        int changed = below.mask() | (above.mask() << 4);
+        if (!changed) continue;
+        for (size_t k = 0; k < 4; ++k)
+        {
+          if (changed & (1 << k)) minIndex[offset + g * 4 + k] = i;
+          if (changed & (1 << (k + 4))) maxIndex[offset + g * 4 + k] = i;
+        }
+        minimum[g] = KFloat4::select(below, projection, minimum[g]);
+        maximum[g] = KFloat4::select(above, projection, maximum[g]);
+      }
+    }
+    for (size_t g = 0; g < groups; ++g)
+    {
+      minimum[g].store(&minDist[offset + g * 4]);
+      maximum[g].store(&maxDist[offset + g * 4]);
+    }
+  });
+
+  MinMaxKVector3DContainer results(axes.size());
+  for (size_t k = 0; k < axes.size(); ++k)
+  {
+    size_t best[2] = { k, k };
+    for (size_t chunk = 1; chunk < chunks; ++chunk)
+    {
+      size_t lane = chunk * lanes + k;
+      if (minDist[lane] < minDist[best[0]]) best[0] = lane;
+      if (maxDist[lane] > maxDist[best[1]]) best[1] = lane;
+    }
+    results[k].min = mutator(accessor(begin[minIndex[best[0]]]), minDist[best[0]], axes[k]);
+    results[k].max = mutator(accessor(begin[maxIndex[best[1]]]), maxDist[best[1]], axes[k]);
+  }
+  return results;
+}
+
 template <typename It, typename Func>
 void Karma::maxSeperatedAlongAxis(It begin, It end, Func f, KVector3D axis, KVector3D *min, KVector3D *max)
 {
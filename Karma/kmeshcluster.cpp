@@ -0,0 +1,195 @@
+#include "kmeshcluster.h"
+
+#include <KHalfEdgeMesh>
+#include <KParallel>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+/*******************************************************************************
+ * Clustering Helpers
+ ******************************************************************************/
+
+static const uint32_t sg_invalidIndex = ~0u;
+
+// Flattened per-face data, so that growing clusters doesn't chase half-edges.
+struct FaceAdjacency
+{
+  FaceAdjacency(KHalfEdgeMesh const &mesh);
+  std::vector<uint32_t> m_corners;
+  std::vector<uint32_t> m_neighbours;
+  std::vector<KVector3D> m_normals;
+};
+
+FaceAdjacency::FaceAdjacency(KHalfEdgeMesh const &mesh) :
+  m_corners(3 * mesh.numFaces()), m_neighbours(3 * mesh.numFaces()), m_normals(mesh.numFaces())
+{
+  KHalfEdgeMesh::FaceContainer const &faces = mesh.faces();
+  KHalfEdgeMesh::VertexContainer const &vertices = mesh.vertices();
+  Karma::parallelFor(faces.size(), 4096, [&](size_t begin, size_t end)
+  {
+    for (size_t f = begin; f < end; ++f)
+    {
+      KHalfEdgeMesh::HalfEdge const *halfEdge = mesh.halfEdge(faces[f].first);
+      for (size_t k = 0; k < 3; ++k)
+      {
+        KHalfEdgeMesh::HalfEdge const *twin = mesh.twin(halfEdge);
+        m_corners[3 * f + k] = halfEdge->to - 1;
+        m_neighbours[3 * f + k] = (twin->face == 0) ? sg_invalidIndex : twin->face - 1;
+        halfEdge = mesh.halfEdge(halfEdge->next);
+      }
+      KVector3D const &a = vertices[m_corners[3 * f + 0]].position;
+      KVector3D const &b = vertices[m_corners[3 * f + 1]].position;
+      KVector3D const &c = vertices[m_corners[3 * f + 2]].position;
+      m_normals[f] = KVector3D::crossProduct(b - a, c - a).normalized();
+    }
+  });
+}
+
+static void calculateClusterBounds(KMeshCluster &cluster, FaceAdjacency const &adjacency, KHalfEdgeMesh::VertexContainer const &vertices, uint32_t const *faces)
+{
+  // Axis-aligned bounds
+  float const limit = std::numeric_limits<float>::max();
+  Karma::MinMaxKVector3D bounds(-limit, limit);
+  for (uint32_t i = 0; i < cluster.faceCount; ++i)
+  {
+    for (size_t k = 0; k < 3; ++k)
+    {
+      KVector3D const &p = vertices[adjacency.m_corners[3 * faces[i] + k]].position;
+      bounds.min = KVector3D(std::min(bounds.min.x(), p.x()), std::min(bounds.min.y(), p.y()), std::min(bounds.min.z(), p.z()));
+      bounds.max = KVector3D(std::max(bounds.max.x(), p.x()), std::max(bounds.max.y(), p.y()), std::max(bounds.max.z(), p.z()));
+    }
+  }
+  cluster.aabb.setMinMaxBounds(bounds);
+
+  // Sphere about the box center, and the average normal
+  cluster.center = (bounds.min + bounds.max) * 0.5f;
+  float radiusSquared = 0.0f;
+  KVector3D axis;
+  for (uint32_t i = 0; i < cluster.faceCount; ++i)
+  {
+    for (size_t k = 0; k < 3; ++k)
+    {
+      KVector3D const &p = vertices[adjacency.m_corners[3 * faces[i] + k]].position;
+      radiusSquared = std::max(radiusSquared, (p - cluster.center).lengthSquared());
+    }
+    axis += adjacency.m_normals[faces[i]];
+  }
+  cluster.radius = std::sqrt(radiusSquared);
+
+  // Normal cone; spreads near (or past) 90 degrees can never be culled
+  float minDot = 1.0f;
+  cluster.coneAxis = axis.normalized();
+  for (uint32_t i = 0; i < cluster.faceCount; ++i)
+  {
+    minDot = std::min(minDot, KVector3D::dotProduct(cluster.coneAxis, adjacency.m_normals[faces[i]]));
+  }
+  cluster.coneCutoff = (minDot <= 0.1f) ? 1.0f : std::sqrt(1.0f - minDot * minDot);
+}
+
+/*******************************************************************************
+ * Public Interface
+ ******************************************************************************/
+
+Karma::MeshClusterContainer Karma::buildMeshClusters(KHalfEdgeMesh const &mesh, std::vector<uint32_t> &faceOrder, size_t maxFaces)
+{
+  MeshClusterContainer clusters;
+  size_t faceCount = mesh.numFaces();
+  faceOrder.clear();
+  faceOrder.reserve(faceCount);
+  if (faceCount == 0) return clusters;
+  if (maxFaces == 0) maxFaces = faceCount;
+
+  FaceAdjacency adjacency(mesh);
+  std::vector<bool> assigned(faceCount, false);
+  std::vector<uint32_t> vertexCluster(mesh.numVertices(), sg_invalidIndex);
+  std::vector<uint32_t> frontier;
+  std::vector<uint32_t> leftovers;
+  size_t cursor = 0;
+
+  clusters.reserve(faceCount / maxFaces + 1);
+  for (;;)
+  {
+    // Seed next to the previous cluster when possible, to keep clusters spatially ordered
+    uint32_t seed = sg_invalidIndex;
+    for (uint32_t f : leftovers)
+    {
+      if (!assigned[f])
+      {
+        seed = f;
+        break;
+      }
+    }
+    while (seed == sg_invalidIndex && cursor < faceCount)
+    {
+      if (!assigned[cursor]) seed = static_cast<uint32_t>(cursor);
+      ++cursor;
+    }
+    if (seed == sg_invalidIndex) break;
+
+    uint32_t clusterIndex = static_cast<uint32_t>(clusters.size());
+    KMeshCluster cluster;
+    cluster.firstFace = static_cast<uint32_t>(faceOrder.size());
+    cluster.faceCount = 0;
+    KVector3D normalSum;
+    frontier.clear();
+
+    uint32_t face = seed;
+    while (face != sg_invalidIndex)
+    {
+      // Add the face to the cluster
+      assigned[face] = true;
+      faceOrder.push_back(face);
+      normalSum += adjacency.m_normals[face];
+      for (size_t k = 0; k < 3; ++k)
+      {
+        vertexCluster[adjacency.m_corners[3 * face + k]] = clusterIndex;
+        uint32_t neighbour = adjacency.m_neighbours[3 * face + k];
+        if (neighbour != sg_invalidIndex && !assigned[neighbour])
+        {
+          frontier.push_back(neighbour);
+        }
+      }
+      if (++cluster.faceCount >= maxFaces) break;
+
+      // Prefer the face sharing the most vertices, then the flattest continuation
+      face = sg_invalidIndex;
+      KVector3D axis = normalSum.normalized();
+      float bestScore = -std::numeric_limits<float>::max();
+      for (size_t i = 0; i < frontier.size();)
+      {
+        uint32_t candidate = frontier[i];
+        if (assigned[candidate])
+        {
+          frontier[i] = frontier.back();
+          frontier.pop_back();
+          continue;
+        }
+        int shared = 0;
+        for (size_t k = 0; k < 3; ++k)
+        {
+          shared += (vertexCluster[adjacency.m_corners[3 * candidate + k]] == clusterIndex);
+        }
+        float score = shared * 2.0f + KVector3D::dotProduct(axis, adjacency.m_normals[candidate]);
+        if (score > bestScore)
+        {
+          bestScore = score;
+          face = candidate;
+        }
+        ++i;
+      }
+    }
+
+    calculateClusterBounds(cluster, adjacency, mesh.vertices(), &faceOrder[cluster.firstFace]);
+    clusters.push_back(cluster);
+    leftovers.swap(frontier);
+  }
+
+  return clusters;
+}
+
+bool Karma::isClusterBackfacing(KMeshCluster const &cluster, KVector3D const &eye)
+{
+  KVector3D view = cluster.center - eye;
+  return KVector3D::dotProduct(view, cluster.coneAxis) >= cluster.coneCutoff * view.length() + cluster.radius;
+}
@@ -0,0 +1,40 @@
+#ifndef KMESHCLUSTER_H
+#define KMESHCLUSTER_H KMeshCluster
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <KVector3D>
+#include <KAabbBoundingVolume>
+class KHalfEdgeMesh;
+
+// A connected patch of faces which is culled as a unit.
+// The faces of a cluster are [firstFace, firstFace + faceCount) of the face
+// order produced by Karma::buildMeshClusters().
+struct KMeshCluster
+{
+  uint32_t firstFace;
+  uint32_t faceCount;
+  KAabbBoundingVolume aabb;
+  KVector3D center;
+  float radius;
+  KVector3D coneAxis;
+  float coneCutoff;   // sin(spread) of the face normals; >= 1 is never backfacing
+};
+
+namespace Karma
+{
+
+  typedef std::vector<KMeshCluster> MeshClusterContainer;
+
+  // Partitions the faces of the mesh into clusters of at most maxFaces faces
+  // by growing each cluster across half-edge twins. faceOrder receives the
+  // (0-based) face indices grouped by cluster.
+  MeshClusterContainer buildMeshClusters(KHalfEdgeMesh const &mesh, std::vector<uint32_t> &faceOrder, size_t maxFaces = 124);
+
+  // True if every face of the cluster faces away from eye (Object Space).
+  bool isClusterBackfacing(KMeshCluster const &cluster, KVector3D const &eye);
+
+}
+
+#endif // KMESHCLUSTER_H
@@ -0,0 +1,365 @@
+#include "kmeshsimplifier.h"
+
+#include <KMacros>
+#include <KHalfEdgeMesh>
+#include <KRadixSort>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+/*******************************************************************************
+ * Quadric
+ ******************************************************************************/
+
+// Symmetric 4x4 error quadric [A b; b' c], with the weight it was built from,
+// so that evaluate() returns a squared distance rather than an area.
+struct KQuadric
+{
+  KQuadric();
+  KQuadric(KVector3D const &normal, float dTerm, float weight);
+  void operator+=(KQuadric const &rhs);
+  double evaluate(KVector3D const &p) const;
+  double a00, a01, a02, a11, a12, a22;
+  double b0, b1, b2;
+  double c;
+  double w;
+};
+
+KQuadric::KQuadric()
+{
+  std::memset(this, 0, sizeof(KQuadric));
+}
+
+KQuadric::KQuadric(KVector3D const &normal, float dTerm, float weight)
+{
+  double x = normal.x(), y = normal.y(), z = normal.z(), d = dTerm;
+  a00 = weight * x * x; a01 = weight * x * y; a02 = weight * x * z;
+  a11 = weight * y * y; a12 = weight * y * z; a22 = weight * z * z;
+  b0  = weight * x * d; b1  = weight * y * d; b2  = weight * z * d;
+  c   = weight * d * d;
+  w   = weight;
+}
+
+void KQuadric::operator+=(KQuadric const &rhs)
+{
+  a00 += rhs.a00; a01 += rhs.a01; a02 += rhs.a02;
+  a11 += rhs.a11; a12 += rhs.a12; a22 += rhs.a22;
+  b0  += rhs.b0;  b1  += rhs.b1;  b2  += rhs.b2;
+  c   += rhs.c;
+  w   += rhs.w;
+}
+
+double KQuadric::evaluate(KVector3D const &p) const
+{
+  double x = p.x(), y = p.y(), z = p.z();
+  double r =
+      a00 * x * x + a11 * y * y + a22 * z * z
+    + 2.0 * (a01 * x * y + a02 * x * z + a12 * y * z)
+    + 2.0 * (b0 * x + b1 * y + b2 * z)
+    + c;
+  return (w > 0.0) ? std::fabs(r) / w : 0.0;
+}
+
+/*******************************************************************************
+ * Simplifier Private
+ ******************************************************************************/
+
+static const uint32_t sg_invalidIndex = ~0u;
+static const float sg_boundaryWeight = 10.0f;
+
+struct KEdgeCollapse
+{
+  uint32_t from;
+  uint32_t to;
+  float cost;
+};
+
+class KMeshSimplifierPrivate
+{
+public:
+  KMeshSimplifierPrivate(KHalfEdgeMesh const &mesh);
+  void buildAdjacency();
+  size_t sharedFaces(uint32_t a, uint32_t b) const;
+  bool canCollapse(uint32_t from, uint32_t to, bool boundaryEdge) const;
+  bool flipsFace(uint32_t from, uint32_t to) const;
+  bool collapsePass(size_t targetFaces, double maxCost);
+
+  std::vector<KVector3D> m_positions;
+  std::vector<KQuadric> m_quadrics;
+  std::vector<bool> m_boundary;
+  std::vector<uint32_t> m_indices;
+  std::vector<uint32_t> m_offsets;
+  std::vector<uint32_t> m_faces;
+  double m_cost;
+};
+
+KMeshSimplifierPrivate::KMeshSimplifierPrivate(KHalfEdgeMesh const &mesh) :
+  m_quadrics(mesh.numVertices()), m_boundary(mesh.numVertices(), false), m_cost(0.0)
+{
+  KHalfEdgeMesh::VertexContainer const &vertices = mesh.vertices();
+  KHalfEdgeMesh::FaceContainer const &faces = mesh.faces();
+  KHalfEdgeMesh::HalfEdgeContainer const &halfEdges = mesh.halfEdges();
+
+  m_positions.reserve(vertices.size());
+  for (KHalfEdgeMesh::Vertex const &v : vertices)
+  {
+    m_positions.push_back(v.position);
+  }
+
+  // Face quadrics, weighted by area
+  m_indices.resize(3 * faces.size());
+  for (size_t f = 0; f < faces.size(); ++f)
+  {
+    KHalfEdgeMesh::HalfEdge const *halfEdge = mesh.halfEdge(faces[f].first);
+    for (size_t k = 0; k < 3; ++k)
+    {
+      m_indices[3 * f + k] = halfEdge->to - 1;
+      halfEdge = mesh.halfEdge(halfEdge->next);
+    }
+    uint32_t const *tri = &m_indices[3 * f];
+    KVector3D const &a = m_positions[tri[0]];
+    KVector3D normal = KVector3D::crossProduct(m_positions[tri[1]] - a, m_positions[tri[2]] - a);
+    float area = normal.length();
+    if (area == 0.0f) continue;
+    normal /= area;
+    KQuadric q(normal, -KVector3D::dotProduct(normal, a), area * 0.5f);
+    for (size_t k = 0; k < 3; ++k)
+    {
+      m_quadrics[tri[k]] += q;
+    }
+  }
+
+  // Boundary edges are the face half-edges whose twin has no face
+  for (KHalfEdgeMesh::HalfEdge const &halfEdge : halfEdges)
+  {
+    if (halfEdge.face == 0) continue;
+    KHalfEdgeMesh::HalfEdge const *twin = mesh.twin(&halfEdge);
+    if (twin->face != 0) continue;
+    uint32_t from = twin->to - 1;
+    uint32_t to = halfEdge.to - 1;
+    m_boundary[from] = m_boundary[to] = true;
+
+    // Plane through the edge, perpendicular to its face
+    KVector3D edge = m_positions[to] - m_positions[from];
+    KVector3D normal = KVector3D::crossProduct(edge, mesh.face(halfEdge.face)->normal);
+    if (normal.lengthSquared() == 0.0f)
+    {
+      KHalfEdgeMesh::HalfEdge const *next = mesh.halfEdge(halfEdge.next);
+      KVector3D faceNormal = KVector3D::crossProduct(edge, m_positions[next->to - 1] - m_positions[to]);
+      normal = KVector3D::crossProduct(edge, faceNormal);
+    }
+    normal.normalize();
+    KQuadric q(normal, -KVector3D::dotProduct(normal, m_positions[from]), edge.lengthSquared() * sg_boundaryWeight);
+    m_quadrics[from] += q;
+    m_quadrics[to] += q;
+  }
+}
+
+void KMeshSimplifierPrivate::buildAdjacency()
+{
+  size_t vertexCount = m_positions.size();
+  m_offsets.assign(vertexCount + 1, 0);
+  m_faces.resize(m_indices.size());
+  for (uint32_t v : m_indices)
+  {
+    ++m_offsets[v + 1];
+  }
+  for (size_t v = 0; v < vertexCount; ++v)
+  {
+    m_offsets[v + 1] += m_offsets[v];
+  }
+  std::vector<uint32_t> fill(m_offsets.begin(), m_offsets.end() - 1);
+  for (size_t i = 0; i < m_indices.size(); ++i)
+  {
+    m_faces[fill[m_indices[i]]++] = static_cast<uint32_t>(i / 3);
+  }
+}
+
+size_t KMeshSimplifierPrivate::sharedFaces(uint32_t a, uint32_t b) const
+{
+  size_t count = 0;
+  for (uint32_t i = m_offsets[a]; i < m_offsets[a + 1]; ++i)
+  {
+    uint32_t const *tri = &m_indices[3 * m_faces[i]];
+    count += (tri[0] == b || tri[1] == b || tri[2] == b);
+  }
+  return count;
+}
+
+bool KMeshSimplifierPrivate::canCollapse(uint32_t from, uint32_t to, bool boundaryEdge) const
+{
+  // Boundary vertices may only move along the boundary
+  if (!m_boundary[from]) return true;
+  return m_boundary[to] && boundaryEdge;
+}
+
+bool KMeshSimplifierPrivate::flipsFace(uint32_t from, uint32_t to) const
+{
+  for (uint32_t i = m_offsets[from]; i < m_offsets[from + 1]; ++i)
+  {
+    uint32_t const *tri = &m_indices[3 * m_faces[i]];
+    if (tri[0] == to || tri[1] == to || tri[2] == to) continue;
+
+    KVector3D before[3], after[3];
+    for (size_t k = 0; k < 3; ++k)
+    {
+      before[k] = m_positions[tri[k]];
+      after[k] = m_positions[(tri[k] == from) ? to : tri[k]];
+    }
+    KVector3D n0 = KVector3D::crossProduct(before[1] - before[0], before[2] - before[0]);
+    KVector3D n1 = KVector3D::crossProduct(after[1] - after[0], after[2] - after[0]);
+    if (KVector3D::dotProduct(n0, n1) <= 0.0f) return true;
+  }
+  return false;
+}
+
+bool KMeshSimplifierPrivate::collapsePass(size_t targetFaces, double maxCost)
+{
+  size_t faceCount = m_indices.size() / 3;
+  buildAdjacency();
+
+  // Cheapest direction of every edge (interior edges are seen from both faces)
+  std::vector<KEdgeCollapse> collapses;
+  for (size_t i = 0; i < m_indices.size(); ++i)
+  {
+    uint32_t a = m_indices[i];
+    uint32_t b = m_indices[(i % 3 == 2) ? i - 2 : i + 1];
+    bool boundaryEdge = (sharedFaces(a, b) == 1);
+    if (a > b && !boundaryEdge) continue;
+
+    KQuadric q = m_quadrics[a];
+    q += m_quadrics[b];
+    KEdgeCollapse collapse;
+    collapse.from = sg_invalidIndex;
+    collapse.cost = std::numeric_limits<float>::max();
+    if (canCollapse(a, b, boundaryEdge))
+    {
+      collapse.from = a;
+      collapse.to = b;
+      collapse.cost = static_cast<float>(q.evaluate(m_positions[b]));
+    }
+    if (canCollapse(b, a, boundaryEdge))
+    {
+      float cost = static_cast<float>(q.evaluate(m_positions[a]));
+      if (cost < collapse.cost)
+      {
+        collapse.from = b;
+        collapse.to = a;
+        collapse.cost = cost;
+      }
+    }
+    if (collapse.from != sg_invalidIndex && collapse.cost <= maxCost)
+    {
+      collapses.push_back(collapse);
+    }
+  }
+  if (collapses.empty()) return false;
+
+  // Order by cost; non-negative floats sort correctly by their bit pattern
+  std::vector<uint32_t> keys(collapses.size());
+  std::vector<uint32_t> order(collapses.size());
+  for (size_t i = 0; i < collapses.size(); ++i)
+  {
+    std::memcpy(&keys[i], &collapses[i].cost, sizeof(float));
+    order[i] = static_cast<uint32_t>(i);
+  }
+  Karma::radixSort(keys, order);
+
+  // Each collapse removes about two faces; allow some slack over the cheapest needed
+  size_t needed = (faceCount - targetFaces) / 2;
+  double passCost = collapses[order[std::min(needed, order.size() - 1)]].cost * 1.5;
+
+  // Collapse independent edges, cheapest first
+  std::vector<bool> locked(m_positions.size(), false);
+  std::vector<uint32_t> remap(m_positions.size());
+  for (size_t v = 0; v < remap.size(); ++v)
+  {
+    remap[v] = static_cast<uint32_t>(v);
+  }
+  size_t removed = 0;
+  for (uint32_t idx : order)
+  {
+    KEdgeCollapse const &collapse = collapses[idx];
+    if (collapse.cost > passCost && removed > 0) break;
+    if (locked[collapse.from] || locked[collapse.to]) continue;
+    if (flipsFace(collapse.from, collapse.to)) continue;
+
+    remap[collapse.from] = collapse.to;
+    m_quadrics[collapse.to] += m_quadrics[collapse.from];
+    m_cost = std::max(m_cost, static_cast<double>(collapse.cost));
+    removed += sharedFaces(collapse.from, collapse.to);
+
+    // Faces around both ends change, so their vertices wait for the next pass
+    uint32_t ends[2] = { collapse.from, collapse.to };
+    for (uint32_t v : ends)
+    {
+      for (uint32_t i = m_offsets[v]; i < m_offsets[v + 1]; ++i)
+      {
+        uint32_t const *tri = &m_indices[3 * m_faces[i]];
+        locked[tri[0]] = locked[tri[1]] = locked[tri[2]] = true;
+      }
+    }
+    if (faceCount - removed <= targetFaces) break;
+  }
+  if (removed == 0) return false;
+
+  // Rewrite faces, dropping the ones which collapsed
+  size_t write = 0;
+  for (size_t i = 0; i < m_indices.size(); i += 3)
+  {
+    uint32_t a = remap[m_indices[i + 0]];
+    uint32_t b = remap[m_indices[i + 1]];
+    uint32_t c = remap[m_indices[i + 2]];
+    if (a == b || b == c || c == a) continue;
+    m_indices[write++] = a;
+    m_indices[write++] = b;
+    m_indices[write++] = c;
+  }
+  m_indices.resize(write);
+  return true;
+}
+
+/*******************************************************************************
+ * Simplifier
+ ******************************************************************************/
+
+KMeshSimplifier::KMeshSimplifier(KHalfEdgeMesh const &mesh) :
+  m_private(new KMeshSimplifierPrivate(mesh))
+{
+  // Intentionally Empty
+}
+
+KMeshSimplifier::~KMeshSimplifier()
+{
+  // Intentionally Empty
+}
+
+size_t KMeshSimplifier::simplify(size_t targetFaces, float maxError)
+{
+  P(KMeshSimplifierPrivate);
+  double maxCost = double(maxError) * double(maxError);
+  while (numFaces() > targetFaces && p.collapsePass(targetFaces, maxCost))
+  {
+    // Intentionally Empty
+  }
+  return numFaces();
+}
+
+std::vector<uint32_t> const &KMeshSimplifier::indices() const
+{
+  P(const KMeshSimplifierPrivate);
+  return p.m_indices;
+}
+
+size_t KMeshSimplifier::numFaces() const
+{
+  P(const KMeshSimplifierPrivate);
+  return p.m_indices.size() / 3;
+}
+
+float KMeshSimplifier::error() const
+{
+  P(const KMeshSimplifierPrivate);
+  return static_cast<float>(std::sqrt(p.m_cost));
+}
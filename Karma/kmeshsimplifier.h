@@ -0,0 +1,38 @@
+#ifndef KMESHSIMPLIFIER_H
+#define KMESHSIMPLIFIER_H KMeshSimplifier
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <KUniquePointer>
+class KHalfEdgeMesh;
+
+// Quadric error edge-collapse simplification (Garland & Heckbert 1997).
+// Vertices are only ever collapsed onto other vertices, so every level of
+// detail indexes the vertices of the source mesh. Boundary edges of the
+// half-edge mesh are kept in place by constraint quadrics, and boundary
+// vertices may only slide along the boundary.
+class KMeshSimplifierPrivate;
+class KMeshSimplifier
+{
+public:
+
+  // Constructors / Destructor
+  KMeshSimplifier(KHalfEdgeMesh const &mesh);
+  ~KMeshSimplifier();
+
+  // Collapses edges until at most targetFaces remain, or until the next
+  // collapse would move the surface more than maxError (object space).
+  // Successive calls continue from the previous result. Returns numFaces().
+  size_t simplify(size_t targetFaces, float maxError);
+
+  // Query Commands
+  std::vector<uint32_t> const &indices() const;
+  size_t numFaces() const;
+  float error() const;
+
+private:
+  KUniquePointer<KMeshSimplifierPrivate> m_private;
+};
+
+#endif // KMESHSIMPLIFIER_H
@@ -0,0 +1,60 @@
+#ifndef KMORTON_H
+#define KMORTON_H KMorton
+
+#include <cstdint>
+#include <algorithm>
+#include <KVector3D>
+
+namespace Karma
+{
+
+// Spreads the low 10 bits of v so that there are two zero bits between each.
+inline uint32_t mortonExpand10(uint32_t v)
+{
+  v &= 0x000003ffu;
+  v = (v | (v << 16)) & 0x030000ffu;
+  v = (v | (v <<  8)) & 0x0300f00fu;
+  v = (v | (v <<  4)) & 0x030c30c3u;
+  v = (v | (v <<  2)) & 0x09249249u;
+  return v;
+}
+
+// Spreads the low 21 bits of v so that there are two zero bits between each.
+inline uint64_t mortonExpand21(uint64_t v)
+{
+  v &= 0x00000000001fffffull;
+  v = (v | (v << 32)) & 0x001f00000000ffffull;
+  v = (v | (v << 16)) & 0x001f0000ff0000ffull;
+  v = (v | (v <<  8)) & 0x100f00f00f00f00full;
+  v = (v | (v <<  4)) & 0x10c30c30c30c30c3ull;
+  v = (v | (v <<  2)) & 0x1249249249249249ull;
+  return v;
+}
+
+// Quantizes t in [0, 1] to [0, cells).
+inline uint32_t mortonQuantize(float t, uint32_t cells)
+{
+  float cell = t * cells;
+  if (cell <= 0.0f) return 0;
+  return std::min(static_cast<uint32_t>(cell), cells - 1);
+}
+
+// 30-bit Morton code of a point normalized into the unit cube.
+inline uint32_t mortonCode30(KVector3D const &unit)
+{
+  return (mortonExpand10(mortonQuantize(unit.x(), 1u << 10)) << 2)
+       | (mortonExpand10(mortonQuantize(unit.y(), 1u << 10)) << 1)
+       |  mortonExpand10(mortonQuantize(unit.z(), 1u << 10));
+}
+
+// 63-bit Morton code of a point normalized into the unit cube.
+inline uint64_t mortonCode63(KVector3D const &unit)
+{
+  return (mortonExpand21(mortonQuantize(unit.x(), 1u << 21)) << 2)
+       | (mortonExpand21(mortonQuantize(unit.y(), 1u << 21)) << 1)
+       |  mortonExpand21(mortonQuantize(unit.z(), 1u << 21));
+}
+
+}
+
+#endif // KMORTON_H
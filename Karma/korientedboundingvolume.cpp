@@ -26,12 +26,12 @@ void KOrientedBoundingVolumePrivate::calculatePcaMethod(const KHalfEdgeMesh &mes
       vertices.end(),
       KHalfEdgeMesh::VertexPositionPred()
     );
-  axes = Karma::jacobi(covariance, 50);
+  axes = Karma::symmetricEigen(covariance);
 
-  // Find the extremal projected points along each axis
+  // Find the extremal points along each axis
   std::vector<KVector3D> extractedAxes = Karma::decomposeMatrixeByColumnVectors(axes);
   std::vector<Karma::MinMaxKVector3D> extremal =
-    Karma::findExtremalProjectedPointsAlongAxes(
+    Karma::findExtremalPointsAlongAxes(
       vertices.begin(),
       vertices.end(),
       extractedAxes.begin(),
@@ -39,13 +39,8 @@ void KOrientedBoundingVolumePrivate::calculatePcaMethod(const KHalfEdgeMesh &mes
       KHalfEdgeMesh::VertexPositionPred()
     );
 
-  // Store information for the centroid and extent
-  extents.setX((extremal[0].max - extremal[0].min).length() / 2.0f);
-  extents.setY((extremal[1].max - extremal[1].min).length() / 2.0f);
-  extents.setZ((extremal[2].max - extremal[2].min).length() / 2.0f);
-  centroid  = (extremal[0].max + extremal[0].min) / 2.0f;
-  centroid += (extremal[1].max + extremal[1].min) / 2.0f;
-  centroid += (extremal[2].max + extremal[2].min) / 2.0f;
+  // Store information for the centroid and extent (Same as KBoundingVolumeBuilder)
+  Karma::orientedBounds(axes, extremal, &centroid, &extents);
 }
 
 KOrientedBoundingVolume::KOrientedBoundingVolume() :
@@ -66,6 +61,15 @@ KOrientedBoundingVolume::KOrientedBoundingVolume(const KHalfEdgeMesh &mesh, Meth
   }
 }
 
+KOrientedBoundingVolume::KOrientedBoundingVolume(KVector3D const &centroid, KMatrix3x3 const &axes, KVector3D const &extents) :
+  m_private(new KOrientedBoundingVolumePrivate)
+{
+  P(KOrientedBoundingVolumePrivate);
+  p.centroid = centroid;
+  p.axes = axes;
+  p.extents = extents;
+}
+
 KOrientedBoundingVolume::~KOrientedBoundingVolume()
 {
   delete m_private;
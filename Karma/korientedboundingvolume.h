@@ -2,7 +2,9 @@
 #define KORIENTEDBOUNDINGVOLUME_H KOrientedBoundingVolume
 
 #include <KAbstractBoundingVolume>
+#include <KVector3D>
 class KHalfEdgeMesh;
+class KMatrix3x3;
 
 class KOrientedBoundingVolumePrivate;
 class KOrientedBoundingVolume : public KAbstractBoundingVolume
@@ -18,6 +20,7 @@ public:
   // Constructors / Destructor
   KOrientedBoundingVolume();
   KOrientedBoundingVolume(KHalfEdgeMesh const &mesh, Method method);
+  KOrientedBoundingVolume(KVector3D const &centroid, KMatrix3x3 const &axes, KVector3D const &extents);
   ~KOrientedBoundingVolume();
 
   // Virtual Implementaiton
@@ -0,0 +1,207 @@
+#ifndef KPARALLEL_H
+#define KPARALLEL_H KParallel
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <thread>
+#include <vector>
+
+namespace Karma
+{
+
+// Number of workers a parallel loop will spin up (Always at least 1).
+inline size_t idealThreadCount()
+{
+  size_t count = std::thread::hardware_concurrency();
+  return (count == 0) ? 1 : count;
+}
+
+// Extra threads currently started by parallelChunks() and parallelInvoke()
+// (Process-wide). Together with the calling thread they never exceed
+// idealThreadCount(), however deeply the helpers below are nested.
+inline std::atomic<size_t> &activeWorkerThreads()
+{
+  static std::atomic<size_t> count(0);
+  return count;
+}
+
+// Claims up to wanted extra threads from the budget, returning how many.
+inline size_t claimWorkerThreads(size_t wanted)
+{
+  std::atomic<size_t> &active = activeWorkerThreads();
+  size_t budget = idealThreadCount() - 1;
+  size_t current = active.load();
+  size_t granted;
+  do
+  {
+    granted = (current < budget) ? std::min(wanted, budget - current) : 0;
+    if (granted == 0) return 0;
+  } while (!active.compare_exchange_weak(current, current + granted));
+  return granted;
+}
+
+inline void releaseWorkerThreads(size_t count)
+{
+  activeWorkerThreads() -= count;
+}
+
+// Runs func(chunk) for every chunk in [0, chunks), distributing the chunks
+// across the calling thread and as many workers as the thread budget allows
+// (Inline when it is exhausted, e.g. when nested inside another parallel
+// helper). The call returns only once every chunk has completed. Chunk
+// boundaries are decided by the caller, so results written per-chunk are
+// deterministic.
+template <typename Func>
+void parallelChunks(size_t chunks, Func func)
+{
+  size_t extra = (chunks > 1) ? claimWorkerThreads(std::min(idealThreadCount(), chunks) - 1) : 0;
+  if (extra == 0)
+  {
+    for (size_t i = 0; i < chunks; ++i)
+    {
+      func(i);
+    }
+    return;
+  }
+
+  std::atomic<size_t> next(0);
+  auto worker = [&next, chunks, &func]()
+  {
+    for (size_t i = next++; i < chunks; i = next++)
+    {
+      func(i);
+    }
+  };
+
+  std::vector<std::thread> threads;
+  threads.reserve(extra);
+  for (size_t i = 0; i < extra; ++i)
+  {
+    threads.emplace_back(worker);
+  }
+  worker();
+  for (std::thread &t : threads)
+  {
+    t.join();
+  }
+  releaseWorkerThreads(extra);
+}
+
+// Runs func(begin, end) over [0, count) split into ranges of at most grain.
+template <typename Func>
+void parallelFor(size_t count, size_t grain, Func func)
+{
+  if (grain == 0) grain = 1;
+  size_t chunks = (count + grain - 1) / grain;
+  parallelChunks(chunks, [count, grain, &func](size_t chunk)
+  {
+    size_t begin = chunk * grain;
+    func(begin, std::min(begin + grain, count));
+  });
+}
+
+// Runs a() and b(), concurrently while the thread budget allows and inline
+// otherwise. Nested calls share the budget with parallelChunks(), so recursive
+// fork-join builders saturate the machine without oversubscribing.
+template <typename FuncA, typename FuncB>
+void parallelInvoke(FuncA a, FuncB b)
+{
+  if (claimWorkerThreads(1) == 1)
+  {
+    std::thread worker(b);
+    a();
+    worker.join();
+    releaseWorkerThreads(1);
+  }
+  else
+  {
+    a();
+    b();
+  }
+}
+
+// Runs func(i) for every i in [begin, end) by recursively halving the range
+// through parallelInvoke().
+template <typename Func>
+void parallelTasks(size_t begin, size_t end, Func const &func)
+{
+  if (end <= begin) return;
+  if (end - begin == 1)
+  {
+    func(begin);
+    return;
+  }
+  size_t middle = begin + (end - begin) / 2;
+  parallelInvoke(
+    [&]() { parallelTasks(begin, middle, func); },
+    [&]() { parallelTasks(middle, end, func); }
+  );
+}
+
+// Stable partition of a random-access range, counted and scattered in fixed
+// chunks. Equivalent to std::stable_partition regardless of the thread count.
+template <typename It, typename Pred>
+It parallelPartition(It begin, It end, Pred pred)
+{
+  typedef typename std::iterator_traits<It>::value_type Value;
+  static const size_t ChunkSize = size_t(1) << 14;
+  size_t count = std::distance(begin, end);
+  size_t chunks = (count + ChunkSize - 1) / ChunkSize;
+
+  // Classify and count per chunk
+  std::vector<uint8_t> accepted(count);
+  std::vector<size_t> offsets(chunks + 1, 0);
+  parallelChunks(chunks, [&](size_t chunk)
+  {
+    size_t last = std::min(count, (chunk + 1) * ChunkSize);
+    size_t total = 0;
+    for (size_t i = chunk * ChunkSize; i < last; ++i)
+    {
+      accepted[i] = pred(begin[i]) ? 1 : 0;
+      total += accepted[i];
+    }
+    offsets[chunk + 1] = total;
+  });
+  for (size_t chunk = 0; chunk < chunks; ++chunk)
+  {
+    offsets[chunk + 1] += offsets[chunk];
+  }
+  size_t split = offsets[chunks];
+
+  // Scatter accepted elements to the front and the rest after them, in order
+  std::vector<Value> scratch(count);
+  parallelChunks(chunks, [&](size_t chunk)
+  {
+    size_t first = chunk * ChunkSize;
+    size_t last = std::min(count, first + ChunkSize);
+    size_t front = offsets[chunk];
+    size_t back = split + (first - offsets[chunk]);
+    for (size_t i = first; i < last; ++i)
+    {
+      scratch[accepted[i] ? front++ : back++] = begin[i];
+    }
+  });
+  parallelFor(count, ChunkSize, [&](size_t first, size_t last)
+  {
+    std::copy(scratch.begin() + first, scratch.begin() + last, begin + first);
+  });
+  return begin + split;
+}
+
+// Raises value to at least candidate.
+template <typename T>
+void atomicMax(std::atomic<T> &value, T candidate)
+{
+  T current = value.load();
+  while (current < candidate && !value.compare_exchange_weak(current, candidate))
+  {
+    // Intentionally Empty
+  }
+}
+
+}
+
+#endif // KPARALLEL_H
@@ -0,0 +1,120 @@
+#ifndef KRADIXSORT_H
+#define KRADIXSORT_H KRadixSort
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <KParallel>
+
+namespace Karma
+{
+
+// Stable LSD radix sort of (key, value) pairs on unsigned integral keys.
+// Byte positions that are identical across all keys are skipped, so small
+// index ranges packed into wide keys only pay for the bytes they use.
+// Large inputs are split into fixed chunks which are counted and scattered
+// in parallel; chunk boundaries only depend on the count, so the result is
+// identical to the sequential sort.
+template <typename Key, typename Value>
+void radixSort(std::vector<Key> &keys, std::vector<Value> &values)
+{
+  static_assert(std::is_unsigned<Key>::value, "radixSort requires unsigned keys");
+  static const size_t RadixBits = 8;
+  static const size_t RadixSize = size_t(1) << RadixBits;
+  static const size_t Passes = sizeof(Key) * 8 / RadixBits;
+  static const size_t ChunkSize = size_t(1) << 16;
+
+  size_t count = keys.size();
+  size_t chunks = (count + ChunkSize - 1) / ChunkSize;
+  if (chunks == 0) return;
+  std::vector<Key> keyScratch(count);
+  std::vector<Value> valueScratch(count);
+
+  // Histogram every digit in a single read of the keys (Per chunk)
+  std::vector<size_t> histograms(chunks * Passes * RadixSize, 0);
+  parallelChunks(chunks, [&](size_t chunk)
+  {
+    size_t *histogram = &histograms[chunk * Passes * RadixSize];
+    size_t end = std::min(count, (chunk + 1) * ChunkSize);
+    for (size_t i = chunk * ChunkSize; i < end; ++i)
+    {
+      for (size_t pass = 0; pass < Passes; ++pass)
+      {
+        ++histogram[pass * RadixSize + ((keys[i] >> (pass * RadixBits)) & (RadixSize - 1))];
+      }
+    }
+  });
+
+  bool counted = true;
+  std::vector<size_t> offsets(chunks * RadixSize);
+  for (size_t pass = 0; pass < Passes; ++pass)
+  {
+    size_t shift = pass * RadixBits;
+
+    // Skip digits which are the same for every key (Totals don't depend on order)
+    bool trivial = false;
+    for (size_t digit = 0; digit < RadixSize; ++digit)
+    {
+      size_t total = 0;
+      for (size_t chunk = 0; chunk < chunks; ++chunk)
+      {
+        total += histograms[(chunk * Passes + pass) * RadixSize + digit];
+      }
+      if (total == count)
+      {
+        trivial = true;
+        break;
+      }
+      if (total != 0) break;
+    }
+    if (trivial) continue;
+
+    // Per-chunk counts change once keys have moved, so recount this digit
+    if (!counted)
+    {
+      parallelChunks(chunks, [&](size_t chunk)
+      {
+        size_t *histogram = &histograms[(chunk * Passes + pass) * RadixSize];
+        std::fill(histogram, histogram + RadixSize, 0);
+        size_t end = std::min(count, (chunk + 1) * ChunkSize);
+        for (size_t i = chunk * ChunkSize; i < end; ++i)
+        {
+          ++histogram[(keys[i] >> shift) & (RadixSize - 1)];
+        }
+      });
+    }
+    counted = false;
+
+    // Exclusive prefix sum into offsets, digit-major so chunks keep their order
+    size_t offset = 0;
+    for (size_t digit = 0; digit < RadixSize; ++digit)
+    {
+      for (size_t chunk = 0; chunk < chunks; ++chunk)
+      {
+        offsets[chunk * RadixSize + digit] = offset;
+        offset += histograms[(chunk * Passes + pass) * RadixSize + digit];
+      }
+    }
+
+    // Scatter (Stable)
+    parallelChunks(chunks, [&](size_t chunk)
+    {
+      size_t *offset = &offsets[chunk * RadixSize];
+      size_t end = std::min(count, (chunk + 1) * ChunkSize);
+      for (size_t i = chunk * ChunkSize; i < end; ++i)
+      {
+        size_t dst = offset[(keys[i] >> shift) & (RadixSize - 1)]++;
+        keyScratch[dst] = keys[i];
+        valueScratch[dst] = values[i];
+      }
+    });
+    keys.swap(keyScratch);
+    values.swap(valueScratch);
+  }
+}
+
+}
+
+#endif // KRADIXSORT_H
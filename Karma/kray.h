@@ -0,0 +1,77 @@
+#ifndef KRAY_H
+#define KRAY_H KRay
+
+#include <cstddef>
+#include <limits>
+#include <KVector3D>
+
+// A ray which only reports hits with a parameter t in (tMin, tMax).
+// The direction need not be normalized; t is measured in its length.
+class KRay
+{
+public:
+  KRay();
+  KRay(KVector3D const &origin, KVector3D const &direction, float tMin = 0.0f, float tMax = std::numeric_limits<float>::max());
+
+  KVector3D const &origin() const;
+  KVector3D const &direction() const;
+  float tMin() const;
+  float tMax() const;
+  KVector3D point(float t) const;
+
+private:
+  KVector3D m_origin;
+  KVector3D m_direction;
+  float m_tMin;
+  float m_tMax;
+};
+
+// The closest intersection along a ray.
+//   triangle: Index into the order the structure stores its triangles in
+//   u, v: Barycentric weights of the triangle's second and third vertex
+struct KRayHit
+{
+  size_t triangle;
+  float distance;
+  float u, v;
+  KVector3D normal;
+};
+
+inline KRay::KRay() :
+  m_tMin(0.0f), m_tMax(std::numeric_limits<float>::max())
+{
+  // Intentionally Empty
+}
+
+inline KRay::KRay(KVector3D const &origin, KVector3D const &direction, float tMin, float tMax) :
+  m_origin(origin), m_direction(direction), m_tMin(tMin), m_tMax(tMax)
+{
+  // Intentionally Empty
+}
+
+inline KVector3D const &KRay::origin() const
+{
+  return m_origin;
+}
+
+inline KVector3D const &KRay::direction() const
+{
+  return m_direction;
+}
+
+inline float KRay::tMin() const
+{
+  return m_tMin;
+}
+
+inline float KRay::tMax() const
+{
+  return m_tMax;
+}
+
+inline KVector3D KRay::point(float t) const
+{
+  return m_origin + m_direction * t;
+}
+
+#endif // KRAY_H
@@ -12,7 +12,7 @@ class KSphereBoundingVolumePrivate
 public:
   void calculateCentroidMethod(const KHalfEdgeMesh &mesh);
   void calculateRittersMethod(const KHalfEdgeMesh &mesh);
-  void calculateLarssonsMethod(const KHalfEdgeMesh &mesh);
+  void calculateLarssonsMethod(const KHalfEdgeMesh &mesh, KEposSphere::Variant variant);
   void calculatePcaMethod(const KHalfEdgeMesh &mesh);
   KVector3D centroid;
   float radius;
@@ -20,7 +20,7 @@ private:
   void mostSeparatedPoints(KVector3D *min, KVector3D *max, const KHalfEdgeMesh &mesh, size_t sample);
   void calculateFromDistantPoints(const KHalfEdgeMesh &mesh, size_t sample);
   void expandToContainPoint(const KVector3D &v);
-  void calculateFromCovarianceMatrix(const KHalfEdgeMesh &mesh, int iterations);
+  void calculateFromCovarianceMatrix(const KHalfEdgeMesh &mesh);
 };
 
 void KSphereBoundingVolumePrivate::calculateCentroidMethod(const KHalfEdgeMesh &mesh)
@@ -49,15 +49,9 @@ void KSphereBoundingVolumePrivate::calculateRittersMethod(const KHalfEdgeMesh &m
   }
 }
 
-void KSphereBoundingVolumePrivate::calculateLarssonsMethod(const KHalfEdgeMesh &mesh)
+void KSphereBoundingVolumePrivate::calculateLarssonsMethod(const KHalfEdgeMesh &mesh, KEposSphere::Variant variant)
 {
-  std::vector<KVector3D> normals =
-  {
-    KVector3D(1.0f, 0.0f, 0.0f),
-    KVector3D(0.0f, 1.0f, 0.0f),
-    KVector3D(0.0f, 0.0f, 1.0f)
-  };
-  KEposSphere sphere(mesh.vertices().begin(), mesh.vertices().end(), normals.begin(), normals.end(), KHalfEdgeMesh::VertexPositionPred());
+  KEposSphere sphere(mesh.vertices().begin(), mesh.vertices().end(), variant, KHalfEdgeMesh::VertexPositionPred());
   centroid = sphere.centroid;
   radius = sphere.radius;
   for (KHalfEdgeMesh::Vertex const & v : mesh.vertices())
@@ -68,7 +62,7 @@ void KSphereBoundingVolumePrivate::calculateLarssonsMethod(const KHalfEdgeMesh &
 
 void KSphereBoundingVolumePrivate::calculatePcaMethod(const KHalfEdgeMesh &mesh)
 {
-  calculateFromCovarianceMatrix(mesh, 50);
+  calculateFromCovarianceMatrix(mesh);
   for (KHalfEdgeMesh::Vertex const & v : mesh.vertices())
   {
     expandToContainPoint(v.position);
@@ -132,7 +126,7 @@ void KSphereBoundingVolumePrivate::expandToContainPoint(const KVector3D &v)
   }
 }
 
-void KSphereBoundingVolumePrivate::calculateFromCovarianceMatrix(const KHalfEdgeMesh &mesh, int iterations)
+void KSphereBoundingVolumePrivate::calculateFromCovarianceMatrix(const KHalfEdgeMesh &mesh)
 {
   KHalfEdgeMesh::VertexContainer const &vertices = mesh.vertices();
 
@@ -143,10 +137,10 @@ void KSphereBoundingVolumePrivate::calculateFromCovarianceMatrix(const KHalfEdge
       vertices.end(),
       KHalfEdgeMesh::VertexPositionPred()
     );
-  KMatrix3x3 eigenVectors = Karma::jacobi(covariance, iterations);
+  KMatrix3x3 eigenVectors = Karma::symmetricEigen(covariance);
 
-  // Find extremal points along axis
-  KVector3D axis = Karma::maxEigenExtents(eigenVectors);
+  // Find extremal points along the dominant eigenvector
+  KVector3D axis(eigenVectors[0][0], eigenVectors[1][0], eigenVectors[2][0]);
   Karma::MinMaxKVector3D minMax =
     Karma::findExtremalPointsAlongAxis(
       vertices.begin(),
@@ -167,10 +161,26 @@ KSphereBoundingVolume::KSphereBoundingVolume() :
   // Intentionally Empty
 }
 
-KSphereBoundingVolume::KSphereBoundingVolume(const KHalfEdgeMesh &mesh, Method method) :
+KSphereBoundingVolume::KSphereBoundingVolume(const KHalfEdgeMesh &mesh, Method method, Accuracy accuracy) :
   m_private(new KSphereBoundingVolumePrivate)
 {
   P(KSphereBoundingVolumePrivate);
+  KEposSphere::Variant variant = KEposSphere::Epos6;
+  switch (accuracy)
+  {
+  case Epos6Accuracy:
+    variant = KEposSphere::Epos6;
+    break;
+  case Epos14Accuracy:
+    variant = KEposSphere::Epos14;
+    break;
+  case Epos26Accuracy:
+    variant = KEposSphere::Epos26;
+    break;
+  case Epos98Accuracy:
+    variant = KEposSphere::Epos98;
+    break;
+  }
   switch (method)
   {
   case CentroidMethod:
@@ -180,7 +190,7 @@ KSphereBoundingVolume::KSphereBoundingVolume(const KHalfEdgeMesh &mesh, Method m
     p.calculateRittersMethod(mesh);
     break;
   case LarssonsMethod:
-    p.calculateLarssonsMethod(mesh);
+    p.calculateLarssonsMethod(mesh, variant);
     break;
   case PcaMethod:
     p.calculatePcaMethod(mesh);
@@ -188,6 +198,14 @@ KSphereBoundingVolume::KSphereBoundingVolume(const KHalfEdgeMesh &mesh, Method m
   }
 }
 
+KSphereBoundingVolume::KSphereBoundingVolume(KVector3D const &centroid, float radius) :
+  m_private(new KSphereBoundingVolumePrivate)
+{
+  P(KSphereBoundingVolumePrivate);
+  p.centroid = centroid;
+  p.radius = radius;
+}
+
 KSphereBoundingVolume::~KSphereBoundingVolume()
 {
   delete m_private;
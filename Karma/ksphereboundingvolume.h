@@ -2,6 +2,7 @@
 #define KSPHEREBOUNDINGVOLUME_H KSphereBoundingVolume
 
 #include <KAbstractBoundingVolume>
+#include <KVector3D>
 class KHalfEdgeMesh;
 
 class KSphereBoundingVolumePrivate;
@@ -18,9 +19,19 @@ public:
     PcaMethod
   };
 
+  // Larsson's Method Accuracy (EPOS-k; larger k is slower but tighter)
+  enum Accuracy
+  {
+    Epos6Accuracy,
+    Epos14Accuracy,
+    Epos26Accuracy,
+    Epos98Accuracy
+  };
+
   // Constuctors / Destructor
   KSphereBoundingVolume();
-  KSphereBoundingVolume(KHalfEdgeMesh const &mesh, Method method);
+  KSphereBoundingVolume(KHalfEdgeMesh const &mesh, Method method, Accuracy accuracy = Epos6Accuracy);
+  KSphereBoundingVolume(KVector3D const &centroid, float radius);
   ~KSphereBoundingVolume();
 
   // Virtual Implementation
@@ -6,38 +6,139 @@
 #include <KVector3D>
 #include <KHalfEdgeMesh>
 #include <KTransform3D>
+#include <KMatrix4x4>
 #include <OpenGLBuffer>
 #include <OpenGLFunctions>
 #include <KAabbBoundingVolume>
 #include <KPointCloud>
 #include <KTriangleIndexCloud>
-#include <KIndexCloud>
 #include <KTrianglePointIterator>
 #include <KTrianglePartition>
+#include <KParallel>
+#include <KRadixSort>
+#include <KMorton>
+#include <KRay>
+#include <KFloat4>
+#include <KFrustum>
+#include <KCacheFile>
+#include <cmath>
+#include <limits>
+
+// Surface area heuristic constants (Relative cost of a node visit, and a triangle test)
+static const float sg_sahTraversalCost = 1.0f;
+static const float sg_sahIntersectionCost = 1.0f;
+static const size_t sg_sahBinCount = 32;
+
+// Bottom-up construction (Morton order, then agglomerative clustering)
+static const size_t sg_mortonShortCodeLimit = size_t(1) << 20;
+static const size_t sg_plocRadius = 8;
+
+// Top-down construction forks subtrees above this many triangles, and
+// partitions in parallel above the second threshold.
+static const size_t sg_parallelBuildThreshold = size_t(1) << 12;
+static const size_t sg_parallelPartitionThreshold = size_t(1) << 16;
+
+// Refitting forks subtrees of at least this many nodes, and rebuilds once the
+// SAH cost has grown by this factor since the last build.
+static const size_t sg_parallelRefitThreshold = size_t(1) << 10;
+static const float sg_defaultRebuildThreshold = 1.5f;
+
+// Ray traversal keeps its stack on the call stack for trees up to this depth
+static const size_t sg_rayStackSize = 64;
+
+template <typename Pred>
+static KTriangleIndexCloud::Iterator partitionTriangles(KTriangleIndexCloud::Iterator begin, KTriangleIndexCloud::Iterator end, Pred pred)
+{
+  if (static_cast<size_t>(std::distance(begin, end)) >= sg_parallelPartitionThreshold)
+  {
+    return Karma::parallelPartition(begin, end, pred);
+  }
+  return std::partition(begin, end, pred);
+}
 
 /*******************************************************************************
- * KStaticGeometryInstance
+ * KStaticGeometryFlatNode
  ******************************************************************************/
-struct KStaticGeometryInstance
+// Nodes are stored depth-first, so the left child of an interior node is the
+// node directly after it and only the right child needs to be recorded.
+struct KStaticGeometryFlatNode
 {
-  KStaticGeometryInstance(KTriangleIndexIterator begin, KTriangleIndexIterator end);
-  KIndexCloud m_indexCloud;
+  bool isLeaf() const;
+  float surfaceArea() const;
+  float min[3];
+  uint32_t offset;  // Interior: Index of the right child, Leaf: First triangle
+  float max[3];
+  uint32_t count;   // Interior: 0, Leaf: Number of triangles
 };
+static_assert(sizeof(KStaticGeometryFlatNode) == 32, "KStaticGeometryFlatNode should fill half a cache line");
 
-KStaticGeometryInstance::KStaticGeometryInstance(KTriangleIndexIterator begin, KTriangleIndexIterator end)
+inline bool KStaticGeometryFlatNode::isLeaf() const
 {
-  size_t numIndices = std::distance(begin, end);
-  m_indexCloud.reserve(numIndices);
-  while (begin != end)
-  {
-    m_indexCloud.emplace_back((*begin) - 1);
-    ++begin;
-  }
+  return (count != 0);
+}
+
+inline float KStaticGeometryFlatNode::surfaceArea() const
+{
+  float x = max[0] - min[0], y = max[1] - min[1], z = max[2] - min[2];
+  return 2.0f * (x * y + y * z + z * x);
+}
+
+// Triangles are gathered in leaf order, so every leaf reads one contiguous range.
+struct KStaticGeometryTriangle
+{
+  KVector3D a, b, c;
+};
+
+typedef std::vector<KStaticGeometryFlatNode> KStaticGeometryFlatNodeContainer;
+typedef std::vector<KStaticGeometryTriangle> KStaticGeometryTriangleContainer;
+
+// Points contributed by one addGeometry() call, kept so they can be re-transformed.
+struct KStaticGeometryRange
+{
+  size_t firstPoint;
+  size_t numPoints;
+  KMatrix4x4 transform;
+  bool dirty;
+};
+typedef std::vector<KStaticGeometryRange> KStaticGeometryRangeContainer;
+
+/*******************************************************************************
+ * Static Geometry Cache (See KStaticGeometry::save())
+ ******************************************************************************/
+// Layout: Header, Nodes, Triangles, Triangle Indices (each array 16-byte aligned).
+// Note: Bump the version whenever the node or triangle layout changes.
+static char const sg_cacheMagic[4] = { 'K', 'S', 'T', 'G' };
+static const uint32_t sg_cacheVersion = 1;
+
+struct KStaticGeometryCacheHeader
+{
+  char magic[4];
+  uint32_t version;
+  uint32_t nodeSize;
+  uint32_t triangleSize;
+  uint64_t sourceChecksum;
+  uint32_t method;
+  uint32_t depth;
+  float sahCost;
+  uint32_t reserved;
+  uint64_t numNodes;
+  uint64_t numTriangles;
+};
+
+static KStaticGeometryCacheHeader cacheHeader(uint64_t sourceChecksum, KStaticGeometry::BuildMethod method)
+{
+  KStaticGeometryCacheHeader header = KCacheFile::header<KStaticGeometryCacheHeader>(sg_cacheMagic, sg_cacheVersion);
+  header.nodeSize = sizeof(KStaticGeometryFlatNode);
+  header.triangleSize = sizeof(KStaticGeometryTriangle);
+  header.sourceChecksum = sourceChecksum;
+  header.method = static_cast<uint32_t>(method);
+  return header;
 }
 
 /*******************************************************************************
  * KStaticGeometryNode
  ******************************************************************************/
+// Intermediate node used while building; flattened once the tree is complete.
 class KStaticGeometryNode
 {
 public:
@@ -45,55 +146,45 @@ public:
 
   KStaticGeometryNode(size_t depth, ConstIterator begin, ConstIterator end, KPointCloud const &pointCloud);
   KStaticGeometryNode(size_t depth, KStaticGeometryNode *left, KStaticGeometryNode *right);
+  ~KStaticGeometryNode();
   bool isLeaf() const;
-  void drawAabb(KTransform3D &trans, KColor const &color, size_t min, size_t max) const;
   void correctDepth(size_t depth);
   size_t getMaxDepth();
+  float surfaceArea() const;
 
   KAabbBoundingVolume aabb;
   KStaticGeometryNode *left;
   KStaticGeometryNode *right;
 
-  // For drawing
+  // Leaf range of the (reordered) triangle index cloud
   size_t from, to;
   size_t depth;
-  KStaticGeometryInstance *instance;
 };
 
 KStaticGeometryNode::KStaticGeometryNode(size_t d, ConstIterator begin, ConstIterator end, KPointCloud const &pointCloud) :
   aabb(KTrianglePointIterator(begin, pointCloud), KTrianglePointIterator(end, pointCloud)),
-  left(0), right(0), depth(d), instance(0)
+  left(0), right(0), from(0), to(0), depth(d)
 {
   // Intentionally Empty
 }
 
 KStaticGeometryNode::KStaticGeometryNode(size_t d, KStaticGeometryNode *left, KStaticGeometryNode *right) :
   aabb(left->aabb, right->aabb),
-  left(left), right(right), depth(d), instance(0)
+  left(left), right(right), from(0), to(0), depth(d)
 {
   left->depth = depth + 1;
   right->depth = depth + 1;
 }
 
-bool KStaticGeometryNode::isLeaf() const
+KStaticGeometryNode::~KStaticGeometryNode()
 {
-  return (left == 0);
+  delete left;
+  delete right;
 }
 
-void KStaticGeometryNode::drawAabb(KTransform3D &trans, const KColor &color, size_t min, size_t max) const
+bool KStaticGeometryNode::isLeaf() const
 {
-  if (depth <= max)
-  {
-    if (depth >= min)
-    {
-      aabb.draw(trans, Karma::colorShift(color, 0.1f * depth));
-    }
-    if (!isLeaf())
-    {
-      if (left)  left->drawAabb(trans, color, min, max);
-      if (right) right->drawAabb(trans, color, min, max);
-    }
-  }
+  return (left == 0);
 }
 
 void KStaticGeometryNode::correctDepth(size_t d)
@@ -108,6 +199,155 @@ size_t KStaticGeometryNode::getMaxDepth()
   return std::max(depth, std::max(left ? left->getMaxDepth() : 0, right ? right->getMaxDepth() : 0));
 }
 
+float KStaticGeometryNode::surfaceArea() const
+{
+  KVector3D extent = aabb.maxExtent() - aabb.minExtent();
+  return 2.0f * (extent.x() * extent.y() + extent.y() * extent.z() + extent.z() * extent.x());
+}
+
+/*******************************************************************************
+ * KSahBin
+ ******************************************************************************/
+struct KSahBin
+{
+  KSahBin();
+  void encompass(KSahBin const &rhs);
+  void encompassPoint(KVector3D const &p);
+  float surfaceArea() const;
+  KVector3D min, max;
+  size_t count;
+};
+
+KSahBin::KSahBin() :
+  min( std::numeric_limits<float>::max(),  std::numeric_limits<float>::max(),  std::numeric_limits<float>::max()),
+  max(-std::numeric_limits<float>::max(), -std::numeric_limits<float>::max(), -std::numeric_limits<float>::max()),
+  count(0)
+{
+  // Intentionally Empty
+}
+
+void KSahBin::encompass(KSahBin const &rhs)
+{
+  if (rhs.count == 0) return;
+  encompassPoint(rhs.min);
+  encompassPoint(rhs.max);
+  count += rhs.count;
+}
+
+void KSahBin::encompassPoint(KVector3D const &p)
+{
+  min = KVector3D(std::min(min.x(), p.x()), std::min(min.y(), p.y()), std::min(min.z(), p.z()));
+  max = KVector3D(std::max(max.x(), p.x()), std::max(max.y(), p.y()), std::max(max.z(), p.z()));
+}
+
+float KSahBin::surfaceArea() const
+{
+  if (count == 0) return 0.0f;
+  KVector3D extent = max - min;
+  return 2.0f * (extent.x() * extent.y() + extent.y() * extent.z() + extent.z() * extent.x());
+}
+
+/*******************************************************************************
+ * Ray Helpers
+ ******************************************************************************/
+// Axis-aligned directions would divide by zero (And 0 * inf on the slab planes)
+static float safeReciprocal(float d)
+{
+  static const float epsilon = 1e-30f;
+  if (std::fabs(d) < epsilon) d = (d < 0.0f) ? -epsilon : epsilon;
+  return 1.0f / d;
+}
+
+// Slab test, narrowing [tMin, tMax] to the part of the ray inside the node.
+static bool rayIntersectsNode(KStaticGeometryFlatNode const &node, float const *origin, float const *invDir, float tMin, float tMax, float &tEntry)
+{
+  for (int k = 0; k < 3; ++k)
+  {
+    float t0 = (node.min[k] - origin[k]) * invDir[k];
+    float t1 = (node.max[k] - origin[k]) * invDir[k];
+    if (t0 > t1) std::swap(t0, t1);
+    tMin = std::max(tMin, t0);
+    tMax = std::min(tMax, t1);
+  }
+  tEntry = tMin;
+  return (tMin <= tMax);
+}
+
+// Moller-Trumbore; hits are accepted with t in (tMin, tMax).
+static bool rayIntersectsTriangle(KStaticGeometryTriangle const &tri, KRay const &ray, float tMin, float tMax, float &t, float &u, float &v)
+{
+  KVector3D e1 = tri.b - tri.a;
+  KVector3D e2 = tri.c - tri.a;
+  KVector3D pvec = KVector3D::crossProduct(ray.direction(), e2);
+  float det = KVector3D::dotProduct(e1, pvec);
+  if (det == 0.0f) return false;
+  float invDet = 1.0f / det;
+
+  KVector3D tvec = ray.origin() - tri.a;
+  u = KVector3D::dotProduct(tvec, pvec) * invDet;
+  if (u < 0.0f || u > 1.0f) return false;
+  KVector3D qvec = KVector3D::crossProduct(tvec, e1);
+  v = KVector3D::dotProduct(ray.direction(), qvec) * invDet;
+  if (v < 0.0f || u + v > 1.0f) return false;
+  t = KVector3D::dotProduct(e2, qvec) * invDet;
+  return (t > tMin && t < tMax);
+}
+
+// Four rays against one triangle; returns the lanes which hit within (tMin, tMax).
+struct KRayPacket
+{
+  KFloat4 origin[3];
+  KFloat4 direction[3];
+  KFloat4 invDir[3];
+  KFloat4 tMin, tMax;
+};
+
+static KFloat4 packetIntersectsTriangle(KStaticGeometryTriangle const &tri, KRayPacket const &packet, KFloat4 &t, KFloat4 &u, KFloat4 &v)
+{
+  KFloat4 e1x(tri.b.x() - tri.a.x()), e1y(tri.b.y() - tri.a.y()), e1z(tri.b.z() - tri.a.z());
+  KFloat4 e2x(tri.c.x() - tri.a.x()), e2y(tri.c.y() - tri.a.y()), e2z(tri.c.z() - tri.a.z());
+  KFloat4 const &dx = packet.direction[0], &dy = packet.direction[1], &dz = packet.direction[2];
+
+  KFloat4 px = dy * e2z - dz * e2y;
+  KFloat4 py = dz * e2x - dx * e2z;
+  KFloat4 pz = dx * e2y - dy * e2x;
+  KFloat4 invDet = KFloat4(1.0f) / (e1x * px + e1y * py + e1z * pz);
+
+  KFloat4 tx = packet.origin[0] - KFloat4(tri.a.x());
+  KFloat4 ty = packet.origin[1] - KFloat4(tri.a.y());
+  KFloat4 tz = packet.origin[2] - KFloat4(tri.a.z());
+  u = (tx * px + ty * py + tz * pz) * invDet;
+
+  KFloat4 qx = ty * e1z - tz * e1y;
+  KFloat4 qy = tz * e1x - tx * e1z;
+  KFloat4 qz = tx * e1y - ty * e1x;
+  v = (dx * qx + dy * qy + dz * qz) * invDet;
+  t = (e2x * qx + e2y * qy + e2z * qz) * invDet;
+
+  // A zero determinant gives inf/NaN, which fails every comparison below
+  KFloat4 zero(0.0f);
+  return (u >= zero) & (v >= zero) & (u + v <= KFloat4(1.0f)) & (t > packet.tMin) & (t < packet.tMax);
+}
+
+// Returns the lanes for which the node overlaps [tMin, tMax].
+static KFloat4 packetIntersectsNode(KStaticGeometryFlatNode const &node, KRayPacket const &packet)
+{
+  KFloat4 tNear = packet.tMin, tFar = packet.tMax;
+  for (int k = 0; k < 3; ++k)
+  {
+    KFloat4 t0 = (KFloat4(node.min[k]) - packet.origin[k]) * packet.invDir[k];
+    KFloat4 t1 = (KFloat4(node.max[k]) - packet.origin[k]) * packet.invDir[k];
+    tNear = max(tNear, min(t0, t1));
+    tFar = min(tFar, max(t0, t1));
+  }
+  return (tNear <= tFar);
+}
+
+static KVector3D triangleNormal(KStaticGeometryTriangle const &tri)
+{
+  return KVector3D::crossProduct(tri.b - tri.a, tri.c - tri.a).normalized();
+}
+
 /*******************************************************************************
  * KStaticGeometryPrivate
  ******************************************************************************/
@@ -117,38 +357,126 @@ public:
   typedef KTriangleIndexCloud::Iterator TriangleIterator;
   typedef KStaticGeometry::TerminationPred TerminationPred;
   KStaticGeometryPrivate(KGeometryCloud &parent);
+  void build(KStaticGeometry::BuildMethod method, TerminationPred pred);
   void buildBottomUp(TerminationPred pred);
   void buildTopDown(TerminationPred pred);
+  void buildSurfaceArea(TerminationPred pred);
+  void flatten();
+  float computeSahCost() const;
+  void refitNode(uint32_t index, uint32_t end);
+  void rebuild();
+  void cull(KFrustum const &frustum, KStaticGeometry::TriangleRangeContainer &visible);
+  KStaticGeometry::TriangleRange subtreeTriangles(uint32_t index) const;
+  void drawAabbs(KTransform3D &trans, KColor const &color, size_t min, size_t max) const;
+  bool readCache(QString const &fileName, KStaticGeometryCacheHeader const &expected, size_t numPoints, size_t numTriangles);
+  bool writeCache(QString const &fileName) const;
+  template <bool AnyHit>
+  bool traverse(KRay const &ray, KRayHit *hit) const;
+  template <bool AnyHit>
+  int traversePacket(KRay const *rays, KRayHit *hits) const;
 
   KStaticGeometryNode *m_root;
-  size_t m_maxDepth;
+  KStaticGeometryFlatNodeContainer m_nodes;
+  KStaticGeometryTriangleContainer m_triangles;
+  std::atomic<size_t> m_maxDepth;
+  float m_sahCost;
   KGeometryCloud m_parent;
 
+  // Refitting; points are kept in model and world space, and every entry of
+  // m_triangles keeps the (0-based) world point indices it was gathered from.
+  KStaticGeometry::BuildMethod m_method;
+  TerminationPred m_pred;
+  float m_builtSahCost;
+  float m_rebuildThreshold;
+  KPointCloud m_localPoints;
+  KPointCloud m_points;
+  KStaticGeometryRangeContainer m_geometries;
+  std::vector<uint32_t> m_triangleIndices;
+  KPointCloud m_pendingPoints;
+  KStaticGeometryRangeContainer m_pendingGeometries;
+
+  // Per node, the frustum plane which culled it last (Tested first next time)
+  std::vector<uint8_t> m_cullingPlanes;
+
+  // Checksum of the geometry the tree was built from; refitting invalidates it.
+  uint64_t m_sourceChecksum;
+  bool m_cacheable;
+
 private:
+  void setLeaf(KStaticGeometryNode *node, TriangleIterator begin, TriangleIterator end);
+  uint32_t flattenNode(KStaticGeometryNode const *node, size_t depth);
   KStaticGeometryNode *recursiveTopDown(size_t depth, TriangleIterator begin, TriangleIterator end, TerminationPred pred);
+  KStaticGeometryNode *recursiveSurfaceArea(size_t depth, TriangleIterator begin, TriangleIterator end, TerminationPred pred);
 };
 
-// Helper functor
-struct KAabbMinCentroidDistance : public std::binary_function<bool, KStaticGeometryNode*, KStaticGeometryNode*>
+KStaticGeometryPrivate::KStaticGeometryPrivate(KGeometryCloud &parent) :
+  m_root(0), m_maxDepth(0), m_sahCost(0.0f), m_parent(parent),
+  m_method(KStaticGeometry::TopDownMethod), m_pred(0), m_builtSahCost(0.0f),
+  m_rebuildThreshold(sg_defaultRebuildThreshold), m_sourceChecksum(0), m_cacheable(false)
 {
-  KAabbMinCentroidDistance(KStaticGeometryNode const *geom) :
-    m_geom(geom)
-  {
-    // Intentionally Empty
-  }
+  // Intentionally Empty
+}
 
-  bool operator()(const KStaticGeometryNode *lhs, const KStaticGeometryNode *rhs) const
+void KStaticGeometryPrivate::build(KStaticGeometry::BuildMethod method, TerminationPred pred)
+{
+  // Build based on selected method
+  switch (method)
   {
-    return (lhs->aabb.center() - m_geom->aabb.center()).lengthSquared() < (rhs->aabb.center() - m_geom->aabb.center()).lengthSquared();
+  case KStaticGeometry::BottomUpMethod:
+    buildBottomUp(pred);
+    break;
+  case KStaticGeometry::TopDownMethod:
+    buildTopDown(pred);
+    break;
+  case KStaticGeometry::SurfaceAreaMethod:
+    buildSurfaceArea(pred);
+    break;
   }
 
-  KStaticGeometryNode const *m_geom;
-};
+  // Replace the node hierarchy with the depth-first array
+  m_points = m_parent.pointCloud();
+  flatten();
 
-KStaticGeometryPrivate::KStaticGeometryPrivate(KGeometryCloud &parent) :
-  m_parent(parent)
+  // Expected cost of a ray query which hits the root, to compare build methods
+  m_sahCost = computeSahCost();
+  m_builtSahCost = m_sahCost;
+  m_cullingPlanes.assign(m_nodes.size(), 0);
+  m_method = method;
+  m_pred = pred;
+}
+
+void KStaticGeometryPrivate::setLeaf(KStaticGeometryNode *node, TriangleIterator begin, TriangleIterator end)
 {
-  // Intentionally Empty
+  TriangleIterator first = m_parent.triangleIndexCloud().begin();
+  node->from = std::distance(first, begin);
+  node->to = std::distance(first, end);
+}
+
+// Orders triangles along a Morton curve through their centroids.
+template <typename Key, typename Encoder>
+static void sortAlongMortonCurve(std::vector<KVector3D> const &centroids, KVector3D const &min, KVector3D const &scale, std::vector<uint32_t> &order, Encoder encode)
+{
+  std::vector<Key> keys(centroids.size());
+  order.resize(centroids.size());
+  Karma::parallelFor(centroids.size(), 4096, [&](size_t begin, size_t end)
+  {
+    for (size_t i = begin; i < end; ++i)
+    {
+      keys[i] = encode((centroids[i] - min) * scale);
+      order[i] = static_cast<uint32_t>(i);
+    }
+  });
+  Karma::radixSort(keys, order);
+}
+
+static float mergedSurfaceArea(KStaticGeometryNode const *a, KStaticGeometryNode const *b)
+{
+  KVector3D const &aMin = a->aabb.minExtent(), &aMax = a->aabb.maxExtent();
+  KVector3D const &bMin = b->aabb.minExtent(), &bMax = b->aabb.maxExtent();
+  float x = std::max(aMax.x(), bMax.x()) - std::min(aMin.x(), bMin.x());
+  float y = std::max(aMax.y(), bMax.y()) - std::min(aMin.y(), bMin.y());
+  float z = std::max(aMax.z(), bMax.z()) - std::min(aMin.z(), bMin.z());
+  return 2.0f * (x * y + y * z + z * x);
 }
 
 void KStaticGeometryPrivate::buildBottomUp(TerminationPred pred)
@@ -156,60 +484,121 @@ void KStaticGeometryPrivate::buildBottomUp(TerminationPred pred)
   KPointCloud & pointCloud = m_parent.pointCloud();
   KTriangleIndexCloud & triangleCloud = m_parent.triangleIndexCloud();
   typedef std::vector<KStaticGeometryNode*> KStaticGeometryNodeCloud;
-  KStaticGeometryNodeCloud nodes;
   size_t numTriangles = triangleCloud.size();
-  nodes.reserve(numTriangles);
+  m_maxDepth = 0;
+  m_root = 0;
+  if (numTriangles == 0) return;
 
-  size_t leafCount;
-  int depthEstimate;
-  int leafSize = static_cast<int>(numTriangles);
-  do
+  // Centroids, and the bounds which normalize them for quantization
+  std::vector<KVector3D> centroids(numTriangles);
+  Karma::parallelFor(numTriangles, 4096, [&](size_t begin, size_t end)
   {
-    leafCount = numTriangles / leafSize;
-    depthEstimate = std::ceil(std::log(leafSize) / Karma::Log2);
-    leafSize /= 2;
-    if (leafSize == 1) break;
+    for (size_t i = begin; i < end; ++i)
+    {
+      KTriangleIndexCloud::ElementType const &tri = *(triangleCloud.begin() + i);
+      centroids[i] = (pointCloud[tri.indices[0] - 1] + pointCloud[tri.indices[1] - 1] + pointCloud[tri.indices[2] - 1]) / 3.0f;
+    }
+  });
+  KSahBin bounds;
+  for (KVector3D const &c : centroids)
+  {
+    bounds.encompassPoint(c);
   }
-  while (pred(numTriangles / leafSize, depthEstimate));
+  KVector3D extent = bounds.max - bounds.min;
+  KVector3D scale(
+    (extent.x() > 0.0f) ? 1.0f / extent.x() : 0.0f,
+    (extent.y() > 0.0f) ? 1.0f / extent.y() : 0.0f,
+    (extent.z() > 0.0f) ? 1.0f / extent.z() : 0.0f
+  );
 
-  // Initial Construction
-  size_t remaining;
-  KStaticGeometryNode *currNode;
-  TriangleIterator it = triangleCloud.begin();
-  while (it != triangleCloud.cend())
+  // Sort along the curve; 30-bit cells get crowded on large inputs
+  std::vector<uint32_t> order;
+  if (numTriangles <= sg_mortonShortCodeLimit)
+    sortAlongMortonCurve<uint32_t>(centroids, bounds.min, scale, order, Karma::mortonCode30);
+  else
+    sortAlongMortonCurve<uint64_t>(centroids, bounds.min, scale, order, Karma::mortonCode63);
   {
-    remaining = std::distance(it, triangleCloud.end());
-    if (remaining > leafCount)
-      remaining = leafCount;
-    currNode = new KStaticGeometryNode(0, it, it + remaining, pointCloud);
-    nodes.push_back(currNode);
-    std::advance(it, remaining);
+    std::vector<KTriangleIndexCloud::ElementType> sorted(numTriangles);
+    for (size_t i = 0; i < numTriangles; ++i)
+    {
+      sorted[i] = *(triangleCloud.begin() + order[i]);
+    }
+    std::copy(sorted.begin(), sorted.end(), triangleCloud.begin());
   }
 
-  std::vector<KStaticGeometryNode*> working;
+  // Largest leaf the predicate accepts at the depth a balanced tree would put it
+  size_t leafSize = 1;
+  while (leafSize * 2 <= numTriangles)
+  {
+    leafSize *= 2;
+  }
+  while (leafSize > 1)
+  {
+    size_t depthEstimate = static_cast<size_t>(std::ceil(std::log(float(numTriangles) / leafSize) / Karma::Log2));
+    if (pred(leafSize, depthEstimate)) break;
+    leafSize /= 2;
+  }
+
+  // Leaves are consecutive runs of the sorted triangles
+  KStaticGeometryNodeCloud nodes((numTriangles + leafSize - 1) / leafSize);
+  Karma::parallelFor(nodes.size(), 64, [&](size_t begin, size_t end)
+  {
+    for (size_t i = begin; i < end; ++i)
+    {
+      TriangleIterator first = triangleCloud.begin() + i * leafSize;
+      TriangleIterator last = triangleCloud.begin() + std::min(numTriangles, (i + 1) * leafSize);
+      nodes[i] = new KStaticGeometryNode(0, first, last, pointCloud);
+      setLeaf(nodes[i], first, last);
+    }
+  });
+
+  // Locally-ordered clustering: every node looks for the partner within a window
+  // of the curve that gives the smallest bounds, and mutual pairs are merged.
+  KStaticGeometryNodeCloud working;
+  std::vector<size_t> nearest;
   while (nodes.size() != 1)
   {
-    working.reserve(nodes.size() / 2 + 1);
-    KStaticGeometryNodeCloud::iterator it = nodes.begin();
-    while (it != nodes.end())
+    size_t count = nodes.size();
+    nearest.resize(count);
+    Karma::parallelFor(count, 256, [&](size_t begin, size_t end)
     {
-      KAabbMinCentroidDistance distanceCheck(*it);
-      KStaticGeometryNodeCloud::iterator min = std::min_element(it + 1, nodes.end(), distanceCheck);
-      if (min != nodes.end())
+      for (size_t i = begin; i < end; ++i)
       {
-        std::iter_swap(it + 1, min);
-        working.push_back(new KStaticGeometryNode(0, *it, *(it + 1)));
-        std::advance(it, 2);
-      }
-      else
-      {
-        working.push_back(*it);
-        std::advance(it, 1);
+        float best = std::numeric_limits<float>::max();
+        size_t first = (i > sg_plocRadius) ? i - sg_plocRadius : 0;
+        size_t last = std::min(count, i + sg_plocRadius + 1);
+        nearest[i] = (i + 1 < count) ? i + 1 : i - 1;
+        for (size_t j = first; j < last; ++j)
+        {
+          if (j == i) continue;
+          float area = mergedSurfaceArea(nodes[i], nodes[j]);
+          if (area < best)
+          {
+            best = area;
+            nearest[i] = j;
+          }
+        }
       }
+    });
+
+    working.clear();
+    working.reserve(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+      size_t j = nearest[i];
+      if (nearest[j] != i)
+        working.push_back(nodes[i]);
+      else if (i < j)
+        working.push_back(new KStaticGeometryNode(0, nodes[i], nodes[j]));
     }
 
+    // Ties can leave no mutual pair; merging the first two keeps progress
+    if (working.size() == count)
+    {
+      working.erase(working.begin(), working.begin() + 2);
+      working.insert(working.begin(), new KStaticGeometryNode(0, nodes[0], nodes[1]));
+    }
     nodes.swap(working);
-    working.clear();
   }
 
   m_root = nodes[0];
@@ -223,26 +612,36 @@ KStaticGeometryNode *KStaticGeometryPrivate::recursiveTopDown(size_t depth, Tria
   size_t numTriangles = std::distance(begin, end);
 
   if (numTriangles == 0) return 0;
-  if (m_maxDepth < depth) m_maxDepth = depth;
+  Karma::atomicMax(m_maxDepth, depth);
 
   KStaticGeometryNode *node = new KStaticGeometryNode(depth, begin, end, pointCloud);
   if (!pred(numTriangles, depth))
   {
     KVector3D const &maxAxis = node->aabb.maxAxis();
-    TriangleIterator secondHalf = std::partition(begin, end, KTrianglePartitionAlongAxis(pointCloud, node->aabb.center(), maxAxis));
+    TriangleIterator secondHalf = partitionTriangles(begin, end, KTrianglePartitionAlongAxis(pointCloud, node->aabb.center(), maxAxis));
     if (secondHalf == begin || secondHalf == end)
     {
-      node->instance = new KStaticGeometryInstance(begin, end);
+      setLeaf(node, begin, end);
     }
     else
     {
-      node->left  = recursiveTopDown(depth + 1,      begin, secondHalf, pred);
-      node->right = recursiveTopDown(depth + 1, secondHalf,        end, pred);
+      if (numTriangles >= sg_parallelBuildThreshold)
+      {
+        Karma::parallelInvoke(
+          [&]() { node->left  = recursiveTopDown(depth + 1,      begin, secondHalf, pred); },
+          [&]() { node->right = recursiveTopDown(depth + 1, secondHalf,        end, pred); }
+        );
+      }
+      else
+      {
+        node->left  = recursiveTopDown(depth + 1,      begin, secondHalf, pred);
+        node->right = recursiveTopDown(depth + 1, secondHalf,        end, pred);
+      }
     }
   }
   else
   {
-    node->instance = new KStaticGeometryInstance(begin, end);
+    setLeaf(node, begin, end);
   }
 
   return node;
@@ -256,6 +655,622 @@ void KStaticGeometryPrivate::buildTopDown(TerminationPred pred)
   m_root = recursiveTopDown(0, triangleCloud.begin(), triangleCloud.end(), pred);
 }
 
+KStaticGeometryNode *KStaticGeometryPrivate::recursiveSurfaceArea(size_t depth, TriangleIterator begin, TriangleIterator end, TerminationPred pred)
+{
+  KPointCloud const & pointCloud = m_parent.pointCloud();
+  size_t numTriangles = std::distance(begin, end);
+
+  if (numTriangles == 0) return 0;
+  Karma::atomicMax(m_maxDepth, depth);
+
+  KStaticGeometryNode *node = new KStaticGeometryNode(depth, begin, end, pointCloud);
+  if (pred(numTriangles, depth))
+  {
+    setLeaf(node, begin, end);
+    return node;
+  }
+
+  // Bin along the axis where the centroids are most spread out
+  KSahBin centroids;
+  for (TriangleIterator it = begin; it != end; ++it)
+  {
+    KVector3D const &a = pointCloud[it->indices[0] - 1];
+    KVector3D const &b = pointCloud[it->indices[1] - 1];
+    KVector3D const &c = pointCloud[it->indices[2] - 1];
+    centroids.encompassPoint((a + b + c) / 3.0f);
+  }
+  KVector3D spread = centroids.max - centroids.min;
+  KVector3D axis(1.0f, 0.0f, 0.0f);
+  float axisMin = centroids.min.x(), axisMax = centroids.max.x();
+  if (spread.y() > spread.x() && spread.y() >= spread.z())
+  {
+    axis = KVector3D(0.0f, 1.0f, 0.0f);
+    axisMin = centroids.min.y();
+    axisMax = centroids.max.y();
+  }
+  else if (spread.z() > spread.x() && spread.z() > spread.y())
+  {
+    axis = KVector3D(0.0f, 0.0f, 1.0f);
+    axisMin = centroids.min.z();
+    axisMax = centroids.max.z();
+  }
+
+  // All centroids coincide; no split can separate them
+  if (axisMax <= axisMin)
+  {
+    setLeaf(node, begin, end);
+    return node;
+  }
+
+  KSahBin bins[sg_sahBinCount];
+  KTrianglePartitionCentroidBin binning(pointCloud, axis, axisMin, axisMax, sg_sahBinCount, 0);
+  for (TriangleIterator it = begin; it != end; ++it)
+  {
+    KSahBin &bin = bins[binning.bin(*it)];
+    bin.encompassPoint(pointCloud[it->indices[0] - 1]);
+    bin.encompassPoint(pointCloud[it->indices[1] - 1]);
+    bin.encompassPoint(pointCloud[it->indices[2] - 1]);
+    ++bin.count;
+  }
+
+  // Sweep from the right to find the area of every suffix, then from the left to cost each split
+  float rightArea[sg_sahBinCount];
+  KSahBin sweep;
+  for (size_t i = sg_sahBinCount - 1; i > 0; --i)
+  {
+    sweep.encompass(bins[i]);
+    rightArea[i] = sweep.surfaceArea() * sweep.count;
+  }
+  size_t bestSplit = 0;
+  float bestCost = std::numeric_limits<float>::max();
+  sweep = KSahBin();
+  for (size_t i = 1; i < sg_sahBinCount; ++i)
+  {
+    sweep.encompass(bins[i - 1]);
+    if (sweep.count == 0 || sweep.count == numTriangles) continue;
+    float cost = sweep.surfaceArea() * sweep.count + rightArea[i];
+    if (cost < bestCost)
+    {
+      bestCost = cost;
+      bestSplit = i;
+    }
+  }
+
+  // Stop when splitting is expected to cost more than testing every triangle
+  float leafCost = sg_sahIntersectionCost * numTriangles;
+  float splitCost = sg_sahTraversalCost + sg_sahIntersectionCost * bestCost / node->surfaceArea();
+  if (bestSplit == 0 || splitCost >= leafCost)
+  {
+    setLeaf(node, begin, end);
+    return node;
+  }
+
+  KTrianglePartitionCentroidBin partition(pointCloud, axis, axisMin, axisMax, sg_sahBinCount, bestSplit);
+  TriangleIterator secondHalf = partitionTriangles(begin, end, partition);
+  if (numTriangles >= sg_parallelBuildThreshold)
+  {
+    Karma::parallelInvoke(
+      [&]() { node->left  = recursiveSurfaceArea(depth + 1,      begin, secondHalf, pred); },
+      [&]() { node->right = recursiveSurfaceArea(depth + 1, secondHalf,        end, pred); }
+    );
+  }
+  else
+  {
+    node->left  = recursiveSurfaceArea(depth + 1,      begin, secondHalf, pred);
+    node->right = recursiveSurfaceArea(depth + 1, secondHalf,        end, pred);
+  }
+  return node;
+}
+
+void KStaticGeometryPrivate::buildSurfaceArea(TerminationPred pred)
+{
+  m_maxDepth = 0;
+  KTriangleIndexCloud & triangleCloud = m_parent.triangleIndexCloud();
+  m_root = recursiveSurfaceArea(0, triangleCloud.begin(), triangleCloud.end(), pred);
+}
+
+void KStaticGeometryPrivate::flatten()
+{
+  m_nodes.clear();
+  m_triangles.clear();
+  m_triangleIndices.clear();
+  if (!m_root) return;
+  m_triangles.reserve(m_parent.triangleIndexCloud().size());
+  m_triangleIndices.reserve(3 * m_parent.triangleIndexCloud().size());
+  m_maxDepth = 0;
+  flattenNode(m_root, 0);
+  delete m_root;
+  m_root = 0;
+}
+
+uint32_t KStaticGeometryPrivate::flattenNode(KStaticGeometryNode const *node, size_t depth)
+{
+  // A single child covers the same triangles as its parent (And takes its depth)
+  if (!node->isLeaf() && !node->right) return flattenNode(node->left, depth);
+  Karma::atomicMax(m_maxDepth, depth);
+
+  uint32_t index = static_cast<uint32_t>(m_nodes.size());
+  m_nodes.emplace_back();
+  {
+    KStaticGeometryFlatNode &flat = m_nodes.back();
+    KVector3D const &min = node->aabb.minExtent();
+    KVector3D const &max = node->aabb.maxExtent();
+    flat.min[0] = min.x(); flat.min[1] = min.y(); flat.min[2] = min.z();
+    flat.max[0] = max.x(); flat.max[1] = max.y(); flat.max[2] = max.z();
+  }
+
+  if (node->isLeaf())
+  {
+    KPointCloud const &pointCloud = m_parent.pointCloud();
+    KTriangleIndexCloud const &triangleCloud = m_parent.triangleIndexCloud();
+    m_nodes[index].offset = static_cast<uint32_t>(m_triangles.size());
+    m_nodes[index].count = static_cast<uint32_t>(node->to - node->from);
+    for (size_t i = node->from; i < node->to; ++i)
+    {
+      KTriangleIndexCloud::ElementType const &tri = *(triangleCloud.begin() + i);
+      KStaticGeometryTriangle triangle = { pointCloud[tri.indices[0] - 1], pointCloud[tri.indices[1] - 1], pointCloud[tri.indices[2] - 1] };
+      m_triangles.push_back(triangle);
+      m_triangleIndices.push_back(static_cast<uint32_t>(tri.indices[0] - 1));
+      m_triangleIndices.push_back(static_cast<uint32_t>(tri.indices[1] - 1));
+      m_triangleIndices.push_back(static_cast<uint32_t>(tri.indices[2] - 1));
+    }
+  }
+  else
+  {
+    flattenNode(node->left, depth + 1);
+    uint32_t right = flattenNode(node->right, depth + 1);
+    m_nodes[index].offset = right;
+    m_nodes[index].count = 0;
+  }
+  return index;
+}
+
+float KStaticGeometryPrivate::computeSahCost() const
+{
+  if (m_nodes.empty()) return 0.0f;
+  float cost = 0.0f;
+  for (KStaticGeometryFlatNode const &node : m_nodes)
+  {
+    float weight = (node.isLeaf()) ? sg_sahIntersectionCost * node.count : sg_sahTraversalCost;
+    cost += node.surfaceArea() * weight;
+  }
+  float rootArea = m_nodes[0].surfaceArea();
+  return (rootArea > 0.0f) ? cost / rootArea : 0.0f;
+}
+
+// Recomputes the bounds of the subtree [index, end) from its triangles.
+void KStaticGeometryPrivate::refitNode(uint32_t index, uint32_t end)
+{
+  KStaticGeometryFlatNode &node = m_nodes[index];
+  if (node.isLeaf())
+  {
+    KSahBin bounds;
+    for (uint32_t i = node.offset; i < node.offset + node.count; ++i)
+    {
+      bounds.encompassPoint(m_triangles[i].a);
+      bounds.encompassPoint(m_triangles[i].b);
+      bounds.encompassPoint(m_triangles[i].c);
+    }
+    node.min[0] = bounds.min.x(); node.min[1] = bounds.min.y(); node.min[2] = bounds.min.z();
+    node.max[0] = bounds.max.x(); node.max[1] = bounds.max.y(); node.max[2] = bounds.max.z();
+    return;
+  }
+
+  uint32_t left = index + 1, right = node.offset;
+  if (end - index >= sg_parallelRefitThreshold)
+  {
+    Karma::parallelInvoke(
+      [&]() { refitNode(left, right); },
+      [&]() { refitNode(right, end); }
+    );
+  }
+  else
+  {
+    refitNode(left, right);
+    refitNode(right, end);
+  }
+  for (int k = 0; k < 3; ++k)
+  {
+    node.min[k] = std::min(m_nodes[left].min[k], m_nodes[right].min[k]);
+    node.max[k] = std::max(m_nodes[left].max[k], m_nodes[right].max[k]);
+  }
+}
+
+// Builds again from the current world points with the last build's settings.
+void KStaticGeometryPrivate::rebuild()
+{
+  m_parent = KGeometryCloud();
+  KPointCloud &pointCloud = m_parent.pointCloud();
+  KTriangleIndexCloud &triangleCloud = m_parent.triangleIndexCloud();
+  pointCloud = m_points;
+  triangleCloud.reserve(m_triangleIndices.size() / 3);
+  for (size_t i = 0; i < m_triangleIndices.size(); i += 3)
+  {
+    triangleCloud.emplace_back(KTriangleIndexCloud::ElementType(m_triangleIndices[i] + 1, m_triangleIndices[i + 1] + 1, m_triangleIndices[i + 2] + 1));
+  }
+  build(m_method, m_pred);
+  m_parent = KGeometryCloud();
+}
+
+// Leaves are stored depth-first, so a subtree's triangles are contiguous.
+KStaticGeometry::TriangleRange KStaticGeometryPrivate::subtreeTriangles(uint32_t index) const
+{
+  uint32_t first = index, last = index;
+  while (!m_nodes[first].isLeaf()) ++first;
+  while (!m_nodes[last].isLeaf()) last = m_nodes[last].offset;
+  KStaticGeometry::TriangleRange range;
+  range.first = m_nodes[first].offset;
+  range.count = m_nodes[last].offset + m_nodes[last].count - range.first;
+  return range;
+}
+
+void KStaticGeometryPrivate::cull(KFrustum const &frustum, KStaticGeometry::TriangleRangeContainer &visible)
+{
+  if (m_nodes.empty()) return;
+
+  // (Node, Planes the node is not yet known to be inside of)
+  typedef std::pair<uint32_t, int> StackEntry;
+  StackEntry localStack[sg_rayStackSize];
+  std::vector<StackEntry> heapStack;
+  StackEntry *stack = localStack;
+  if (m_maxDepth >= sg_rayStackSize)
+  {
+    heapStack.resize(m_maxDepth + 1);
+    stack = heapStack.data();
+  }
+
+  size_t top = 0;
+  stack[top++] = StackEntry(0, KFrustum::AllPlanes);
+  while (top != 0)
+  {
+    StackEntry entry = stack[--top];
+    KStaticGeometryFlatNode const &node = m_nodes[entry.first];
+    int planeMask = entry.second;
+    if (planeMask != 0)
+    {
+      int firstPlane = m_cullingPlanes[entry.first];
+      KVector3D min(node.min[0], node.min[1], node.min[2]);
+      KVector3D max(node.max[0], node.max[1], node.max[2]);
+      if (!frustum.intersects(min, max, planeMask, firstPlane))
+      {
+        m_cullingPlanes[entry.first] = static_cast<uint8_t>(firstPlane);
+        continue;
+      }
+    }
+
+    // Leaves, and subtrees entirely inside, are visible as a whole
+    if (planeMask == 0 || node.isLeaf())
+    {
+      KStaticGeometry::TriangleRange range = subtreeTriangles(entry.first);
+      if (!visible.empty() && visible.back().first + visible.back().count == range.first)
+        visible.back().count += range.count;
+      else
+        visible.push_back(range);
+      continue;
+    }
+
+    // Right first, so ranges come out in order and neighbours merge
+    stack[top++] = StackEntry(node.offset, planeMask);
+    stack[top++] = StackEntry(entry.first + 1, planeMask);
+  }
+}
+
+void KStaticGeometryPrivate::drawAabbs(KTransform3D &trans, KColor const &color, size_t min, size_t max) const
+{
+  if (m_nodes.empty()) return;
+
+  // (Node, Depth) pairs; the left child is pushed last so it is drawn first
+  typedef std::pair<uint32_t, size_t> StackEntry;
+  std::vector<StackEntry> stack(1, StackEntry(0, 0));
+  KAabbBoundingVolume aabb;
+  Karma::MinMaxKVector3D bounds;
+  while (!stack.empty())
+  {
+    StackEntry entry = stack.back();
+    stack.pop_back();
+    if (entry.second > max) continue;
+
+    KStaticGeometryFlatNode const &node = m_nodes[entry.first];
+    if (entry.second >= min)
+    {
+      bounds.min = KVector3D(node.min[0], node.min[1], node.min[2]);
+      bounds.max = KVector3D(node.max[0], node.max[1], node.max[2]);
+      aabb.setMinMaxBounds(bounds);
+      aabb.draw(trans, Karma::colorShift(color, 0.1f * entry.second));
+    }
+    if (!node.isLeaf())
+    {
+      stack.push_back(StackEntry(node.offset, entry.second + 1));
+      stack.push_back(StackEntry(entry.first + 1, entry.second + 1));
+    }
+  }
+}
+
+bool KStaticGeometryPrivate::readCache(QString const &fileName, KStaticGeometryCacheHeader const &expected, size_t numPoints, size_t numTriangles)
+{
+  // Validate the header against this build and the geometry it should match
+  KCacheFileReader reader(fileName);
+  KStaticGeometryCacheHeader header;
+  if (!reader.readHeader(header, expected) ||
+      header.nodeSize != expected.nodeSize ||
+      header.triangleSize != expected.triangleSize ||
+      header.sourceChecksum != expected.sourceChecksum ||
+      header.method != expected.method ||
+      header.numTriangles != numTriangles)
+  {
+    return false;
+  }
+
+  // Validate the payload size
+  // Note: The element types are trivially copyable, each array is a single copy.
+  if (header.numNodes > std::numeric_limits<uint32_t>::max()) return false;
+  KStaticGeometryFlatNode const *nodes = reader.readSection<KStaticGeometryFlatNode>(header.numNodes);
+  KStaticGeometryTriangle const *triangles = reader.readSection<KStaticGeometryTriangle>(header.numTriangles);
+  uint32_t const *indices = reader.readSection<uint32_t>(3 * header.numTriangles);
+  if (!nodes || !triangles || !indices) return false;
+
+  // Every child and triangle range must stay within the arrays, and every
+  // node but the root must have exactly one parent. The traversal stacks are
+  // sized by the depth of that tree, so it is measured here, not read.
+  static const uint32_t unreached = ~uint32_t(0);
+  std::vector<uint32_t> depths(header.numNodes, unreached);
+  size_t maxDepth = 0;
+  if (header.numNodes > 0) depths[0] = 0;
+  for (size_t i = 0; i < header.numNodes; ++i)
+  {
+    KStaticGeometryFlatNode const &node = nodes[i];
+    if (depths[i] == unreached) return false;
+    if (node.isLeaf())
+    {
+      if (uint64_t(node.offset) + node.count > header.numTriangles) return false;
+      continue;
+    }
+    if (node.offset <= i + 1 || node.offset >= header.numNodes) return false;
+    for (size_t child : { i + 1, size_t(node.offset) })
+    {
+      if (depths[child] != unreached) return false;
+      depths[child] = depths[i] + 1;
+      maxDepth = std::max<size_t>(maxDepth, depths[child]);
+    }
+  }
+  for (size_t i = 0; i < 3 * header.numTriangles; ++i)
+  {
+    if (indices[i] >= numPoints) return false;
+  }
+
+  m_nodes.assign(nodes, nodes + header.numNodes);
+  m_triangles.assign(triangles, triangles + header.numTriangles);
+  m_triangleIndices.assign(indices, indices + 3 * header.numTriangles);
+  m_maxDepth = maxDepth;
+  m_sahCost = m_builtSahCost = header.sahCost;
+  return true;
+}
+
+bool KStaticGeometryPrivate::writeCache(QString const &fileName) const
+{
+  KCacheFileWriter file(fileName);
+  if (!file.valid()) return false;
+
+  KStaticGeometryCacheHeader header = cacheHeader(m_sourceChecksum, m_method);
+  header.depth = static_cast<uint32_t>(m_maxDepth);
+  header.sahCost = m_builtSahCost;
+  header.numNodes = m_nodes.size();
+  header.numTriangles = m_triangles.size();
+
+  file.writeSection(&header, sizeof(KStaticGeometryCacheHeader));
+  file.writeSection(m_nodes.data(), m_nodes.size() * sizeof(KStaticGeometryFlatNode));
+  file.writeSection(m_triangles.data(), m_triangles.size() * sizeof(KStaticGeometryTriangle));
+  file.writeSection(m_triangleIndices.data(), m_triangleIndices.size() * sizeof(uint32_t));
+  return file.commit();
+}
+
+template <bool AnyHit>
+bool KStaticGeometryPrivate::traverse(KRay const &ray, KRayHit *hit) const
+{
+  if (m_nodes.empty()) return false;
+
+  // (Node, Entry distance) pairs, far children deferred while the near one is visited
+  typedef std::pair<uint32_t, float> StackEntry;
+  StackEntry localStack[sg_rayStackSize];
+  std::vector<StackEntry> heapStack;
+  StackEntry *stack = localStack;
+  if (m_maxDepth >= sg_rayStackSize)
+  {
+    heapStack.resize(m_maxDepth + 1);
+    stack = heapStack.data();
+  }
+
+  KVector3D const &o = ray.origin(), &d = ray.direction();
+  float origin[3] = { o.x(), o.y(), o.z() };
+  float invDir[3] = { safeReciprocal(d.x()), safeReciprocal(d.y()), safeReciprocal(d.z()) };
+  float tMin = ray.tMin(), tMax = ray.tMax();
+  size_t closest = m_triangles.size();
+  float closestU = 0.0f, closestV = 0.0f;
+
+  size_t top = 0;
+  float tEntry;
+  if (!rayIntersectsNode(m_nodes[0], origin, invDir, tMin, tMax, tEntry)) return false;
+  stack[top++] = StackEntry(0, tEntry);
+  while (top != 0)
+  {
+    StackEntry entry = stack[--top];
+    if (entry.second > tMax) continue;
+
+    KStaticGeometryFlatNode const *node = &m_nodes[entry.first];
+    while (!node->isLeaf())
+    {
+      uint32_t left = static_cast<uint32_t>(node - m_nodes.data()) + 1;
+      uint32_t right = node->offset;
+      float tLeft, tRight;
+      bool hitLeft = rayIntersectsNode(m_nodes[left], origin, invDir, tMin, tMax, tLeft);
+      bool hitRight = rayIntersectsNode(m_nodes[right], origin, invDir, tMin, tMax, tRight);
+      if (hitLeft && hitRight)
+      {
+        if (tRight < tLeft)
+        {
+          std::swap(left, right);
+          std::swap(tLeft, tRight);
+        }
+        stack[top++] = StackEntry(right, tRight);
+        node = &m_nodes[left];
+      }
+      else if (hitLeft || hitRight)
+      {
+        node = &m_nodes[hitLeft ? left : right];
+      }
+      else
+      {
+        node = 0;
+        break;
+      }
+    }
+    if (!node) continue;
+
+    for (uint32_t i = node->offset; i < node->offset + node->count; ++i)
+    {
+      float t, u, v;
+      if (rayIntersectsTriangle(m_triangles[i], ray, tMin, tMax, t, u, v))
+      {
+        if (AnyHit) return true;
+        tMax = t;
+        closest = i;
+        closestU = u;
+        closestV = v;
+      }
+    }
+  }
+
+  if (closest == m_triangles.size()) return false;
+  if (hit)
+  {
+    hit->triangle = closest;
+    hit->distance = tMax;
+    hit->u = closestU;
+    hit->v = closestV;
+    hit->normal = triangleNormal(m_triangles[closest]);
+  }
+  return true;
+}
+
+template <bool AnyHit>
+int KStaticGeometryPrivate::traversePacket(KRay const *rays, KRayHit *hits) const
+{
+  static const int AllLanes = (1 << KStaticGeometry::PacketSize) - 1;
+  if (m_nodes.empty()) return 0;
+
+  uint32_t localStack[sg_rayStackSize];
+  std::vector<uint32_t> heapStack;
+  uint32_t *stack = localStack;
+  if (m_maxDepth >= sg_rayStackSize)
+  {
+    heapStack.resize(m_maxDepth + 1);
+    stack = heapStack.data();
+  }
+
+  // Transpose the rays into lanes
+  float lanes[9][KStaticGeometry::PacketSize], tMinLanes[KStaticGeometry::PacketSize], tMaxLanes[KStaticGeometry::PacketSize];
+  for (size_t r = 0; r < KStaticGeometry::PacketSize; ++r)
+  {
+    KVector3D const &o = rays[r].origin(), &d = rays[r].direction();
+    lanes[0][r] = o.x(); lanes[1][r] = o.y(); lanes[2][r] = o.z();
+    lanes[3][r] = d.x(); lanes[4][r] = d.y(); lanes[5][r] = d.z();
+    lanes[6][r] = safeReciprocal(d.x()); lanes[7][r] = safeReciprocal(d.y()); lanes[8][r] = safeReciprocal(d.z());
+    tMinLanes[r] = rays[r].tMin();
+    tMaxLanes[r] = rays[r].tMax();
+  }
+  KRayPacket packet;
+  for (int k = 0; k < 3; ++k)
+  {
+    packet.origin[k] = KFloat4::load(lanes[k]);
+    packet.direction[k] = KFloat4::load(lanes[3 + k]);
+    packet.invDir[k] = KFloat4::load(lanes[6 + k]);
+  }
+  packet.tMin = KFloat4::load(tMinLanes);
+  packet.tMax = KFloat4::load(tMaxLanes);
+
+  uint32_t closest[KStaticGeometry::PacketSize];
+  std::fill(closest, closest + KStaticGeometry::PacketSize, static_cast<uint32_t>(m_triangles.size()));
+  KFloat4 closestU, closestV;
+  int found = 0;
+
+  size_t top = 0;
+  stack[top++] = 0;
+  while (top != 0)
+  {
+    uint32_t index = stack[--top];
+    KStaticGeometryFlatNode const &node = m_nodes[index];
+    int active = packetIntersectsNode(node, packet).mask();
+    if (active == 0) continue;
+
+    if (!node.isLeaf())
+    {
+      // Visit first the child which lies ahead along the first active ray
+      int lane = 0;
+      while (!(active & (1 << lane))) ++lane;
+      KStaticGeometryFlatNode const &left = m_nodes[index + 1];
+      KStaticGeometryFlatNode const &right = m_nodes[node.offset];
+      float ahead = 0.0f;
+      for (int k = 0; k < 3; ++k)
+      {
+        ahead += (right.min[k] + right.max[k] - left.min[k] - left.max[k]) * lanes[3 + k][lane];
+      }
+      if (ahead >= 0.0f)
+      {
+        stack[top++] = node.offset;
+        stack[top++] = index + 1;
+      }
+      else
+      {
+        stack[top++] = index + 1;
+        stack[top++] = node.offset;
+      }
+      continue;
+    }
+
+    for (uint32_t i = node.offset; i < node.offset + node.count; ++i)
+    {
+      KFloat4 t, u, v;
+      KFloat4 hit = packetIntersectsTriangle(m_triangles[i], packet, t, u, v);
+      int mask = hit.mask();
+      if (mask == 0) continue;
+      found |= mask;
+
+      // Finished lanes get an empty interval so no further node or triangle accepts them
+      if (AnyHit)
+      {
+        if (found == AllLanes) return found;
+        packet.tMax = KFloat4::select(hit, KFloat4(-std::numeric_limits<float>::max()), packet.tMax);
+        continue;
+      }
+      packet.tMax = KFloat4::select(hit, t, packet.tMax);
+      closestU = KFloat4::select(hit, u, closestU);
+      closestV = KFloat4::select(hit, v, closestV);
+      for (size_t r = 0; r < KStaticGeometry::PacketSize; ++r)
+      {
+        if (mask & (1 << r)) closest[r] = i;
+      }
+    }
+  }
+
+  if (!AnyHit && hits)
+  {
+    float distance[KStaticGeometry::PacketSize], u[KStaticGeometry::PacketSize], v[KStaticGeometry::PacketSize];
+    packet.tMax.store(distance);
+    closestU.store(u);
+    closestV.store(v);
+    for (size_t r = 0; r < KStaticGeometry::PacketSize; ++r)
+    {
+      if (!(found & (1 << r))) continue;
+      hits[r].triangle = closest[r];
+      hits[r].distance = distance[r];
+      hits[r].u = u[r];
+      hits[r].v = v[r];
+      hits[r].normal = triangleNormal(m_triangles[closest[r]]);
+    }
+  }
+  return found;
+}
+
 /*******************************************************************************
  * KStaticGeometry
  ******************************************************************************/
@@ -270,6 +1285,30 @@ KStaticGeometry::~KStaticGeometry()
   // Intentionally Empty
 }
 
+size_t KStaticGeometry::addGeometry(KHalfEdgeMesh const &mesh)
+{
+  return addGeometry(mesh, KTransform3D());
+}
+
+// Returns the id of the geometry for setTransform(), valid after the next build().
+size_t KStaticGeometry::addGeometry(KHalfEdgeMesh const &mesh, KTransform3D const &trans)
+{
+  P(KStaticGeometryPrivate);
+  KStaticGeometryRange range;
+  range.firstPoint = pointCloud().size();
+  range.numPoints = mesh.vertices().size();
+  range.transform = trans.toMatrix();
+  range.dirty = false;
+  p.m_pendingGeometries.push_back(range);
+  p.m_pendingPoints.reserve(p.m_pendingPoints.size() + range.numPoints);
+  for (KHalfEdgeMesh::Vertex const &v : mesh.vertices())
+  {
+    p.m_pendingPoints.emplace_back(v.position);
+  }
+  KGeometryCloud::addGeometry(mesh, trans);
+  return p.m_pendingGeometries.size() - 1;
+}
+
 void KStaticGeometry::build(BuildMethod method, TerminationPred pred)
 {
   P(KStaticGeometryPrivate);
@@ -277,25 +1316,78 @@ void KStaticGeometry::build(BuildMethod method, TerminationPred pred)
   // If there is no new geometry to build, do nothing.
   if (!dirty()) return;
 
-  // Build based on selected method
-  switch (method)
-  {
-  case BottomUpMethod:
-    p.buildBottomUp(pred);
-    break;
-  case TopDownMethod:
-    p.buildTopDown(pred);
-    break;
-  }
+  // Geometry added since the last build replaces the previous contents
+  p.m_sourceChecksum = checksum();
+  p.m_cacheable = true;
+  p.m_parent = *this;
+  p.m_localPoints = p.m_pendingPoints;
+  p.m_geometries.swap(p.m_pendingGeometries);
+  p.m_pendingPoints.clear();
+  p.m_pendingGeometries.clear();
+  p.build(method, pred);
 
   // We no longer need this data
   KGeometryCloud::clear();
+  p.m_parent = *this;
+}
 
-  // Next: Depth-first search to find all leaf nodes.
-  //       Form an index buffer of all contiguous leaf nodes.
-  //       As we iterate through, update the parent nodes so they
-  //       understand the "drawable range" of the children.
+KGeometryCloud::Statistics KStaticGeometry::statistics() const
+{
+  P(const KStaticGeometryPrivate);
+  Statistics stats;
+  stats.nodes = p.m_nodes.size();
+  stats.depth = p.m_maxDepth;
+  stats.sahCost = p.m_sahCost;
+  for (KStaticGeometryFlatNode const &node : p.m_nodes)
+  {
+    if (node.isLeaf()) stats.addLeaf(node.count);
+  }
+  stats.memory =
+    p.m_nodes.size() * sizeof(KStaticGeometryFlatNode) +
+    p.m_triangles.size() * sizeof(KStaticGeometryTriangle) +
+    p.m_triangleIndices.size() * sizeof(uint32_t) +
+    (p.m_points.size() + p.m_localPoints.size()) * sizeof(KVector3D) +
+    p.m_geometries.size() * sizeof(KStaticGeometryRange) +
+    p.m_cullingPlanes.size() * sizeof(uint8_t);
+  return stats;
+}
 
+// Writes the built tree, including the leaf ordered triangles and indices, so
+// load() can skip construction. Fails once refit() has moved any geometry.
+bool KStaticGeometry::save(QString const &fileName) const
+{
+  P(const KStaticGeometryPrivate);
+  if (!p.m_cacheable) return false;
+  return p.writeCache(fileName);
+}
+
+// Use in place of build() with the same geometry added; returns false (and
+// changes nothing) unless the file was saved from identical geometry and method.
+// Note: The termination predicate cannot be verified, version the file name by it.
+bool KStaticGeometry::load(QString const &fileName, BuildMethod method, TerminationPred pred)
+{
+  P(KStaticGeometryPrivate);
+  if (!dirty()) return false;
+  uint64_t sourceChecksum = checksum();
+  if (!p.readCache(fileName, cacheHeader(sourceChecksum, method), pointCloud().size(), triangleIndexCloud().size()))
+  {
+    return false;
+  }
+
+  // Same as build(), with the hierarchy taken from the file
+  p.m_localPoints = p.m_pendingPoints;
+  p.m_geometries.swap(p.m_pendingGeometries);
+  p.m_pendingPoints.clear();
+  p.m_pendingGeometries.clear();
+  p.m_points = pointCloud();
+  p.m_cullingPlanes.assign(p.m_nodes.size(), 0);
+  p.m_method = method;
+  p.m_pred = pred;
+  p.m_sourceChecksum = sourceChecksum;
+  p.m_cacheable = true;
+  KGeometryCloud::clear();
+  p.m_parent = *this;
+  return true;
 }
 
 void KStaticGeometry::clear()
@@ -310,6 +1402,12 @@ size_t KStaticGeometry::depth() const
   return p.m_maxDepth;
 }
 
+float KStaticGeometry::sahCost() const
+{
+  P(const KStaticGeometryPrivate);
+  return p.m_sahCost;
+}
+
 void KStaticGeometry::drawAabbs(KTransform3D &trans, const KColor &color)
 {
   drawAabbs(trans, color, 0);
@@ -317,12 +1415,138 @@ void KStaticGeometry::drawAabbs(KTransform3D &trans, const KColor &color)
 
 void KStaticGeometry::drawAabbs(KTransform3D &trans, const KColor &color, size_t min)
 {
-  P(KStaticGeometryPrivate);
-  p.m_root->drawAabb(trans, color, min, std::numeric_limits<size_t>::max());
+  drawAabbs(trans, color, min, std::numeric_limits<size_t>::max());
 }
 
 void KStaticGeometry::drawAabbs(KTransform3D &trans, const KColor &color, size_t min, size_t max)
+{
+  P(const KStaticGeometryPrivate);
+  p.drawAabbs(trans, color, min, max);
+}
+
+size_t KStaticGeometry::triangleCount() const
+{
+  P(const KStaticGeometryPrivate);
+  return p.m_triangles.size();
+}
+
+bool KStaticGeometry::intersect(KRay const &ray, KRayHit &hit) const
+{
+  P(const KStaticGeometryPrivate);
+  return p.traverse<false>(ray, &hit);
+}
+
+bool KStaticGeometry::occluded(KRay const &ray) const
+{
+  P(const KStaticGeometryPrivate);
+  return p.traverse<true>(ray, 0);
+}
+
+// Rays are processed PacketSize at a time; returns a bit per ray which hit.
+int KStaticGeometry::intersectPacket(KRay const *rays, KRayHit *hits) const
+{
+  P(const KStaticGeometryPrivate);
+  return p.traversePacket<false>(rays, hits);
+}
+
+int KStaticGeometry::occludedPacket(KRay const *rays) const
+{
+  P(const KStaticGeometryPrivate);
+  return p.traversePacket<true>(rays, 0);
+}
+
+size_t KStaticGeometry::geometryCount() const
+{
+  P(const KStaticGeometryPrivate);
+  return p.m_geometries.size();
+}
+
+// Takes effect on the next refit().
+void KStaticGeometry::setTransform(size_t geometry, KTransform3D const &trans)
+{
+  P(KStaticGeometryPrivate);
+  if (geometry >= p.m_geometries.size())
+  {
+    qFatal("Invalid geometry passed to KStaticGeometry::setTransform()!");
+  }
+  p.m_geometries[geometry].transform = trans.toMatrix();
+  p.m_geometries[geometry].dirty = true;
+}
+
+// Refits trigger a rebuild once sahCost() exceeds the built cost by this factor.
+void KStaticGeometry::setRebuildThreshold(float threshold)
+{
+  P(KStaticGeometryPrivate);
+  p.m_rebuildThreshold = threshold;
+}
+
+float KStaticGeometry::rebuildThreshold() const
+{
+  P(const KStaticGeometryPrivate);
+  return p.m_rebuildThreshold;
+}
+
+// Moves the triangles of every transformed geometry and recomputes the bounds
+// while keeping the tree's topology. Returns true if the tree degraded past
+// the rebuild threshold and was built again instead.
+bool KStaticGeometry::refit()
+{
+  P(KStaticGeometryPrivate);
+  std::vector<size_t> changed;
+  for (size_t i = 0; i < p.m_geometries.size(); ++i)
+  {
+    if (p.m_geometries[i].dirty) changed.push_back(i);
+  }
+  if (changed.empty() || p.m_nodes.empty()) return false;
+  p.m_cacheable = false;
+
+  // Re-transform the points of the changed geometry
+  Karma::parallelFor(changed.size(), 1, [&](size_t begin, size_t end)
+  {
+    for (size_t i = begin; i < end; ++i)
+    {
+      KStaticGeometryRange &range = p.m_geometries[changed[i]];
+      for (size_t v = range.firstPoint; v < range.firstPoint + range.numPoints; ++v)
+      {
+        p.m_points[v] = range.transform * p.m_localPoints[v];
+      }
+      range.dirty = false;
+    }
+  });
+
+  // Gather the triangles again and fit the bounds bottom-up
+  Karma::parallelFor(p.m_triangles.size(), 4096, [&](size_t begin, size_t end)
+  {
+    for (size_t i = begin; i < end; ++i)
+    {
+      KStaticGeometryTriangle &triangle = p.m_triangles[i];
+      triangle.a = p.m_points[p.m_triangleIndices[3 * i + 0]];
+      triangle.b = p.m_points[p.m_triangleIndices[3 * i + 1]];
+      triangle.c = p.m_points[p.m_triangleIndices[3 * i + 2]];
+    }
+  });
+  p.refitNode(0, static_cast<uint32_t>(p.m_nodes.size()));
+
+  p.m_sahCost = p.computeSahCost();
+  if (p.m_builtSahCost > 0.0f && p.m_sahCost > p.m_builtSahCost * p.m_rebuildThreshold)
+  {
+    p.rebuild();
+    return true;
+  }
+  return false;
+}
+
+// Point indices (0-based, in addGeometry() order) of every triangle in leaf order.
+std::vector<uint32_t> const &KStaticGeometry::triangleIndices() const
+{
+  P(const KStaticGeometryPrivate);
+  return p.m_triangleIndices;
+}
+
+// Collects the triangles within the frustum as merged ranges of the leaf order.
+void KStaticGeometry::cull(KFrustum const &frustum, TriangleRangeContainer &visible)
 {
   P(KStaticGeometryPrivate);
-  p.m_root->drawAabb(trans, color, min, max);
+  visible.clear();
+  p.cull(frustum, visible);
 }
@@ -2,9 +2,15 @@
 #define KSTATICGEOMETRY_H KStaticGeometry
 
 class KColor;
+class KFrustum;
 class KHalfEdgeMesh;
+class KRay;
 class KTransform3D;
+class QString;
+struct KRayHit;
 #include <cstddef>
+#include <cstdint>
+#include <vector>
 #include <KGeometryCloud>
 #include <KSharedPointer>
 
@@ -15,12 +21,45 @@ public:
   KStaticGeometry();
   ~KStaticGeometry();
 
+  // Consecutive triangles of the leaf order (See triangleIndices())
+  struct TriangleRange
+  {
+    size_t first;
+    size_t count;
+  };
+  typedef std::vector<TriangleRange> TriangleRangeContainer;
+
+  size_t addGeometry(KHalfEdgeMesh const &mesh);
+  size_t addGeometry(KHalfEdgeMesh const &mesh, KTransform3D const &trans);
   void clear();
   size_t depth() const;
+  float sahCost() const;
   void build(BuildMethod method, TerminationPred pred);
+  Statistics statistics() const;
   void drawAabbs(KTransform3D &trans, KColor const &color);
   void drawAabbs(KTransform3D &trans, KColor const &color, size_t min);
   void drawAabbs(KTransform3D &trans, KColor const &color, size_t min, size_t max);
+  bool save(QString const &fileName) const;
+  bool load(QString const &fileName, BuildMethod method, TerminationPred pred);
+
+  // Ray Queries
+  static const size_t PacketSize = 4;
+  size_t triangleCount() const;
+  bool intersect(KRay const &ray, KRayHit &hit) const;
+  bool occluded(KRay const &ray) const;
+  int intersectPacket(KRay const *rays, KRayHit *hits) const;
+  int occludedPacket(KRay const *rays) const;
+
+  // Refitting (Geometry is addressed by the id addGeometry() returned)
+  size_t geometryCount() const;
+  void setTransform(size_t geometry, KTransform3D const &trans);
+  void setRebuildThreshold(float threshold);
+  float rebuildThreshold() const;
+  bool refit();
+
+  // Frustum Culling
+  std::vector<uint32_t> const &triangleIndices() const;
+  void cull(KFrustum const &frustum, TriangleRangeContainer &visible);
 
 private:
   KSharedPointer<KStaticGeometryPrivate> m_private;
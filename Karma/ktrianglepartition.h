@@ -6,6 +6,7 @@
 #include <KTriangleIndexCloud>
 #include <KAabbBoundingVolume>
 #include <KPlane>
+#include <algorithm>
 
 /*******************************************************************************
  * KTrianglePartition
@@ -56,6 +57,42 @@ protected:
   float m_midDot;
 };
 
+/*******************************************************************************
+ * KTrianglePartitionCentroidBin
+ ******************************************************************************/
+class KTrianglePartitionCentroidBin : KTrianglePartition
+{
+public:
+
+  // Splits [min, max) of the centroids along axis into bins equal intervals,
+  // and accepts triangles whose centroid falls in a bin before split.
+  KTrianglePartitionCentroidBin(KPointCloud const &cloud, KVector3D const &axis, float min, float max, size_t bins, size_t split) :
+    KTrianglePartition(cloud), m_axis(axis), m_min(min), m_scale(bins * (1.0f - 1e-6f) / (max - min)), m_bins(bins), m_split(split)
+  {
+    // Intentionally Empty
+  }
+
+  size_t bin(ElementType const &tri) const
+  {
+    float centroid = KVector3D::dotProduct(point(tri.indices[0]) + point(tri.indices[1]) + point(tri.indices[2]), m_axis) / 3.0f;
+    float offset = (centroid - m_min) * m_scale;
+    if (offset <= 0.0f) return 0;
+    return std::min(static_cast<size_t>(offset), m_bins - 1);
+  }
+
+  bool operator()(ElementType const &tri) const
+  {
+    return bin(tri) < m_split;
+  }
+
+protected:
+  KVector3D m_axis;
+  float m_min;
+  float m_scale;
+  size_t m_bins;
+  size_t m_split;
+};
+
 /*******************************************************************************
  * KTrianglePartitionInsideAabb
  ******************************************************************************/
@@ -0,0 +1,175 @@
+#include "kvertexcache.h"
+
+#include <algorithm>
+#include <vector>
+
+/*******************************************************************************
+ * Tipsify Helpers
+ ******************************************************************************/
+
+static const uint32_t sg_invalidVertex = ~0u;
+
+// Triangles adjacent to each vertex, stored as a compressed array.
+struct TriangleAdjacency
+{
+  TriangleAdjacency(uint32_t const *indices, size_t indexCount, size_t vertexCount);
+  std::vector<uint32_t> m_offsets;
+  std::vector<uint32_t> m_triangles;
+};
+
+TriangleAdjacency::TriangleAdjacency(uint32_t const *indices, size_t indexCount, size_t vertexCount) :
+  m_offsets(vertexCount + 1, 0), m_triangles(indexCount)
+{
+  for (size_t i = 0; i < indexCount; ++i)
+  {
+    ++m_offsets[indices[i] + 1];
+  }
+  for (size_t v = 0; v < vertexCount; ++v)
+  {
+    m_offsets[v + 1] += m_offsets[v];
+  }
+  std::vector<uint32_t> fill(m_offsets.begin(), m_offsets.end() - 1);
+  for (size_t i = 0; i < indexCount; ++i)
+  {
+    m_triangles[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+  }
+}
+
+static uint32_t skipDeadEnd(std::vector<uint32_t> const &live, std::vector<uint32_t> &deadEnd, size_t &cursor)
+{
+  // Recently touched vertices first
+  while (!deadEnd.empty())
+  {
+    uint32_t v = deadEnd.back();
+    deadEnd.pop_back();
+    if (live[v] > 0) return v;
+  }
+
+  // Otherwise the next vertex in input order with triangles left
+  while (cursor < live.size())
+  {
+    if (live[cursor] > 0) return static_cast<uint32_t>(cursor);
+    ++cursor;
+  }
+  return sg_invalidVertex;
+}
+
+/*******************************************************************************
+ * Public Interface
+ ******************************************************************************/
+
+void Karma::optimizeVertexCache(uint32_t *indices, size_t indexCount, size_t vertexCount, size_t cacheSize)
+{
+  if (indexCount < 3 || vertexCount == 0) return;
+  size_t triangleCount = indexCount / 3;
+
+  TriangleAdjacency adjacency(indices, indexCount, vertexCount);
+  std::vector<uint32_t> live(vertexCount);
+  for (size_t v = 0; v < vertexCount; ++v)
+  {
+    live[v] = adjacency.m_offsets[v + 1] - adjacency.m_offsets[v];
+  }
+
+  std::vector<uint32_t> output;
+  std::vector<uint32_t> deadEnd;
+  std::vector<uint32_t> candidates;
+  std::vector<size_t> cacheTime(vertexCount, 0);
+  std::vector<bool> emitted(triangleCount, false);
+  output.reserve(indexCount);
+  size_t time = cacheSize + 1;
+  size_t cursor = 0;
+
+  uint32_t fanning = skipDeadEnd(live, deadEnd, cursor);
+  while (fanning != sg_invalidVertex)
+  {
+    // Emit every remaining triangle around the fanning vertex
+    candidates.clear();
+    for (uint32_t a = adjacency.m_offsets[fanning]; a < adjacency.m_offsets[fanning + 1]; ++a)
+    {
+      uint32_t t = adjacency.m_triangles[a];
+      if (emitted[t]) continue;
+      for (size_t k = 0; k < 3; ++k)
+      {
+        uint32_t v = indices[3 * t + k];
+        output.push_back(v);
+        deadEnd.push_back(v);
+        candidates.push_back(v);
+        --live[v];
+        if (time - cacheTime[v] > cacheSize)
+        {
+          cacheTime[v] = time;
+          ++time;
+        }
+      }
+      emitted[t] = true;
+    }
+
+    // Choose the candidate which stays in the cache after its triangles are
+    // emitted; if none would, fall back to the dead-end stack (Tipsify).
+    uint32_t next = sg_invalidVertex;
+    size_t best = 0;
+    for (uint32_t v : candidates)
+    {
+      if (live[v] == 0) continue;
+      size_t priority = 0;
+      if (time - cacheTime[v] + 2 * live[v] <= cacheSize)
+      {
+        priority = time - cacheTime[v];
+      }
+      if (priority > best)
+      {
+        best = priority;
+        next = v;
+      }
+    }
+    fanning = (best > 0) ? next : skipDeadEnd(live, deadEnd, cursor);
+  }
+
+  std::copy(output.begin(), output.end(), indices);
+}
+
+size_t Karma::optimizeVertexFetch(uint32_t *remap, uint32_t *indices, size_t indexCount, size_t vertexCount)
+{
+  std::fill(remap, remap + vertexCount, sg_invalidVertex);
+  uint32_t next = 0;
+  for (size_t i = 0; i < indexCount; ++i)
+  {
+    uint32_t &mapped = remap[indices[i]];
+    if (mapped == sg_invalidVertex)
+    {
+      mapped = next++;
+    }
+    indices[i] = mapped;
+  }
+  return next;
+}
+
+Karma::VertexCacheStatistics Karma::analyzeVertexCache(uint32_t const *indices, size_t indexCount, size_t vertexCount, size_t cacheSize)
+{
+  // Note: A vertex is resident while fewer than cacheSize misses happened since it entered.
+  std::vector<size_t> entered(vertexCount, 0);
+  std::vector<bool> referenced(vertexCount, false);
+  size_t misses = 0;
+  size_t unique = 0;
+  for (size_t i = 0; i < indexCount; ++i)
+  {
+    uint32_t v = indices[i];
+    if (!referenced[v])
+    {
+      referenced[v] = true;
+      ++unique;
+      entered[v] = ++misses;
+    }
+    else if (misses - entered[v] >= cacheSize)
+    {
+      entered[v] = ++misses;
+    }
+  }
+
+  VertexCacheStatistics stats;
+  size_t triangles = indexCount / 3;
+  stats.transforms = misses;
+  stats.acmr = (triangles) ? float(misses) / triangles : 0.0f;
+  stats.atvr = (unique) ? float(misses) / unique : 0.0f;
+  return stats;
+}
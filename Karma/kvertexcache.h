@@ -0,0 +1,32 @@
+#ifndef KVERTEXCACHE_H
+#define KVERTEXCACHE_H KVertexCache
+
+#include <cstddef>
+#include <cstdint>
+
+namespace Karma
+{
+
+  // Results of simulating a FIFO post-transform vertex cache.
+  //   ACMR: Vertex transforms per triangle (0.5 is ideal for large meshes, 3.0 is worst)
+  //   ATVR: Vertex transforms per referenced vertex (1.0 is ideal)
+  struct VertexCacheStatistics
+  {
+    size_t transforms;
+    float acmr;
+    float atvr;
+  };
+
+  // Reorders triangles in-place for a post-transform cache (Tipsify, Sander et al. 2007).
+  void optimizeVertexCache(uint32_t *indices, size_t indexCount, size_t vertexCount, size_t cacheSize = 16);
+
+  // Renumbers vertices in order of first use; remap[old] = new (~0u if unreferenced).
+  // Indices are rewritten in-place. Returns the number of referenced vertices.
+  size_t optimizeVertexFetch(uint32_t *remap, uint32_t *indices, size_t indexCount, size_t vertexCount);
+
+  // Simulates a FIFO cache of cacheSize entries over a triangle list.
+  VertexCacheStatistics analyzeVertexCache(uint32_t const *indices, size_t indexCount, size_t vertexCount, size_t cacheSize = 16);
+
+}
+
+#endif // KVERTEXCACHE_H
@@ -0,0 +1,34 @@
+#-------------------------------------------------
+#
+# Headless benchmarks, results are written as JSON
+#
+#-------------------------------------------------
+
+TEMPLATE  = app
+CONFIG   += console
+CONFIG   -= app_bundle
+QT       += core gui widgets
+TARGET    = KarmaBench
+include(../config.pri)
+
+LIBS += $${KARMA_LIB}
+LIBS += $${OPENGL_LIB}
+LIBS += $${QTBASEEXT_LIB}
+
+PRE_TARGETDEPS += $${KARMA_DEP}
+PRE_TARGETDEPS += $${OPENGL_DEP}
+PRE_TARGETDEPS += $${QTBASEEXT_DEP}
+
+SOURCES += \
+    main.cpp \
+    benchmark.cpp \
+    objlexerbenchmark.cpp \
+    geometrybenchmark.cpp \
+    cullingbenchmark.cpp \
+    eigenbenchmark.cpp
+
+HEADERS += \
+    benchmark.h
+
+RESOURCES += \
+    ../resources.qrc
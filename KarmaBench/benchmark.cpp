@@ -0,0 +1,33 @@
+#include "benchmark.h"
+
+#include <cstdio>
+#include <KMatrix4x4>
+
+static size_t sg_failures = 0;
+
+BenchmarkOptions::BenchmarkOptions() :
+  repeat(3), syntheticTriangles(size_t(1) << 20), bspTriangleLimit(size_t(1) << 14),
+  rays(size_t(1) << 18), frusta(256), instances(100000), matrices(size_t(1) << 18), objBytes(size_t(32) << 20)
+{
+  // Intentionally Empty
+}
+
+KFrustum benchmarkFrustum(KVector3D const &eye, KVector3D const &target, float farDistance)
+{
+  KMatrix4x4 projection;
+  projection.perspective(60.0f, 16.0f / 9.0f, 0.1f, farDistance * 1.01f);
+  KMatrix4x4 view;
+  view.lookAt(eye, target, KVector3D(0.0f, 1.0f, 0.0f));
+  return KFrustum(projection * view);
+}
+
+void benchmarkFailed(char const *check, size_t mismatches)
+{
+  std::fprintf(stderr, "%s: %zu mismatches\n", check, mismatches);
+  ++sg_failures;
+}
+
+size_t benchmarkFailures()
+{
+  return sg_failures;
+}
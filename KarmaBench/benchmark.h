@@ -0,0 +1,64 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H Benchmark
+
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QStringList>
+#include <KElapsedTimer>
+#include <KFrustum>
+#include <KVector3D>
+
+// Settings shared by every benchmark (See main.cpp for the command line)
+struct BenchmarkOptions
+{
+  BenchmarkOptions();
+  size_t repeat;              // Timed runs per measurement; the fastest is reported
+  size_t syntheticTriangles;  // Triangles in each synthetic cloud
+  size_t bspTriangleLimit;    // KBspTree is skipped for larger inputs
+  size_t rays;
+  size_t frusta;
+  size_t instances;
+  size_t matrices;            // Symmetric matrices per eigensolver benchmark
+  size_t objBytes;            // Generated OBJ text per statement kind
+  QStringList meshes;         // OBJ files loaded in addition to the synthetic clouds
+};
+
+// Benchmarks (Each returns its section of the report)
+QJsonArray benchmarkObjLexer(BenchmarkOptions const &options);
+QJsonArray benchmarkGeometry(BenchmarkOptions const &options);
+QJsonObject benchmarkCulling(BenchmarkOptions const &options);
+QJsonArray benchmarkEigen(BenchmarkOptions const &options);
+
+// Correctness checks run alongside the timings; main() exits with an error
+// once any check has failed.
+void benchmarkFailed(char const *check, size_t mismatches);
+size_t benchmarkFailures();
+
+// Perspective view from eye towards target which reaches just past farDistance.
+KFrustum benchmarkFrustum(KVector3D const &eye, KVector3D const &target, float farDistance);
+
+// Fastest of repeat runs of func(), in milliseconds.
+template <typename Func>
+double bestOf(size_t repeat, Func func)
+{
+  double best = std::numeric_limits<double>::max();
+  for (size_t i = 0; i < std::max<size_t>(repeat, 1); ++i)
+  {
+    KElapsedTimer timer;
+    timer.start();
+    func();
+    best = std::min(best, timer.nsecsElapsed() / 1.0e6);
+  }
+  return best;
+}
+
+// Millions of operations per second.
+inline double throughput(size_t count, double milliseconds)
+{
+  return (milliseconds > 0.0) ? count / (milliseconds * 1.0e3) : 0.0;
+}
+
+#endif // BENCHMARK_H
@@ -0,0 +1,184 @@
+#include "benchmark.h"
+
+#include <bitset>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
+#include <KAabbBoundingVolume>
+#include <KLooseOctree>
+
+/*******************************************************************************
+ * Culling Benchmark
+ ******************************************************************************/
+// Boxes of mixed sizes scattered through a world the size of a scene's octree.
+struct BenchmarkBoxes
+{
+  std::vector<KVector3D> min, max;
+};
+
+static BenchmarkBoxes randomBoxes(size_t count, float extent, unsigned seed)
+{
+  std::mt19937 random(seed);
+  std::uniform_real_distribution<float> position(-extent, extent);
+  std::exponential_distribution<float> size(0.5f);
+  BenchmarkBoxes boxes;
+  boxes.min.reserve(count);
+  boxes.max.reserve(count);
+  for (size_t i = 0; i < count; ++i)
+  {
+    KVector3D center(position(random), position(random), position(random));
+    float half = 0.5f + size(random);
+    KVector3D offset(half, half, half);
+    boxes.min.push_back(center - offset);
+    boxes.max.push_back(center + offset);
+  }
+  return boxes;
+}
+
+static std::vector<KFrustum> randomFrusta(size_t count, float extent)
+{
+  std::mt19937 random(6);
+  std::uniform_real_distribution<float> position(-extent, extent);
+  std::vector<KFrustum> frusta;
+  frusta.reserve(count);
+  for (size_t i = 0; i < count; ++i)
+  {
+    KVector3D eye(position(random), position(random), position(random));
+    KVector3D target(position(random), position(random), position(random));
+    frusta.push_back(benchmarkFrustum(eye, target, 0.5f * extent));
+  }
+  return frusta;
+}
+
+QJsonObject benchmarkCulling(BenchmarkOptions const &options)
+{
+  static const float Extent = 2048.0f;
+  size_t count = options.instances;
+  BenchmarkBoxes boxes = randomBoxes(count, Extent, 7);
+  BenchmarkBoxes moved = randomBoxes(count, Extent, 8);
+  std::vector<KFrustum> frusta = randomFrusta(options.frusta, Extent);
+
+  // Loose octree maintenance
+  KLooseOctree<uint32_t> tree(KVector3D(0.0f, 0.0f, 0.0f), 2.0f * Extent, 10);
+  std::vector<KLooseOctree<uint32_t>::Handle> handles(count);
+  double insertMs = bestOf(options.repeat, [&]()
+  {
+    tree.clear();
+    for (size_t i = 0; i < count; ++i)
+    {
+      handles[i] = tree.insert(static_cast<uint32_t>(i), boxes.min[i], boxes.max[i]);
+    }
+  });
+  double moveMs = bestOf(options.repeat, [&]()
+  {
+    for (size_t i = 0; i < count; ++i)
+    {
+      tree.move(handles[i], moved.min[i], moved.max[i]);
+    }
+    for (size_t i = 0; i < count; ++i)
+    {
+      tree.move(handles[i], boxes.min[i], boxes.max[i]);
+    }
+  });
+
+  // Visibility, through the octree and by testing every box
+  size_t treeVisible = 0;
+  double treeMs = bestOf(options.repeat, [&]()
+  {
+    treeVisible = 0;
+    for (KFrustum const &frustum : frusta)
+    {
+      tree.query(frustum, [&treeVisible](uint32_t) { ++treeVisible; });
+    }
+  });
+  size_t bruteVisible = 0;
+  double bruteMs = bestOf(options.repeat, [&]()
+  {
+    bruteVisible = 0;
+    for (KFrustum const &frustum : frusta)
+    {
+      for (size_t i = 0; i < count; ++i)
+      {
+        int planeMask = KFrustum::AllPlanes, firstPlane = 0;
+        bruteVisible += frustum.intersects(boxes.min[i], boxes.max[i], planeMask, firstPlane) ? 1 : 0;
+      }
+    }
+  });
+
+  // Structure of arrays copy for the batch test
+  std::vector<float> coordinates[6];
+  for (std::vector<float> &axis : coordinates)
+  {
+    axis.resize(count);
+  }
+  for (size_t i = 0; i < count; ++i)
+  {
+    for (int k = 0; k < 3; ++k)
+    {
+      coordinates[k][i] = boxes.min[i][k];
+      coordinates[k + 3][i] = boxes.max[i][k];
+    }
+  }
+  std::vector<uint32_t> visible(KFrustum::maskWords(count));
+  size_t batchVisible = 0;
+  double batchMs = bestOf(options.repeat, [&]()
+  {
+    batchVisible = 0;
+    for (KFrustum const &frustum : frusta)
+    {
+      frustum.intersects(coordinates[0].data(), coordinates[1].data(), coordinates[2].data(),
+                         coordinates[3].data(), coordinates[4].data(), coordinates[5].data(), count, visible.data());
+      for (uint32_t word : visible)
+      {
+        batchVisible += std::bitset<32>(word).count();
+      }
+    }
+  });
+
+  // The batch test must agree exactly with testing each box's corners
+  size_t mismatches = 0;
+  std::vector<KAabbBoundingVolume> volumes(count);
+  for (size_t i = 0; i < count; ++i)
+  {
+    Karma::MinMaxKVector3D bounds;
+    bounds.min = boxes.min[i];
+    bounds.max = boxes.max[i];
+    volumes[i].setMinMaxBounds(bounds);
+  }
+  for (KFrustum const &frustum : frusta)
+  {
+    frustum.intersects(coordinates[0].data(), coordinates[1].data(), coordinates[2].data(),
+                       coordinates[3].data(), coordinates[4].data(), coordinates[5].data(), count, visible.data());
+    for (size_t i = 0; i < count; ++i)
+    {
+      bool batchResult = (visible[i / 32] >> (i % 32)) & 1;
+      mismatches += (batchResult != frustum.intersects(volumes[i])) ? 1 : 0;
+    }
+  }
+  if (mismatches > 0) benchmarkFailed("Batch frustum culling", mismatches);
+
+  QJsonObject octree;
+  octree["insertMs"] = insertMs;
+  octree["moveNs"] = (count > 0) ? moveMs * 1.0e6 / (2.0 * count) : 0.0;
+  octree["queryMs"] = treeMs;
+  octree["visible"] = static_cast<double>(treeVisible);
+  QJsonObject bruteForce;
+  bruteForce["queryMs"] = bruteMs;
+  bruteForce["visible"] = static_cast<double>(bruteVisible);
+  bruteForce["mboxesPerSecond"] = throughput(count * frusta.size(), bruteMs);
+
+  QJsonObject batch;
+  batch["queryMs"] = batchMs;
+  batch["visible"] = static_cast<double>(batchVisible);
+  batch["mboxesPerSecond"] = throughput(count * frusta.size(), batchMs);
+  batch["mismatches"] = static_cast<double>(mismatches);
+
+  QJsonObject result;
+  result["instances"] = static_cast<double>(count);
+  result["frusta"] = static_cast<double>(frusta.size());
+  result["looseOctree"] = octree;
+  result["bruteForce"] = bruteForce;
+  result["batch"] = batch;
+  return result;
+}
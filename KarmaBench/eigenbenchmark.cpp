@@ -0,0 +1,336 @@
+#include "benchmark.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+#include <KMath>
+#include <KMatrix3x3>
+
+// Worst errors accepted before the run is reported as failed. Karma::jacobi
+// stops rotating once off-diagonal terms fall below 1e-4, which bounds how
+// closely its results can agree (Its eigenvalues by the norm of what is left
+// off the diagonal). Vectors are only compared when their eigenvalue is
+// separated from the others by sg_eigenGap (Relative to the largest
+// eigenvalue), since they are arbitrary within a repeated eigenspace.
+static const double sg_residualTolerance = 1e-5;
+static const double sg_orthonormalTolerance = 1e-5;
+static const double sg_jacobiValueTolerance = 5e-4;
+static const double sg_jacobiVectorTolerance = 1e-2;
+static const double sg_eigenGap = 0.1;
+static const int sg_jacobiIterations = 50;
+
+/*******************************************************************************
+ * Test Matrices
+ ******************************************************************************/
+// Symmetric matrices whose largest eigenvalue is of order one.
+enum EigenCase
+{
+  RandomEigenCase,
+  RepeatedEigenCase,
+  RankOneEigenCase
+};
+
+static char const *eigenCaseName(EigenCase eigenCase)
+{
+  switch (eigenCase)
+  {
+  case RandomEigenCase:
+    return "random";
+  case RepeatedEigenCase:
+    return "repeatedEigenvalues";
+  case RankOneEigenCase:
+    return "rankOne";
+  }
+  return "";
+}
+
+static KMatrix3x3 symmetricMatrix(double const a[3][3])
+{
+  KMatrix3x3 result;
+  for (int i = 0; i < 3; ++i)
+  {
+    for (int j = 0; j < 3; ++j)
+    {
+      result[i][j] = float(a[std::min(i, j)][std::max(i, j)]);
+    }
+  }
+  return result;
+}
+
+// R * diag(values) * R^T for the rotation of a random unit quaternion.
+static KMatrix3x3 rotatedDiagonal(std::mt19937 &random, double const values[3])
+{
+  std::normal_distribution<double> normal(0.0, 1.0);
+  double q[4] = { normal(random), normal(random), normal(random), normal(random) };
+  double length = std::sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+  double w = q[0] / length, x = q[1] / length, y = q[2] / length, z = q[3] / length;
+  double r[3][3] =
+  {
+    { 1.0 - 2.0 * (y * y + z * z), 2.0 * (x * y - w * z), 2.0 * (x * z + w * y) },
+    { 2.0 * (x * y + w * z), 1.0 - 2.0 * (x * x + z * z), 2.0 * (y * z - w * x) },
+    { 2.0 * (x * z - w * y), 2.0 * (y * z + w * x), 1.0 - 2.0 * (x * x + y * y) }
+  };
+  double a[3][3];
+  for (int i = 0; i < 3; ++i)
+  {
+    for (int j = 0; j < 3; ++j)
+    {
+      a[i][j] = r[i][0] * values[0] * r[j][0] + r[i][1] * values[1] * r[j][1] + r[i][2] * values[2] * r[j][2];
+    }
+  }
+  return symmetricMatrix(a);
+}
+
+static std::vector<KMatrix3x3> eigenMatrices(EigenCase eigenCase, size_t count)
+{
+  std::mt19937 random(9 + eigenCase);
+  std::normal_distribution<double> normal(0.0, 1.0);
+  std::uniform_real_distribution<double> uniform(-2.0, 2.0), magnitude(0.5, 2.0);
+  std::vector<KMatrix3x3> matrices;
+  matrices.reserve(count);
+  for (size_t i = 0; i < count; ++i)
+  {
+    switch (eigenCase)
+    {
+    case RandomEigenCase:
+      {
+        // Unit Frobenius norm, so the largest eigenvalue is at least 1/sqrt(3)
+        double a[3][3], norm = 0.0;
+        for (int j = 0; j < 3; ++j)
+        {
+          for (int k = j; k < 3; ++k)
+          {
+            a[j][k] = normal(random);
+            norm += ((j == k) ? 1.0 : 2.0) * a[j][k] * a[j][k];
+          }
+        }
+        norm = std::sqrt(norm);
+        for (int j = 0; j < 3; ++j)
+        {
+          for (int k = j; k < 3; ++k)
+          {
+            a[j][k] /= norm;
+          }
+        }
+        matrices.push_back(symmetricMatrix(a));
+        break;
+      }
+    case RepeatedEigenCase:
+      {
+        // Alternately a double and a triple eigenvalue
+        double repeated = (random() % 2) ? magnitude(random) : -magnitude(random);
+        double values[3] = { repeated, repeated, (i % 2) ? repeated : uniform(random) };
+        matrices.push_back(rotatedDiagonal(random, values));
+        break;
+      }
+    case RankOneEigenCase:
+      {
+        double v[3] = { normal(random), normal(random), normal(random) };
+        double scale = magnitude(random) / (v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+        double a[3][3];
+        for (int j = 0; j < 3; ++j)
+        {
+          for (int k = j; k < 3; ++k)
+          {
+            a[j][k] = scale * v[j] * v[k];
+          }
+        }
+        matrices.push_back(symmetricMatrix(a));
+        break;
+      }
+    }
+  }
+  return matrices;
+}
+
+/*******************************************************************************
+ * Error Measures
+ ******************************************************************************/
+// Eigenvectors are the columns of the eigenvector matrices.
+static void column(KMatrix3x3 const &vectors, int k, double v[3])
+{
+  for (int i = 0; i < 3; ++i)
+  {
+    v[i] = vectors[i][k];
+  }
+}
+
+static double rayleighQuotient(KMatrix3x3 const &a, double const v[3])
+{
+  double result = 0.0;
+  for (int i = 0; i < 3; ++i)
+  {
+    for (int j = 0; j < 3; ++j)
+    {
+      result += v[i] * a[i][j] * v[j];
+    }
+  }
+  return result;
+}
+
+// Largest |A v - lambda v| over the columns.
+static double eigenResidual(KMatrix3x3 const &a, KMatrix3x3 const &vectors, KVector3D const &values)
+{
+  double worst = 0.0;
+  for (int k = 0; k < 3; ++k)
+  {
+    double v[3];
+    column(vectors, k, v);
+    double sum = 0.0;
+    for (int i = 0; i < 3; ++i)
+    {
+      double r = a[i][0] * v[0] + a[i][1] * v[1] + a[i][2] * v[2] - values[k] * v[i];
+      sum += r * r;
+    }
+    worst = std::max(worst, std::sqrt(sum));
+  }
+  return worst;
+}
+
+// Largest deviation of V^T V from the identity, or of det(V) from one.
+static double orthonormalError(KMatrix3x3 const &v)
+{
+  double worst = 0.0;
+  for (int j = 0; j < 3; ++j)
+  {
+    for (int k = 0; k < 3; ++k)
+    {
+      double dot = v[0][j] * v[0][k] + v[1][j] * v[1][k] + v[2][j] * v[2][k];
+      worst = std::max(worst, std::abs(dot - ((j == k) ? 1.0 : 0.0)));
+    }
+  }
+  double det =
+    double(v[0][0]) * (double(v[1][1]) * v[2][2] - double(v[1][2]) * v[2][1]) -
+    double(v[0][1]) * (double(v[1][0]) * v[2][2] - double(v[1][2]) * v[2][0]) +
+    double(v[0][2]) * (double(v[1][0]) * v[2][1] - double(v[1][1]) * v[2][0]);
+  return std::max(worst, std::abs(det - 1.0));
+}
+
+struct JacobiAgreement
+{
+  double values;  // Largest eigenvalue difference
+  double vectors; // Largest sine of the angle between separated eigenvectors
+};
+
+// Jacobi returns unordered columns without eigenvalues; its eigenvalues are
+// taken as Rayleigh quotients and its columns sorted to match.
+static JacobiAgreement jacobiAgreement(KMatrix3x3 const &a, KMatrix3x3 const &vectors, KVector3D const &values, KMatrix3x3 const &jacobi)
+{
+  int order[3] = { 0, 1, 2 };
+  double jacobiValues[3];
+  for (int k = 0; k < 3; ++k)
+  {
+    double v[3];
+    column(jacobi, k, v);
+    jacobiValues[k] = rayleighQuotient(a, v);
+  }
+  std::sort(order, order + 3, [&jacobiValues](int lhs, int rhs) { return jacobiValues[lhs] > jacobiValues[rhs]; });
+
+  double scale = std::max(std::abs(values[0]), std::abs(values[2]));
+  JacobiAgreement result = { 0.0, 0.0 };
+  for (int k = 0; k < 3; ++k)
+  {
+    result.values = std::max(result.values, std::abs(jacobiValues[order[k]] - values[k]));
+    double gap = std::numeric_limits<double>::max();
+    if (k > 0) gap = std::min(gap, double(values[k - 1]) - values[k]);
+    if (k < 2) gap = std::min(gap, double(values[k]) - values[k + 1]);
+    if (gap <= sg_eigenGap * scale) continue;
+
+    double u[3], v[3];
+    column(vectors, k, u);
+    column(jacobi, order[k], v);
+    double dot = u[0] * v[0] + u[1] * v[1] + u[2] * v[2];
+    result.vectors = std::max(result.vectors, std::sqrt(std::max(1.0 - dot * dot, 0.0)));
+  }
+  return result;
+}
+
+/*******************************************************************************
+ * Eigen Benchmark
+ ******************************************************************************/
+static QJsonObject benchmarkEigenCase(EigenCase eigenCase, BenchmarkOptions const &options)
+{
+  std::vector<KMatrix3x3> matrices = eigenMatrices(eigenCase, options.matrices);
+  size_t count = matrices.size();
+
+  std::vector<KMatrix3x3> jacobiVectors(count);
+  double jacobiMs = bestOf(options.repeat, [&]()
+  {
+    for (size_t i = 0; i < count; ++i)
+    {
+      jacobiVectors[i] = Karma::jacobi(matrices[i], sg_jacobiIterations);
+    }
+  });
+  std::vector<KMatrix3x3> vectors(count);
+  std::vector<KVector3D> values(count);
+  double eigenMs = bestOf(options.repeat, [&]()
+  {
+    for (size_t i = 0; i < count; ++i)
+    {
+      vectors[i] = Karma::symmetricEigen(matrices[i], &values[i]);
+    }
+  });
+  std::vector<KMatrix3x3> batchVectors(count);
+  std::vector<KVector3D> batchValues(count);
+  double batchMs = bestOf(options.repeat, [&]()
+  {
+    Karma::symmetricEigen(matrices.data(), count, batchVectors.data(), batchValues.data());
+  });
+
+  // Errors are relative to the largest eigenvalue (Of order one here)
+  double residual = 0.0, orthonormal = 0.0;
+  JacobiAgreement agreement = { 0.0, 0.0 };
+  size_t failures = 0, batchMismatches = 0;
+  for (size_t i = 0; i < count; ++i)
+  {
+    double scale = std::max(std::abs(double(values[i][0])), std::abs(double(values[i][2])));
+    scale = std::max(scale, std::numeric_limits<double>::min());
+    double r = eigenResidual(matrices[i], vectors[i], values[i]) / scale;
+    double o = orthonormalError(vectors[i]);
+    JacobiAgreement a = jacobiAgreement(matrices[i], vectors[i], values[i], jacobiVectors[i]);
+    a.values /= scale;
+    residual = std::max(residual, r);
+    orthonormal = std::max(orthonormal, o);
+    agreement.values = std::max(agreement.values, a.values);
+    agreement.vectors = std::max(agreement.vectors, a.vectors);
+    if (!(r <= sg_residualTolerance && o <= sg_orthonormalTolerance &&
+          a.values <= sg_jacobiValueTolerance && a.vectors <= sg_jacobiVectorTolerance))
+    {
+      ++failures;
+    }
+    if (std::memcmp(&vectors[i], &batchVectors[i], sizeof(KMatrix3x3)) != 0 || !(values[i] == batchValues[i]))
+    {
+      ++batchMismatches;
+    }
+  }
+  std::string name = eigenCaseName(eigenCase);
+  if (failures > 0) benchmarkFailed(("symmetricEigen accuracy (" + name + ")").c_str(), failures);
+  if (batchMismatches > 0) benchmarkFailed(("Batched symmetricEigen (" + name + ")").c_str(), batchMismatches);
+
+  QJsonObject result;
+  result["matrices"] = eigenCaseName(eigenCase);
+  result["count"] = static_cast<double>(count);
+  result["jacobiMmatricesPerSecond"] = throughput(count, jacobiMs);
+  result["symmetricEigenMmatricesPerSecond"] = throughput(count, eigenMs);
+  result["batchMmatricesPerSecond"] = throughput(count, batchMs);
+  result["maxResidual"] = residual;
+  result["maxOrthonormalError"] = orthonormal;
+  result["maxJacobiEigenvalueDifference"] = agreement.values;
+  result["maxJacobiEigenvectorSine"] = agreement.vectors;
+  result["failures"] = static_cast<double>(failures);
+  result["batchMismatches"] = static_cast<double>(batchMismatches);
+  return result;
+}
+
+QJsonArray benchmarkEigen(BenchmarkOptions const &options)
+{
+  QJsonArray results;
+  results.append(benchmarkEigenCase(RandomEigenCase, options));
+  results.append(benchmarkEigenCase(RepeatedEigenCase, options));
+  results.append(benchmarkEigenCase(RankOneEigenCase, options));
+  return results;
+}
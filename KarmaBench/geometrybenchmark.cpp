@@ -0,0 +1,483 @@
+#include "benchmark.h"
+
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <random>
+#include <utility>
+#include <vector>
+#include <QDir>
+#include <QFileInfo>
+#include <KAdaptiveOctree>
+#include <KBspTree>
+#include <KHalfEdgeMesh>
+#include <KMatrix4x4>
+#include <KRay>
+#include <KStaticGeometry>
+#include <KTransform3D>
+
+/*******************************************************************************
+ * BenchmarkScene
+ ******************************************************************************/
+// Meshes placed in the world; every structure is built from the same scene.
+class BenchmarkScene
+{
+public:
+  BenchmarkScene(QString const &name);
+  void addMesh(KHalfEdgeMesh *mesh);
+  void addInstance(KHalfEdgeMesh const *mesh, KTransform3D const &trans);
+  template <typename Structure>
+  void addTo(Structure &structure) const;
+
+  QString m_name;
+  size_t m_triangles;
+  KVector3D m_min, m_max;
+private:
+  std::vector<std::unique_ptr<KHalfEdgeMesh>> m_meshes;
+  std::vector<std::pair<KHalfEdgeMesh const*, KTransform3D>> m_instances;
+};
+
+BenchmarkScene::BenchmarkScene(QString const &name) :
+  m_name(name), m_triangles(0),
+  m_min(std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max()),
+  m_max(-std::numeric_limits<float>::max(), -std::numeric_limits<float>::max(), -std::numeric_limits<float>::max())
+{
+  // Intentionally Empty
+}
+
+void BenchmarkScene::addMesh(KHalfEdgeMesh *mesh)
+{
+  m_meshes.emplace_back(mesh);
+}
+
+void BenchmarkScene::addInstance(KHalfEdgeMesh const *mesh, KTransform3D const &trans)
+{
+  KMatrix4x4 const &modelToWorld = trans.toMatrix();
+  for (KHalfEdgeMesh::Vertex const &v : mesh->vertices())
+  {
+    KVector3D p = modelToWorld * v.position;
+    m_min = KVector3D(std::min(m_min.x(), p.x()), std::min(m_min.y(), p.y()), std::min(m_min.z(), p.z()));
+    m_max = KVector3D(std::max(m_max.x(), p.x()), std::max(m_max.y(), p.y()), std::max(m_max.z(), p.z()));
+  }
+  m_triangles += mesh->faces().size();
+  m_instances.emplace_back(mesh, trans);
+}
+
+template <typename Structure>
+void BenchmarkScene::addTo(Structure &structure) const
+{
+  for (std::pair<KHalfEdgeMesh const*, KTransform3D> const &instance : m_instances)
+  {
+    structure.addGeometry(*instance.first, instance.second);
+  }
+}
+
+/*******************************************************************************
+ * Scenes
+ ******************************************************************************/
+static KHalfEdgeMesh *createSphere(int rings, int segments)
+{
+  KHalfEdgeMesh *mesh = new KHalfEdgeMesh;
+  mesh->reserve(2 + (rings - 1) * segments, 2 * (rings - 1) * segments);
+  auto ring = [segments](int r, int s) -> KHalfEdgeMesh::index_type
+  {
+    return static_cast<KHalfEdgeMesh::index_type>(2 + (r - 1) * segments + (s % segments));
+  };
+  KHalfEdgeMesh::index_type top = 1;
+  KHalfEdgeMesh::index_type bottom = ring(rings - 1, segments - 1) + 1;
+
+  mesh->addVertex(KVector3D(0.0f, 1.0f, 0.0f));
+  for (int r = 1; r < rings; ++r)
+  {
+    float theta = float(M_PI) * r / rings;
+    for (int s = 0; s < segments; ++s)
+    {
+      float phi = 2.0f * float(M_PI) * s / segments;
+      mesh->addVertex(KVector3D(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi)));
+    }
+  }
+  mesh->addVertex(KVector3D(0.0f, -1.0f, 0.0f));
+
+  auto face = [mesh](KHalfEdgeMesh::index_type a, KHalfEdgeMesh::index_type b, KHalfEdgeMesh::index_type c)
+  {
+    KHalfEdgeMesh::index_array ia = {{ a, 0, 0 }}, ib = {{ b, 0, 0 }}, ic = {{ c, 0, 0 }};
+    mesh->addFace(ia, ib, ic);
+  };
+  for (int s = 0; s < segments; ++s)
+  {
+    face(top, ring(1, s), ring(1, s + 1));
+    for (int r = 1; r < rings - 1; ++r)
+    {
+      face(ring(r, s), ring(r + 1, s), ring(r + 1, s + 1));
+      face(ring(r, s), ring(r + 1, s + 1), ring(r, s + 1));
+    }
+    face(bottom, ring(rings - 1, s + 1), ring(rings - 1, s));
+  }
+  return mesh;
+}
+
+// Clustered: Copies of a tessellated sphere scattered through a cube.
+static BenchmarkScene *createSphereScene(size_t triangles)
+{
+  BenchmarkScene *scene = new BenchmarkScene("synthetic-spheres");
+  KHalfEdgeMesh *sphere = createSphere(32, 32);
+  scene->addMesh(sphere);
+  size_t count = std::max<size_t>(1, triangles / sphere->faces().size());
+  float extent = 4.0f * std::cbrt(float(count));
+  std::mt19937 random(2);
+  std::uniform_real_distribution<float> position(-extent, extent);
+  std::uniform_real_distribution<float> scale(0.5f, 2.0f);
+  for (size_t i = 0; i < count; ++i)
+  {
+    KTransform3D trans;
+    trans.setTranslation(position(random), position(random), position(random));
+    trans.setScale(scale(random));
+    scene->addInstance(sphere, trans);
+  }
+  return scene;
+}
+
+// Uniform: Small disconnected triangles in random orientations.
+static BenchmarkScene *createSoupScene(size_t triangles)
+{
+  BenchmarkScene *scene = new BenchmarkScene("synthetic-soup");
+  KHalfEdgeMesh *soup = new KHalfEdgeMesh;
+  soup->reserve(3 * triangles, triangles);
+  float extent = 4.0f * std::cbrt(float(triangles));
+  std::mt19937 random(3);
+  std::uniform_real_distribution<float> position(-extent, extent);
+  std::uniform_real_distribution<float> offset(-1.0f, 1.0f);
+  for (size_t i = 0; i < triangles; ++i)
+  {
+    KVector3D center(position(random), position(random), position(random));
+    KHalfEdgeMesh::index_type first = static_cast<KHalfEdgeMesh::index_type>(3 * i + 1);
+    for (int k = 0; k < 3; ++k)
+    {
+      soup->addVertex(center + KVector3D(offset(random), offset(random), offset(random)));
+    }
+    KHalfEdgeMesh::index_array a = {{ first, 0, 0 }}, b = {{ first + 1, 0, 0 }}, c = {{ first + 2, 0, 0 }};
+    soup->addFace(a, b, c);
+  }
+  scene->addMesh(soup);
+  scene->addInstance(soup, KTransform3D());
+  return scene;
+}
+
+static BenchmarkScene *createMeshScene(QString const &fileName)
+{
+  KHalfEdgeMesh *mesh = new KHalfEdgeMesh;
+  if (!mesh->create(qPrintable(fileName)))
+  {
+    delete mesh;
+    return 0;
+  }
+  BenchmarkScene *scene = new BenchmarkScene(QFileInfo(fileName).fileName());
+  scene->addMesh(mesh);
+  scene->addInstance(mesh, KTransform3D());
+  return scene;
+}
+
+/*******************************************************************************
+ * Termination Predicates
+ ******************************************************************************/
+static bool leafOf1(size_t numTriangles, size_t depth)
+{
+  return (numTriangles <= 1 || depth >= 48);
+}
+
+static bool leafOf4(size_t numTriangles, size_t depth)
+{
+  return (numTriangles <= 4 || depth >= 40);
+}
+
+static bool leafOf16(size_t numTriangles, size_t depth)
+{
+  return (numTriangles <= 16 || depth >= 32);
+}
+
+struct BenchmarkPredicate
+{
+  char const *name;
+  KGeometryCloud::TerminationPred pred;
+};
+
+static const BenchmarkPredicate sg_predicates[] =
+{
+  { "leafOf1", &leafOf1 },
+  { "leafOf4", &leafOf4 },
+  { "leafOf16", &leafOf16 }
+};
+
+static char const *methodName(KGeometryCloud::BuildMethod method)
+{
+  switch (method)
+  {
+  case KGeometryCloud::TopDownMethod:
+    return "TopDownMethod";
+  case KGeometryCloud::BottomUpMethod:
+    return "BottomUpMethod";
+  case KGeometryCloud::SurfaceAreaMethod:
+    return "SurfaceAreaMethod";
+  }
+  return "";
+}
+
+/*******************************************************************************
+ * Measurements
+ ******************************************************************************/
+// Builds repeat times from scratch; the last build is left in structure.
+template <typename Structure>
+static double timedBuild(BenchmarkScene const &scene, Structure &structure, KGeometryCloud::BuildMethod method, KGeometryCloud::TerminationPred pred, size_t repeat)
+{
+  double best = std::numeric_limits<double>::max();
+  for (size_t i = 0; i < std::max<size_t>(repeat, 1); ++i)
+  {
+    structure.clear();
+    scene.addTo(structure);
+    KElapsedTimer timer;
+    timer.start();
+    structure.build(method, pred);
+    best = std::min(best, timer.nsecsElapsed() / 1.0e6);
+  }
+  return best;
+}
+
+static QJsonObject statisticsJson(KGeometryCloud::Statistics const &stats)
+{
+  QJsonObject result;
+  result["nodes"] = static_cast<double>(stats.nodes);
+  result["leaves"] = static_cast<double>(stats.leaves);
+  result["depth"] = static_cast<double>(stats.depth);
+  result["memoryBytes"] = static_cast<double>(stats.memory);
+  result["sahCost"] = (stats.sahCost > 0.0f) ? QJsonValue(stats.sahCost) : QJsonValue();
+  QJsonArray histogram;
+  for (size_t count : stats.leafHistogram)
+  {
+    histogram.append(static_cast<double>(count));
+  }
+  result["leafHistogram"] = histogram;
+  return result;
+}
+
+// Incoherent: Between random points around the scene.
+static std::vector<KRay> randomRays(BenchmarkScene const &scene, size_t count)
+{
+  KVector3D margin = (scene.m_max - scene.m_min) * 0.1f;
+  KVector3D min = scene.m_min - margin, max = scene.m_max + margin;
+  std::mt19937 random(4);
+  std::uniform_real_distribution<float> x(min.x(), max.x()), y(min.y(), max.y()), z(min.z(), max.z());
+  std::vector<KRay> rays;
+  rays.reserve(count);
+  for (size_t i = 0; i < count; ++i)
+  {
+    KVector3D origin(x(random), y(random), z(random));
+    KVector3D target(x(random), y(random), z(random));
+    rays.emplace_back(origin, (target - origin).normalized());
+  }
+  return rays;
+}
+
+// Coherent: A pinhole camera facing the scene, ordered in PacketSize blocks.
+static std::vector<KRay> cameraRays(BenchmarkScene const &scene, size_t count)
+{
+  static_assert(KStaticGeometry::PacketSize == 4, "Camera rays are grouped in 2x2 blocks");
+  KVector3D center = (scene.m_min + scene.m_max) * 0.5f;
+  float radius = (scene.m_max - scene.m_min).length() * 0.5f;
+  KVector3D eye = center + KVector3D(0.0f, 0.0f, 2.0f * radius);
+  size_t side = std::max<size_t>(2, static_cast<size_t>(std::sqrt(double(count))) & ~size_t(1));
+  std::vector<KRay> rays;
+  rays.reserve(side * side);
+  for (size_t by = 0; by < side; by += 2)
+  {
+    for (size_t bx = 0; bx < side; bx += 2)
+    {
+      for (size_t k = 0; k < 4; ++k)
+      {
+        float u = (float(bx + (k & 1)) + 0.5f) / side * 2.0f - 1.0f;
+        float v = (float(by + (k >> 1)) + 0.5f) / side * 2.0f - 1.0f;
+        KVector3D target = center + KVector3D(u * radius, v * radius, 0.0f);
+        rays.emplace_back(eye, (target - eye).normalized());
+      }
+    }
+  }
+  return rays;
+}
+
+static QJsonObject benchmarkRays(KStaticGeometry const &geometry, BenchmarkScene const &scene, BenchmarkOptions const &options)
+{
+  std::vector<KRay> incoherent = randomRays(scene, options.rays);
+  std::vector<KRay> coherent = cameraRays(scene, options.rays);
+  std::vector<KRayHit> hits(KStaticGeometry::PacketSize);
+  size_t hitCount = 0;
+
+  double closestMs = bestOf(options.repeat, [&]()
+  {
+    hitCount = 0;
+    for (KRay const &ray : incoherent)
+    {
+      hitCount += geometry.intersect(ray, hits[0]) ? 1 : 0;
+    }
+  });
+  double anyMs = bestOf(options.repeat, [&]()
+  {
+    for (KRay const &ray : incoherent)
+    {
+      geometry.occluded(ray);
+    }
+  });
+  double coherentMs = bestOf(options.repeat, [&]()
+  {
+    for (KRay const &ray : coherent)
+    {
+      geometry.intersect(ray, hits[0]);
+    }
+  });
+  double packetMs = bestOf(options.repeat, [&]()
+  {
+    for (size_t i = 0; i < coherent.size(); i += KStaticGeometry::PacketSize)
+    {
+      geometry.intersectPacket(&coherent[i], hits.data());
+    }
+  });
+
+  QJsonObject incoherentResult;
+  incoherentResult["rays"] = static_cast<double>(incoherent.size());
+  incoherentResult["hitRate"] = incoherent.empty() ? 0.0 : double(hitCount) / incoherent.size();
+  incoherentResult["closestHitMraysPerSecond"] = throughput(incoherent.size(), closestMs);
+  incoherentResult["anyHitMraysPerSecond"] = throughput(incoherent.size(), anyMs);
+  QJsonObject coherentResult;
+  coherentResult["rays"] = static_cast<double>(coherent.size());
+  coherentResult["closestHitMraysPerSecond"] = throughput(coherent.size(), coherentMs);
+  coherentResult["packetMraysPerSecond"] = throughput(coherent.size(), packetMs);
+  QJsonObject result;
+  result["incoherent"] = incoherentResult;
+  result["coherent"] = coherentResult;
+  return result;
+}
+
+// Frusta orbit the scene, looking at its center from twice its radius.
+static std::vector<KFrustum> orbitFrusta(BenchmarkScene const &scene, size_t count)
+{
+  KVector3D center = (scene.m_min + scene.m_max) * 0.5f;
+  float radius = std::max((scene.m_max - scene.m_min).length() * 0.5f, 1.0f);
+  std::mt19937 random(5);
+  std::normal_distribution<float> direction(0.0f, 1.0f);
+  std::vector<KFrustum> frusta;
+  frusta.reserve(count);
+  for (size_t i = 0; i < count; ++i)
+  {
+    KVector3D offset = KVector3D(direction(random), direction(random), direction(random)).normalized();
+    frusta.push_back(benchmarkFrustum(center + offset * (2.0f * radius), center, 3.0f * radius));
+  }
+  return frusta;
+}
+
+static QJsonObject benchmarkFrustumCulling(KStaticGeometry &geometry, BenchmarkScene const &scene, BenchmarkOptions const &options)
+{
+  std::vector<KFrustum> frusta = orbitFrusta(scene, options.frusta);
+  KStaticGeometry::TriangleRangeContainer visible;
+  size_t visibleTriangles = 0;
+  double ms = bestOf(options.repeat, [&]()
+  {
+    visibleTriangles = 0;
+    for (KFrustum const &frustum : frusta)
+    {
+      geometry.cull(frustum, visible);
+      for (KStaticGeometry::TriangleRange const &range : visible)
+      {
+        visibleTriangles += range.count;
+      }
+    }
+  });
+
+  QJsonObject result;
+  result["frusta"] = static_cast<double>(frusta.size());
+  result["cullsPerSecond"] = (ms > 0.0) ? frusta.size() / (ms / 1.0e3) : 0.0;
+  size_t total = frusta.size() * geometry.triangleCount();
+  result["visibleFraction"] = (total > 0) ? double(visibleTriangles) / total : 0.0;
+  return result;
+}
+
+/*******************************************************************************
+ * Geometry Benchmark
+ ******************************************************************************/
+template <typename Structure>
+static QJsonObject benchmarkStructure(char const *name, BenchmarkScene const &scene, Structure &structure, KGeometryCloud::BuildMethod method, BenchmarkPredicate const &predicate, BenchmarkOptions const &options)
+{
+  QJsonObject result;
+  result["structure"] = name;
+  result["method"] = methodName(method);
+  result["predicate"] = predicate.name;
+  result["buildMs"] = timedBuild(scene, structure, method, predicate.pred, options.repeat);
+  result["statistics"] = statisticsJson(structure.statistics());
+  return result;
+}
+
+static QJsonObject benchmarkScene(BenchmarkScene const &scene, BenchmarkOptions const &options)
+{
+  static const KGeometryCloud::BuildMethod staticMethods[] =
+  {
+    KGeometryCloud::TopDownMethod,
+    KGeometryCloud::BottomUpMethod,
+    KGeometryCloud::SurfaceAreaMethod
+  };
+
+  QJsonArray structures;
+  for (BenchmarkPredicate const &predicate : sg_predicates)
+  {
+    // Only KStaticGeometry answers ray and frustum queries
+    for (KGeometryCloud::BuildMethod method : staticMethods)
+    {
+      KStaticGeometry geometry;
+      QJsonObject result = benchmarkStructure("KStaticGeometry", scene, geometry, method, predicate, options);
+      result["rays"] = benchmarkRays(geometry, scene, options);
+      result["frustum"] = benchmarkFrustumCulling(geometry, scene, options);
+      structures.append(result);
+    }
+
+    // Note: The BSP splitting plane search grows quadratically with the input
+    if (scene.m_triangles <= options.bspTriangleLimit)
+    {
+      KBspTree bsp;
+      structures.append(benchmarkStructure("KBspTree", scene, bsp, KGeometryCloud::TopDownMethod, predicate, options));
+    }
+
+    KAdaptiveOctree octree;
+    structures.append(benchmarkStructure("KAdaptiveOctree", scene, octree, KGeometryCloud::TopDownMethod, predicate, options));
+  }
+
+  QJsonObject result;
+  result["name"] = scene.m_name;
+  result["triangles"] = static_cast<double>(scene.m_triangles);
+  result["structures"] = structures;
+  return result;
+}
+
+QJsonArray benchmarkGeometry(BenchmarkOptions const &options)
+{
+  QStringList fileNames;
+  QDir resources(":/resources/objects");
+  for (QString const &entry : resources.entryList(QStringList("*.obj"), QDir::Files, QDir::Name))
+  {
+    fileNames.append(resources.filePath(entry));
+  }
+  fileNames.append(options.meshes);
+
+  QJsonArray results;
+  for (QString const &fileName : fileNames)
+  {
+    std::unique_ptr<BenchmarkScene> scene(createMeshScene(fileName));
+    if (scene)
+    {
+      results.append(benchmarkScene(*scene, options));
+    }
+  }
+  if (options.syntheticTriangles > 0)
+  {
+    std::unique_ptr<BenchmarkScene> spheres(createSphereScene(options.syntheticTriangles));
+    results.append(benchmarkScene(*spheres, options));
+    std::unique_ptr<BenchmarkScene> soup(createSoupScene(options.syntheticTriangles));
+    results.append(benchmarkScene(*soup, options));
+  }
+  return results;
+}
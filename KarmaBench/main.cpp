@@ -0,0 +1,93 @@
+#include "benchmark.h"
+
+#include <cstdio>
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QFile>
+#include <QJsonDocument>
+#include <KParallel>
+
+static bool readSize(QCommandLineParser &parser, QCommandLineOption const &option, size_t &value)
+{
+  if (!parser.isSet(option)) return true;
+  bool ok = false;
+  qulonglong result = parser.value(option).toULongLong(&ok);
+  if (!ok)
+  {
+    std::fprintf(stderr, "Invalid value for --%s: %s\n", qPrintable(option.names().first()), qPrintable(parser.value(option)));
+    return false;
+  }
+  value = static_cast<size_t>(result);
+  return true;
+}
+
+int main(int argc, char *argv[])
+{
+  QCoreApplication app(argc, argv);
+  QCoreApplication::setApplicationName("KarmaBench");
+
+  QCommandLineParser parser;
+  parser.setApplicationDescription("Measures Karma's spatial structures, eigensolvers and OBJ parsing, reporting JSON.");
+  parser.addHelpOption();
+  QCommandLineOption outputOption("output", "Write the report to <file> instead of stdout.", "file");
+  QCommandLineOption repeatOption("repeat", "Timed runs per measurement; the fastest is reported.", "count");
+  QCommandLineOption trianglesOption("triangles", "Triangles in each synthetic cloud (0 disables them).", "count");
+  QCommandLineOption bspOption("bsp-limit", "Skip KBspTree for scenes with more triangles.", "count");
+  QCommandLineOption raysOption("rays", "Rays per ray query benchmark.", "count");
+  QCommandLineOption frustaOption("frusta", "Frusta per culling benchmark.", "count");
+  QCommandLineOption instancesOption("instances", "Boxes in the instance culling benchmark.", "count");
+  QCommandLineOption matricesOption("matrices", "Symmetric matrices per eigensolver benchmark.", "count");
+  QCommandLineOption objOption("obj-megabytes", "Generated OBJ text per statement kind.", "megabytes");
+  parser.addOptions({ outputOption, repeatOption, trianglesOption, bspOption, raysOption, frustaOption, instancesOption, matricesOption, objOption });
+  parser.addPositionalArgument("meshes", "Additional OBJ files to benchmark.", "[meshes...]");
+  parser.process(app);
+
+  BenchmarkOptions options;
+  size_t objMegabytes = options.objBytes >> 20;
+  if (!readSize(parser, repeatOption, options.repeat) ||
+      !readSize(parser, trianglesOption, options.syntheticTriangles) ||
+      !readSize(parser, bspOption, options.bspTriangleLimit) ||
+      !readSize(parser, raysOption, options.rays) ||
+      !readSize(parser, frustaOption, options.frusta) ||
+      !readSize(parser, instancesOption, options.instances) ||
+      !readSize(parser, matricesOption, options.matrices) ||
+      !readSize(parser, objOption, objMegabytes))
+  {
+    return 1;
+  }
+  options.objBytes = objMegabytes << 20;
+  options.meshes = parser.positionalArguments();
+
+  QJsonObject settings;
+  settings["repeat"] = static_cast<double>(options.repeat);
+  settings["syntheticTriangles"] = static_cast<double>(options.syntheticTriangles);
+  settings["bspTriangleLimit"] = static_cast<double>(options.bspTriangleLimit);
+  settings["rays"] = static_cast<double>(options.rays);
+  settings["frusta"] = static_cast<double>(options.frusta);
+  settings["instances"] = static_cast<double>(options.instances);
+  settings["matrices"] = static_cast<double>(options.matrices);
+  settings["objBytes"] = static_cast<double>(options.objBytes);
+
+  QJsonObject report;
+  report["version"] = 1;
+  report["threads"] = static_cast<double>(Karma::idealThreadCount());
+  report["options"] = settings;
+  report["objLexer"] = benchmarkObjLexer(options);
+  report["geometry"] = benchmarkGeometry(options);
+  report["culling"] = benchmarkCulling(options);
+  report["eigen"] = benchmarkEigen(options);
+
+  QByteArray json = QJsonDocument(report).toJson();
+  if (!parser.isSet(outputOption))
+  {
+    std::fwrite(json.constData(), 1, json.size(), stdout);
+    return (benchmarkFailures() > 0) ? 1 : 0;
+  }
+  QFile file(parser.value(outputOption));
+  if (!file.open(QFile::WriteOnly | QFile::Truncate) || file.write(json) != json.size())
+  {
+    std::fprintf(stderr, "Failed to write %s\n", qPrintable(file.fileName()));
+    return 1;
+  }
+  return (benchmarkFailures() > 0) ? 1 : 0;
+}
@@ -0,0 +1,133 @@
+#include "benchmark.h"
+
+#include <cstdio>
+#include <random>
+#include <string>
+#include <KAbstractObjParser>
+#include <KAbstractReader>
+
+/*******************************************************************************
+ * MemoryReader
+ ******************************************************************************/
+// Contiguous reader over generated text, so that only lexing and parsing is timed.
+class MemoryReader : public KAbstractReader
+{
+public:
+  MemoryReader(std::string const &text);
+  int next();
+  char const *data() const;
+  size_t size() const;
+private:
+  std::string const &m_text;
+  size_t m_pos;
+};
+
+MemoryReader::MemoryReader(std::string const &text) :
+  m_text(text), m_pos(0)
+{
+  // Intentionally Empty
+}
+
+int MemoryReader::next()
+{
+  if (m_pos == m_text.size())
+  {
+    return EndOfFile;
+  }
+  return m_text[m_pos++];
+}
+
+char const *MemoryReader::data() const
+{
+  return m_text.data();
+}
+
+size_t MemoryReader::size() const
+{
+  return m_text.size();
+}
+
+/*******************************************************************************
+ * NullObjParser
+ ******************************************************************************/
+// Discards every statement; what remains is the cost of the lexer and parser.
+class NullObjParser : public KAbstractObjParser
+{
+public:
+  NullObjParser(KAbstractReader *reader) : KAbstractObjParser(reader) {}
+protected:
+  void onVertex(float[4]) {}
+  void onTexture(float[3]) {}
+  void onNormal(float[3]) {}
+  void onParameter(float[3]) {}
+  void onFace(index_array[], size_type) {}
+  void onGroup(char*) {}
+  void onMaterial(char*) {}
+  void onUseMaterial(char*) {}
+  void onObject(char*) {}
+  void onSmooth(char*) {}
+};
+
+/*******************************************************************************
+ * OBJ Lexer Benchmark
+ ******************************************************************************/
+// Statements shaped like exporter output, repeated until bytes is reached.
+static std::string generateObj(char const *statement, size_t bytes)
+{
+  std::mt19937 random(1);
+  std::uniform_real_distribution<float> coordinate(-100.0f, 100.0f);
+  std::uniform_real_distribution<float> component(-1.0f, 1.0f);
+  std::uniform_int_distribution<unsigned> index(1, 1000000);
+  std::string text;
+  text.reserve(bytes + 128);
+  char line[128];
+  std::string kind(statement);
+  while (text.size() < bytes)
+  {
+    if (kind == "v")
+    {
+      std::snprintf(line, sizeof(line), "v %.6f %.6f %.6f\n", coordinate(random), coordinate(random), coordinate(random));
+    }
+    else if (kind == "vn")
+    {
+      KVector3D n = KVector3D(component(random), component(random), component(random)).normalized();
+      std::snprintf(line, sizeof(line), "vn %.4f %.4f %.4f\n", n.x(), n.y(), n.z());
+    }
+    else
+    {
+      unsigned a = index(random), b = index(random), c = index(random);
+      std::snprintf(line, sizeof(line), "f %u/%u/%u %u/%u/%u %u/%u/%u\n", a, a, a, b, b, b, c, c, c);
+    }
+    text += line;
+  }
+  return text;
+}
+
+QJsonArray benchmarkObjLexer(BenchmarkOptions const &options)
+{
+  static char const *statements[] = { "v", "vn", "f" };
+  QJsonArray results;
+  for (char const *statement : statements)
+  {
+    std::string text = generateObj(statement, options.objBytes);
+    for (int method = KAbstractObjParser::SequentialMethod; method <= KAbstractObjParser::ParallelMethod; ++method)
+    {
+      double ms = bestOf(options.repeat, [&]()
+      {
+        MemoryReader reader(text);
+        NullObjParser parser(&reader);
+        parser.initialize();
+        parser.parse(static_cast<KAbstractObjParser::ParseMethod>(method));
+      });
+
+      QJsonObject result;
+      result["statement"] = statement;
+      result["method"] = (method == KAbstractObjParser::SequentialMethod) ? "SequentialMethod" : "ParallelMethod";
+      result["bytes"] = static_cast<double>(text.size());
+      result["ms"] = ms;
+      result["megabytesPerSecond"] = (ms > 0.0) ? (text.size() / double(1 << 20)) / (ms / 1.0e3) : 0.0;
+      results.append(result);
+    }
+  }
+  return results;
+}
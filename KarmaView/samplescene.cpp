@@ -22,6 +22,7 @@
 #include <KSphereBoundingVolume>
 #include <KEllipsoidBoundingVolume>
 #include <KOrientedBoundingVolume>
+#include <KBoundingVolumeBuilder>
 #include <KStaticGeometry>
 #include <KAdaptiveOctree>
 #include <KBspTree>
@@ -148,37 +149,17 @@ void SampleScenePrivate::loadObj(const KString &fileName)
   quint64 ms;
   KElapsedTimer timer;
   {
-    // Load Half Edge Mesh
+    // Load Half Edge Mesh (Normals, centering and normalization are cached with it)
     {
       timer.start();
-      halfEdgeMesh.create(qPrintable(fileName));
+      halfEdgeMesh.create(qPrintable(fileName), KHalfEdgeMesh::VertexNormalsPostProcess | KHalfEdgeMesh::CenterPostProcess | KHalfEdgeMesh::NormalizePostProcess);
       ms = timer.elapsed();
       kDebug() << "Create HalfEdgeMesh (sec)    :" << float(ms) / 1e3f;
     }
-    // Calculate Normals
-    {
-      timer.start();
-      halfEdgeMesh.calculateVertexNormals();
-      ms = timer.elapsed();
-      kDebug() << "Calculate Normals (sec)      :" << float(ms) / 1e3f;
-    }
-    // Center the mesh
-    {
-      timer.start();
-      halfEdgeMesh.fixToCenter();
-      ms = timer.elapsed();
-      kDebug() << "Center Volume (sec)          :" << float(ms) / 1e3f;
-    }
-    // Normalize the mesh
-    {
-      timer.start();
-      halfEdgeMesh.normalizeVertices();
-      ms = timer.elapsed();
-      kDebug() << "Normalization (sec)          :" << float(ms) / 1e3f;
-    }
-    // Calculate OpenGLMesh
+    // Calculate OpenGLMesh (Instanced, so simplified levels are selected by distance)
     {
       timer.start();
+      openGLMesh.setLevelsOfDetail(4);
       openGLMesh.create(halfEdgeMesh);
       ms = timer.elapsed();
       kDebug() << "Create OpenGLMesh (sec)      :" << float(ms) / 1e3f;
@@ -200,13 +181,14 @@ void SampleScenePrivate::loadObj(const KString &fileName)
       delete m_sphereRitters;
       delete m_obb;
       delete m_ellipse;
-      m_aabb = new KAabbBoundingVolume(halfEdgeMesh, KAabbBoundingVolume::MinMaxMethod);
-      m_sphereCentroid = new KSphereBoundingVolume(halfEdgeMesh, KSphereBoundingVolume::CentroidMethod);
-      m_sphereLarsons = new KSphereBoundingVolume(halfEdgeMesh, KSphereBoundingVolume::LarssonsMethod);
-      m_spherePca = new KSphereBoundingVolume(halfEdgeMesh, KSphereBoundingVolume::PcaMethod);
-      m_sphereRitters = new KSphereBoundingVolume(halfEdgeMesh, KSphereBoundingVolume::RittersMethod);
-      m_obb = new KOrientedBoundingVolume(halfEdgeMesh, KOrientedBoundingVolume::PcaMethod);
-      m_ellipse = new KEllipsoidBoundingVolume(halfEdgeMesh, KEllipsoidBoundingVolume::PcaMethod);
+      KBoundingVolumeBuilder builder(halfEdgeMesh);
+      m_aabb = builder.createAabb(KAabbBoundingVolume::MinMaxMethod);
+      m_sphereCentroid = builder.createSphere(KSphereBoundingVolume::CentroidMethod);
+      m_sphereLarsons = builder.createSphere(KSphereBoundingVolume::LarssonsMethod);
+      m_spherePca = builder.createSphere(KSphereBoundingVolume::PcaMethod);
+      m_sphereRitters = builder.createSphere(KSphereBoundingVolume::RittersMethod);
+      m_obb = builder.createObb(KOrientedBoundingVolume::PcaMethod);
+      m_ellipse = builder.createEllipsoid(KEllipsoidBoundingVolume::PcaMethod);
       ms = timer.elapsed();
       kDebug() << "Bounding Volume Gen. (sec)   :" << float(ms) / 1e3f;
     }
@@ -63,7 +63,8 @@ SOURCES += \
     openglupdateevent.cpp \
     ../Karma/kabstractlexer.cpp \
     ../Karma/kabstracthdrparser.cpp \
-    ../Karma/kbufferedbinaryfilereader.cpp
+    ../Karma/kbufferedbinaryfilereader.cpp \
+    ../Karma/kmappedfilereader.cpp
 
 HEADERS += \
     openglprofiler.h \
@@ -3,7 +3,7 @@
 #include <KMacros>
 #include <OpenGLTexture>
 #include <OpenGLHdrTexture>
-#include <KBufferedBinaryFileReader>
+#include <KMappedFileReader>
 
 class OpenGLEnvrionmentPrivate
 {
@@ -46,7 +46,7 @@ void OpenGLEnvironment::create()
 void OpenGLEnvironment::setDirect(const char *filePath)
 {
   P(OpenGLEnvrionmentPrivate);
-  KBufferedBinaryFileReader reader(filePath, 1024);
+  KMappedFileReader reader(filePath);
   OpenGLHdrTextureLoader loader(&reader, &p.m_directIllumination);
   loader.parse(p.m_toneMapping);
 }
@@ -54,7 +54,7 @@ void OpenGLEnvironment::setDirect(const char *filePath)
 void OpenGLEnvironment::setIndirect(const char *filePath)
 {
   P(OpenGLEnvrionmentPrivate);
-  KBufferedBinaryFileReader reader(filePath, 1024);
+  KMappedFileReader reader(filePath);
   OpenGLHdrTextureLoader loader(&reader, &p.m_indirectIllumination);
   loader.parse(p.m_toneMapping);
 }
@@ -9,28 +9,32 @@
 #include <OpenGLInstanceData>
 #include <OpenGLViewport>
 #include <OpenGLRenderBlock>
+#include <OpenGLInstanceManager>
 
 class OpenGLInstancePrivate
 {
 public:
   bool m_visible;
+  bool m_dirty;
+  size_t m_levelOfDetail;
+  OpenGLInstanceManager *m_manager;
   KTransform3D m_currTransform;
   KTransform3D m_prevTransform;
   OpenGLMaterial m_material;
   OpenGLMesh m_mesh;
   OpenGLUniformBufferObject m_buffer;
 
-  OpenGLInstancePrivate();
+  OpenGLInstancePrivate(OpenGLInstanceManager *manager);
 };
 
-OpenGLInstancePrivate::OpenGLInstancePrivate() :
-  m_visible(true)
+OpenGLInstancePrivate::OpenGLInstancePrivate(OpenGLInstanceManager *manager) :
+  m_visible(true), m_dirty(false), m_levelOfDetail(0), m_manager(manager)
 {
   // Intentionally Empty
 }
 
-OpenGLInstance::OpenGLInstance() :
-  m_private(new OpenGLInstancePrivate)
+OpenGLInstance::OpenGLInstance(OpenGLInstanceManager *manager) :
+  m_private(new OpenGLInstancePrivate(manager))
 {
   P(OpenGLInstancePrivate);
   p.m_buffer.create();
@@ -63,8 +67,8 @@ void OpenGLInstance::commit(const OpenGLViewport &viewport)
   // Send data to the GPU
   {
     OpenGLInstanceData *data = (OpenGLInstanceData*)p.m_buffer.mapRange(0, sizeof(OpenGLInstanceData), flags);
-    data->m_currModelView = viewport.current().worldToView()  * Karma::ToGlm(currentTransform().toMatrix() );
-    data->m_prevModelView = viewport.previous().worldToView() * Karma::ToGlm(previousTransform().toMatrix());
+    data->m_currModelView = viewport.current().worldToView()  * Karma::ToGlm(p.m_currTransform.toMatrix());
+    data->m_prevModelView = viewport.previous().worldToView() * Karma::ToGlm(p.m_prevTransform.toMatrix());
     data->m_normalTransform = glm::transpose(glm::inverse(data->m_currModelView));
     p.m_buffer.unmap();
   }
@@ -81,12 +85,20 @@ void OpenGLInstance::release()
 KTransform3D &OpenGLInstance::transform()
 {
   P(OpenGLInstancePrivate);
+  setDirty(true);
   return p.m_currTransform;
 }
 
 KTransform3D &OpenGLInstance::currentTransform()
 {
   P(OpenGLInstancePrivate);
+  setDirty(true);
+  return p.m_currTransform;
+}
+
+KTransform3D const &OpenGLInstance::currentTransform() const
+{
+  P(const OpenGLInstancePrivate);
   return p.m_currTransform;
 }
 
@@ -100,6 +112,7 @@ void OpenGLInstance::setMesh(const OpenGLMesh &mesh)
 {
   P(OpenGLInstancePrivate);
   p.m_mesh = mesh;
+  setDirty(true);
 }
 
 const OpenGLMesh &OpenGLInstance::mesh() const
@@ -155,3 +168,28 @@ bool OpenGLInstance::visible() const
   P(const OpenGLInstancePrivate);
   return p.m_visible;
 }
+
+void OpenGLInstance::setLevelOfDetail(size_t level)
+{
+  P(OpenGLInstancePrivate);
+  p.m_levelOfDetail = level;
+}
+
+size_t OpenGLInstance::levelOfDetail() const
+{
+  P(const OpenGLInstancePrivate);
+  return p.m_levelOfDetail;
+}
+
+void OpenGLInstance::setDirty(bool d)
+{
+  P(OpenGLInstancePrivate);
+  if (d && !p.m_dirty && p.m_manager) p.m_manager->invalidate(this);
+  p.m_dirty = d;
+}
+
+bool OpenGLInstance::dirty() const
+{
+  P(const OpenGLInstancePrivate);
+  return p.m_dirty;
+}
@@ -5,7 +5,9 @@ class KTransform3D;
 class OpenGLMaterial;
 class KHalfEdgeMesh;
 class OpenGLMesh;
+class OpenGLInstanceManager;
 #include <string>
+#include <cstddef>
 #include <KAabbBoundingVolume>
 class OpenGLViewport;
 
@@ -13,7 +15,7 @@ class OpenGLInstancePrivate;
 class OpenGLInstance
 {
 public:
-  OpenGLInstance();
+  OpenGLInstance(OpenGLInstanceManager *manager = 0);
   ~OpenGLInstance();
 
   // OpenGL
@@ -23,6 +25,7 @@ public:
 
   KTransform3D &transform();
   KTransform3D &currentTransform();
+  KTransform3D const &currentTransform() const;
   KTransform3D &previousTransform();
   void setMesh(const OpenGLMesh &mesh);
   const OpenGLMesh &mesh() const;
@@ -34,6 +37,14 @@ public:
   KAabbBoundingVolume aabb() const;
   void setVisible(bool v);
   bool visible() const;
+  void setLevelOfDetail(size_t level);
+  size_t levelOfDetail() const;
+
+  // Set when the transform is accessed for writing or the mesh is replaced,
+  // which reports the instance to its manager; references to the transform
+  // should not be kept across frames.
+  void setDirty(bool d);
+  bool dirty() const;
 private:
   OpenGLInstancePrivate *m_private;
 };
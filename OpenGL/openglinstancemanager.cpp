@@ -1,6 +1,7 @@
 #include "openglinstancemanager.h"
 
 #include <vector>
+#include <unordered_map>
 #include <KMacros>
 #include <OpenGLMeshManager>
 #include <OpenGLInstance>
@@ -8,23 +9,52 @@
 #include <string>
 #include <algorithm>
 #include <KFrustum>
+#include <KLooseOctree>
 #include <OpenGLViewport>
 #include <OpenGLRenderBlock>
 #include <OpenGLMaterial>
+#include <KCamera3D>
+#include <KTransform3D>
+#include <KSize>
+#include <KMath>
+#include <cmath>
 
-struct OpenGLInstancePartitionWithinView : public std::unary_function<bool, OpenGLInstance*>
+// Largest on-screen error (pixels) a simplified level of detail may introduce
+static const float sg_levelOfDetailPixelError = 1.0f;
+
+// Region indexed for culling; instances outside of it are tested individually
+static const float sg_instanceTreeHalfExtent = 4096.0f;
+static const size_t sg_instanceTreeDepth = 10;
+
+struct OpenGLInstanceSelectLevelOfDetail : public std::unary_function<size_t, OpenGLInstance*>
 {
-  OpenGLInstancePartitionWithinView(const OpenGLViewport &view) :
-    m_frustum(view.frustum())
+  OpenGLInstanceSelectLevelOfDetail(const OpenGLViewport &view) :
+    m_eye(view.camera().translation()),
+    m_pixelsPerUnit(view.size().height() * 0.5f / std::tan(Karma::DegreesToRads(view.camera().fieldOfView()) * 0.5f))
   {
     // Intentionally Empty
   }
-  inline bool operator()(OpenGLInstance *instance) const
+  inline size_t operator()(OpenGLInstance const *instance) const
   {
-    return m_frustum.intersects(instance->aabb());
+    // Nearest distance from the eye to the instance's bounding sphere
+    KAabbBoundingVolume aabb = instance->aabb();
+    float radius = (aabb.maxExtent() - aabb.minExtent()).length() * 0.5f;
+    float distance = (aabb.center() - m_eye).length() - radius;
+    if (distance <= 0.0f) return 0;
+
+    // Coarsest level whose object-space error projects under the pixel threshold
+    OpenGLMesh const &mesh = instance->mesh();
+    KVector3D const &scale = instance->currentTransform().scale();
+    float pixelScale = std::max(std::fabs(scale.x()), std::max(std::fabs(scale.y()), std::fabs(scale.z()))) * m_pixelsPerUnit / distance;
+    for (size_t level = mesh.levelsOfDetail(); level > 1; --level)
+    {
+      if (mesh.levelOfDetailError(level - 1) * pixelScale <= sg_levelOfDetailPixelError) return level - 1;
+    }
+    return 0;
   }
 private:
-  KFrustum m_frustum;
+  KVector3D m_eye;
+  float m_pixelsPerUnit;
 };
 
 struct OpenGLInstanceSortByMeshMaterial : public std::binary_function<bool, OpenGLInstance*, OpenGLInstance*>
@@ -47,41 +77,86 @@ struct OpenGLInstanceSortByMeshMaterial : public std::binary_function<bool, Open
 class OpenGLInstanceManagerPrivate
 {
 public:
+  struct Placement;
   typedef std::vector<OpenGLInstance*> InstanceContainer;
-  typedef InstanceContainer::iterator InstanceIterator;
+  typedef KLooseOctree<Placement*> InstanceTree;
+  struct Placement
+  {
+    OpenGLInstance *instance;
+    InstanceTree::Handle handle;
+    size_t committedFrame;
+  };
+  typedef std::unordered_map<OpenGLInstance const*, Placement> InstancePlacementMap;
   InstanceContainer m_instances;
-  InstanceIterator m_begin, m_end;
+  InstanceContainer m_dirty;
+  InstanceContainer m_visible;
+  InstanceTree m_tree;
+  InstancePlacementMap m_placements;
+  KFrustum m_frustum;
+  KVector3D m_eye;
+  size_t m_frame;
+  OpenGLViewport const *m_view;
+  OpenGLInstanceManagerPrivate();
   void commit(const OpenGLViewport &view);
+  void commit(Placement &placement);
   void render() const;
-  void renderAll() const;
+  void renderAll();
 };
 
+OpenGLInstanceManagerPrivate::OpenGLInstanceManagerPrivate() :
+  m_tree(KVector3D(0.0f, 0.0f, 0.0f), sg_instanceTreeHalfExtent, sg_instanceTreeDepth),
+  m_frame(0), m_view(0)
+{
+  // Intentionally Empty
+}
+
 void OpenGLInstanceManagerPrivate::commit(const OpenGLViewport &view)
 {
-  m_begin = m_instances.begin();
-  m_end = m_instances.end();
-  //m_end = std::partition(m_begin, m_end, OpenGLInstancePartitionWithinView(view));
-  std::sort(m_begin, m_end, OpenGLInstanceSortByMeshMaterial());
+  // Re-place only the instances which reported a transform or mesh change
+  for (OpenGLInstance *instance : m_dirty)
+  {
+    KAabbBoundingVolume aabb = instance->aabb();
+    m_tree.move(m_placements[instance].handle, aabb.minExtent(), aabb.maxExtent());
+    instance->setDirty(false);
+  }
+  m_dirty.clear();
+
+  // Only the instances within the view are sorted, committed and drawn
+  ++m_frame;
+  m_view = &view;
+  m_frustum = view.frustum();
+  m_eye = view.camera().translation();
+  m_visible.clear();
+  m_tree.query(m_frustum, [this](Placement *placement)
+  {
+    commit(*placement);
+    m_visible.push_back(placement->instance);
+  });
+  std::sort(m_visible.begin(), m_visible.end(), OpenGLInstanceSortByMeshMaterial());
 
-  InstanceIterator it = m_begin;
-  while (it != m_end)
+  OpenGLInstanceSelectLevelOfDetail selectLevelOfDetail(view);
+  for (OpenGLInstance *instance : m_visible)
   {
-    OpenGLInstance *instance = *it;
-    instance->commit(view);
-    instance->material().commit();
-    ++it;
+    instance->setLevelOfDetail(selectLevelOfDetail(instance));
   }
 }
 
+// Commits the instance once per frame (Committing twice would lose the
+// previous transform).
+void OpenGLInstanceManagerPrivate::commit(Placement &placement)
+{
+  if (placement.committedFrame == m_frame) return;
+  placement.committedFrame = m_frame;
+  placement.instance->commit(*m_view);
+  placement.instance->material().commit();
+}
+
 void OpenGLInstanceManagerPrivate::render() const
 {
-  OpenGLInstance *instance;
-  InstanceIterator begin = m_begin;
   int currMat  = 0;
   int currMesh = 0;
-  while (begin != m_end)
+  for (OpenGLInstance *instance : m_visible)
   {
-    instance = *begin;
     if (instance->visible())
     {
       if (currMesh != instance->mesh().objectId())
@@ -95,14 +170,25 @@ void OpenGLInstanceManagerPrivate::render() const
         currMat = instance->material().objectId();
       }
       instance->bind();
-      instance->mesh().draw();
+      if (instance->levelOfDetail() == 0)
+        instance->mesh().drawClusters(m_frustum, static_cast<OpenGLInstance const*>(instance)->currentTransform().toMatrix(), m_eye);
+      else
+        instance->mesh().drawLevelOfDetail(instance->levelOfDetail());
     }
-    ++begin;
   }
 }
 
-void OpenGLInstanceManagerPrivate::renderAll() const
+void OpenGLInstanceManagerPrivate::renderAll()
 {
+  // Instances outside of the view were not committed by commit()
+  if (m_view)
+  {
+    for (InstancePlacementMap::value_type &entry : m_placements)
+    {
+      commit(entry.second);
+    }
+  }
+
   int currMat  = 0;
   int currMesh = 0;
   for (OpenGLInstance *instance : m_instances)
@@ -153,17 +239,30 @@ void OpenGLInstanceManager::render() const
   p.render();
 }
 
-void OpenGLInstanceManager::renderAll() const
+void OpenGLInstanceManager::renderAll()
 {
-  P(const OpenGLInstanceManagerPrivate);
+  P(OpenGLInstanceManagerPrivate);
   p.renderAll();
 }
 
 OpenGLInstance *OpenGLInstanceManager::createInstance()
 {
   P(OpenGLInstanceManagerPrivate);
-  OpenGLInstance *instance = new OpenGLInstance;
+  OpenGLInstance *instance = new OpenGLInstance(this);
   p.m_instances.emplace_back(instance);
+
+  // Placed properly by the next commit()
+  OpenGLInstanceManagerPrivate::Placement &placement = p.m_placements[instance];
+  placement.instance = instance;
+  placement.handle = p.m_tree.insert(&placement, KVector3D(0.0f, 0.0f, 0.0f), KVector3D(0.0f, 0.0f, 0.0f));
+  placement.committedFrame = 0;
+  instance->setDirty(true);
   return instance;
 }
 
+void OpenGLInstanceManager::invalidate(OpenGLInstance *instance)
+{
+  P(OpenGLInstanceManagerPrivate);
+  p.m_dirty.push_back(instance);
+}
+
@@ -14,8 +14,11 @@ public:
   void create();
   void commit(const OpenGLViewport &view);
   void render() const;
-  void renderAll() const;
+  void renderAll();
   OpenGLInstance *createInstance();
+
+  // Called by OpenGLInstance when its bounds may have changed
+  void invalidate(OpenGLInstance *instance);
 private:
   KUniquePointer<OpenGLInstanceManagerPrivate> m_private;
 };
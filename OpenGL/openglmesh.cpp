@@ -7,6 +7,59 @@
 #include <OpenGLFunctions>
 #include <OpenGLVertexArrayObject>
 #include <KAabbBoundingVolume>
+#include <KVertexCache>
+#include <KMeshCluster>
+#include <KMeshSimplifier>
+#include <KFrustum>
+#include <KMatrix4x4>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+// Each level of detail targets this fraction of the faces of the level before it;
+// the chain ends early once simplification no longer removes enough faces.
+static const float sg_levelReduction = 0.5f;
+static const float sg_levelMinimumReduction = 0.8f;
+
+// Runs the cache optimizer over each cluster on its own, so clusters stay contiguous.
+static void optimizeClusterVertexCache(uint32_t *indices, Karma::MeshClusterContainer const &clusters, size_t vertexCount)
+{
+  std::vector<uint32_t> local(vertexCount, ~0u);
+  std::vector<uint32_t> global;
+  for (KMeshCluster const &cluster : clusters)
+  {
+    uint32_t *begin = indices + 3 * cluster.firstFace;
+    size_t count = 3 * cluster.faceCount;
+    global.clear();
+    for (size_t i = 0; i < count; ++i)
+    {
+      uint32_t &mapped = local[begin[i]];
+      if (mapped == ~0u)
+      {
+        mapped = static_cast<uint32_t>(global.size());
+        global.push_back(begin[i]);
+      }
+      begin[i] = mapped;
+    }
+    Karma::optimizeVertexCache(begin, count, global.size());
+    for (size_t i = 0; i < count; ++i)
+    {
+      begin[i] = global[begin[i]];
+    }
+    for (uint32_t v : global)
+    {
+      local[v] = ~0u;
+    }
+  }
+}
+
+struct OpenGLMeshLevel
+{
+  size_t first;
+  GLsizei count;
+  float error;
+};
 
 class OpenGLMeshPrivate
 {
@@ -17,6 +70,11 @@ public:
   void vertexAttribPointer(int location, int elements, int count, OpenGLElementType type, bool normalized, int stride, int offset);
   void vertexAttribPointerDivisor(int location, int elements, OpenGLElementType type, bool normalized, int stride, int offset, int divisor);
   void vertexAttribPointerDivisor(int location, int elements, int count, OpenGLElementType type, bool normalized, int stride, int offset, int divisor);
+  int m_optimization;
+  size_t m_clusterSize;
+  Karma::MeshClusterContainer m_clusters;
+  size_t m_levelCount;
+  std::vector<OpenGLMeshLevel> m_levels;
   GLsizei m_elementCount;
   OpenGLBuffer m_indexBuffer;
   OpenGLBuffer m_vertexBuffer;
@@ -25,7 +83,7 @@ public:
 };
 
 OpenGLMeshPrivate::OpenGLMeshPrivate() :
-  m_indexBuffer(OpenGLBuffer::IndexBuffer), m_vertexBuffer(OpenGLBuffer::VertexBuffer)
+  m_optimization(OpenGLMesh::FullOptimization), m_clusterSize(124), m_levelCount(1), m_indexBuffer(OpenGLBuffer::IndexBuffer), m_vertexBuffer(OpenGLBuffer::VertexBuffer)
 {
   // Intentionally Empty
 }
@@ -37,16 +95,79 @@ void OpenGLMeshPrivate::create(const KHalfEdgeMesh &mesh)
   m_aabb = KAabbBoundingVolume(mesh.aabb());
   KHalfEdgeMesh::FaceContainer const &faces = mesh.faces();
   KHalfEdgeMesh::VertexContainer const &vertices = mesh.vertices();
-  size_t verticesSize = sizeof(KVertex) * vertices.size();
+  size_t verticesCount = vertices.size();
   size_t indicesCount = faces.size() * 3;
-  size_t indicesSize  = sizeof(uint32_t) * indicesCount;
   OpenGLBuffer::RangeAccessFlags flags =
       OpenGLBuffer::RangeInvalidate
     | OpenGLBuffer::RangeUnsynchronized
     | OpenGLBuffer::RangeWrite;
 
+  // Partition into clusters, which decides the order faces are emitted in
+  std::vector<uint32_t> faceOrder;
+  m_clusters.clear();
+  if (m_optimization & OpenGLMesh::ClusterOptimization)
+  {
+    m_clusters = Karma::buildMeshClusters(mesh, faceOrder, m_clusterSize);
+  }
+
+  // Construct Indices
+  std::vector<uint32_t> indices(indicesCount);
+  const KHalfEdgeMesh::HalfEdge *halfEdge;
+  for (size_t i = 0; i < faces.size(); ++i)
+  {
+    uint32_t *baseIndDest = &indices[3 * i];
+    halfEdge = mesh.halfEdge(faces[faceOrder.empty() ? i : faceOrder[i]].first);
+    baseIndDest[0] = halfEdge->to - 1;
+    halfEdge = mesh.halfEdge(halfEdge->next);
+    baseIndDest[1] = halfEdge->to - 1;
+    halfEdge = mesh.halfEdge(halfEdge->next);
+    baseIndDest[2] = halfEdge->to - 1;
+  }
+
+  // Reorder triangles for the post-transform cache, then vertices for fetch locality
+  std::vector<uint32_t> remap;
+  if (m_optimization & OpenGLMesh::VertexCacheOptimization)
+  {
+    if (m_clusters.empty())
+      Karma::optimizeVertexCache(indices.data(), indicesCount, vertices.size());
+    else
+      optimizeClusterVertexCache(indices.data(), m_clusters, vertices.size());
+  }
+
+  // Simplified levels of detail follow the full mesh in the same buffers
+  OpenGLMeshLevel level = { 0, static_cast<GLsizei>(indicesCount), 0.0f };
+  m_levels.assign(1, level);
+  if (m_levelCount > 1 && !faces.empty())
+  {
+    KMeshSimplifier simplifier(mesh);
+    while (m_levels.size() < m_levelCount)
+    {
+      size_t previous = m_levels.back().count / 3;
+      size_t faceCount = simplifier.simplify(static_cast<size_t>(previous * sg_levelReduction), std::numeric_limits<float>::max());
+      if (faceCount == 0 || faceCount > previous * sg_levelMinimumReduction) break;
+      level.first = indices.size();
+      level.count = static_cast<GLsizei>(3 * faceCount);
+      level.error = simplifier.error();
+      indices.insert(indices.end(), simplifier.indices().begin(), simplifier.indices().end());
+      if (m_optimization & OpenGLMesh::VertexCacheOptimization)
+      {
+        Karma::optimizeVertexCache(&indices[level.first], level.count, vertices.size());
+      }
+      m_levels.push_back(level);
+    }
+    indicesCount = indices.size();
+  }
+
+  if (m_optimization & OpenGLMesh::VertexFetchOptimization)
+  {
+    remap.resize(vertices.size());
+    verticesCount = Karma::optimizeVertexFetch(remap.data(), indices.data(), indicesCount, vertices.size());
+  }
+  size_t verticesSize = sizeof(KVertex) * verticesCount;
+  size_t indicesSize  = sizeof(uint32_t) * indicesCount;
+
   // Create Buffers
-  m_elementCount = static_cast<GLsizei>(indicesCount);
+  m_elementCount = m_levels.front().count;
   m_vertexArrayObject.create();
   m_vertexBuffer.create();
   m_indexBuffer.create();
@@ -62,25 +183,23 @@ void OpenGLMeshPrivate::create(const KHalfEdgeMesh &mesh)
   KVertex *vertDest = (KVertex*)m_vertexBuffer.mapRange(0, verticesSize, flags);
   uint32_t *indDest = (uint32_t*)m_indexBuffer.mapRange(0, indicesSize, flags);
 
-  // Iterators
-  uint32_t *baseIndDest;
-  const KHalfEdgeMesh::HalfEdge *halfEdge;
-
   // Construct Mesh
-  for (size_t i = 0; i < vertices.size(); ++i)
+  if (remap.empty())
   {
-    vertDest[i] = KVertex(vertices[i].position, vertices[i].normal);
+    for (size_t i = 0; i < vertices.size(); ++i)
+    {
+      vertDest[i] = KVertex(vertices[i].position, vertices[i].normal);
+    }
   }
-  for (size_t i = 0; i < faces.size(); ++i)
+  else
   {
-    baseIndDest = &indDest[3 * i];
-    halfEdge = mesh.halfEdge(faces[i].first);
-    baseIndDest[0] = halfEdge->to - 1;
-    halfEdge = mesh.halfEdge(halfEdge->next);
-    baseIndDest[1] = halfEdge->to - 1;
-    halfEdge = mesh.halfEdge(halfEdge->next);
-    baseIndDest[2] = halfEdge->to - 1;
+    for (size_t i = 0; i < vertices.size(); ++i)
+    {
+      if (remap[i] == ~0u) continue;
+      vertDest[remap[i]] = KVertex(vertices[i].position, vertices[i].normal);
+    }
   }
+  std::copy(indices.begin(), indices.end(), indDest);
 
   // Setup Vertex Pointers
   vertexAttribPointer(0, KVertex::PositionTupleSize, OpenGLElementType::Float, false, KVertex::stride(), KVertex::positionOffset());
@@ -146,6 +265,24 @@ void OpenGLMesh::setUsagePattern(OpenGLMesh::UsagePattern pattern)
   p.m_vertexBuffer.setUsagePattern(pattern);
 }
 
+void OpenGLMesh::setOptimization(int optimization)
+{
+  P(OpenGLMeshPrivate);
+  p.m_optimization = optimization;
+}
+
+void OpenGLMesh::setClusterSize(size_t faces)
+{
+  P(OpenGLMeshPrivate);
+  p.m_clusterSize = faces;
+}
+
+void OpenGLMesh::setLevelsOfDetail(size_t levels)
+{
+  P(OpenGLMeshPrivate);
+  p.m_levelCount = std::max<size_t>(levels, 1);
+}
+
 void OpenGLMesh::create(const char *filename)
 {
   KHalfEdgeMesh mesh;
@@ -167,6 +304,56 @@ void OpenGLMesh::draw()
   release();
 }
 
+void OpenGLMesh::drawClusters(const KFrustum &frustum, const KMatrix4x4 &model, const KVector3D &eye)
+{
+  P(OpenGLMeshPrivate);
+  if (p.m_clusters.empty())
+  {
+    draw();
+    return;
+  }
+
+  // Spheres are tested in world space, cones in object space
+  float scale = 0.0f;
+  for (int col = 0; col < 3; ++col)
+  {
+    float length = model(0, col) * model(0, col) + model(1, col) * model(1, col) + model(2, col) * model(2, col);
+    scale = std::max(scale, length);
+  }
+  scale = std::sqrt(scale);
+  KVector3D objectEye = model.inverted() * eye;
+
+  // Draw runs of neighbouring clusters which survive culling with a single call
+  bind();
+  size_t runBegin = 0, runEnd = 0;
+  for (KMeshCluster const &cluster : p.m_clusters)
+  {
+    bool visible =
+      !Karma::isClusterBackfacing(cluster, objectEye) &&
+      frustum.intersects(model * cluster.center, cluster.radius * scale);
+    if (!visible) continue;
+    if (3 * cluster.firstFace != runEnd)
+    {
+      if (runEnd != runBegin)
+        GL::glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(runEnd - runBegin), GL_UNSIGNED_INT, (const GLvoid*)(runBegin * sizeof(uint32_t)));
+      runBegin = 3 * cluster.firstFace;
+    }
+    runEnd = 3 * (cluster.firstFace + cluster.faceCount);
+  }
+  if (runEnd != runBegin)
+    GL::glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(runEnd - runBegin), GL_UNSIGNED_INT, (const GLvoid*)(runBegin * sizeof(uint32_t)));
+  release();
+}
+
+void OpenGLMesh::drawLevelOfDetail(size_t level)
+{
+  P(OpenGLMeshPrivate);
+  OpenGLMeshLevel const &lod = p.m_levels[std::min(level, p.m_levels.size() - 1)];
+  bind();
+  GL::glDrawElements(GL_TRIANGLES, lod.count, GL_UNSIGNED_INT, (const GLvoid*)(lod.first * sizeof(uint32_t)));
+  release();
+}
+
 void OpenGLMesh::drawInstanced(size_t begin, size_t end)
 {
   P(OpenGLMeshPrivate);
@@ -221,6 +408,24 @@ int OpenGLMesh::objectId() const
   return p.m_vertexArrayObject.objectId();
 }
 
+size_t OpenGLMesh::clusterCount() const
+{
+  P(const OpenGLMeshPrivate);
+  return p.m_clusters.size();
+}
+
+size_t OpenGLMesh::levelsOfDetail() const
+{
+  P(const OpenGLMeshPrivate);
+  return p.m_levels.size();
+}
+
+float OpenGLMesh::levelOfDetailError(size_t level) const
+{
+  P(const OpenGLMeshPrivate);
+  return p.m_levels[level].error;
+}
+
 const KAabbBoundingVolume &OpenGLMesh::aabb() const
 {
   P(const OpenGLMeshPrivate);
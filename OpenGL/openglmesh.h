@@ -8,6 +8,9 @@
 
 class KHalfEdgeMesh;
 class KAabbBoundingVolume;
+class KFrustum;
+class KMatrix4x4;
+class KVector3D;
 
 class OpenGLMeshPrivate;
 class OpenGLMesh
@@ -16,6 +19,16 @@ public:
 
   typedef OpenGLBuffer::UsagePattern UsagePattern;
 
+  // Ordering applied to the buffers by create() (Flags)
+  enum Optimization
+  {
+    NoOptimization = 0x0,
+    VertexCacheOptimization = 0x1,
+    VertexFetchOptimization = 0x2,
+    ClusterOptimization = 0x4,
+    FullOptimization = VertexCacheOptimization | VertexFetchOptimization | ClusterOptimization
+  };
+
   // Constructors / Destructor
   OpenGLMesh();
   ~OpenGLMesh();
@@ -23,9 +36,14 @@ public:
   // Public Methods
   void bind();
   void setUsagePattern(UsagePattern pattern);
+  void setOptimization(int optimization);
+  void setClusterSize(size_t faces);
+  void setLevelsOfDetail(size_t levels);
   void create(const char *filename);
   void create(const KHalfEdgeMesh &mesh);
   void draw();
+  void drawClusters(const KFrustum &frustum, const KMatrix4x4 &model, const KVector3D &eye);
+  void drawLevelOfDetail(size_t level);
   void drawInstanced(size_t begin, size_t end);
   void vertexAttribPointer(int location, int elements, OpenGLElementType type, bool normalized, int stride, int offset);
   void vertexAttribPointer(int location, int elements, int count, OpenGLElementType type, bool normalized, int stride, int offset);
@@ -34,6 +52,9 @@ public:
   void release();
   bool isCreated() const;
   int objectId() const;
+  size_t clusterCount() const;
+  size_t levelsOfDetail() const;
+  float levelOfDetailError(size_t level) const;
   KAabbBoundingVolume const &aabb() const;
 
 private:
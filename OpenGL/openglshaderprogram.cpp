@@ -11,7 +11,7 @@
 #include <string>
 
 #include "kabstractlexer.h"
-#include "kbufferedfilereader.h"
+#include "kmappedfilereader.h"
 #include "kcommon.h"
 #include "kparsetoken.h"
 #include "kstringwriter.h"
@@ -83,7 +83,7 @@ bool OpenGLShaderProgram::addShaderFromSourceFile(QOpenGLShader::ShaderType type
   std::string ppSource = getVersionComment().toUtf8().constData() + p.m_defines;
 
   // Preprocess the shader file
-  KBufferedFileReader reader(fileName, 1024);
+  KMappedFileReader reader(fileName);
 
   if (!reader.valid())
   {
@@ -3,7 +3,7 @@
 
 #include <KAbstractReader>
 #include <KAbstractWriter>
-#include <KBufferedFileReader>
+#include <KMappedFileReader>
 #include <KCommon>
 
 // GLSL 3.30r6
@@ -402,7 +402,7 @@ bool OpenGLSLParserPrivate::parse()
 void OpenGLSLParserPrivate::parseInclude()
 {
   char const *absolutePath = currToken().m_lexicon.c_str();
-  KBufferedFileReader reader(absolutePath, 2014);
+  KMappedFileReader reader(absolutePath);
   OpenGLSLParserPrivate subParse(m_parent, &reader, m_writer);
   subParse.setFilePath(absolutePath);
   subParse.setAutoresolver(m_autobinder);
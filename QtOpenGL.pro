@@ -15,4 +15,5 @@ SUBDIRS =     \
   qtbaseExt   \
   Karma       \
   OpenGL      \
-  KarmaView
+  KarmaView   \
+  KarmaBench